@@ -0,0 +1,254 @@
+/**
+ * batch.c
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This file provides an implementation for routines declared in batch.h
+ * header.
+ *
+ * Version: 0.1
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "command.h"
+#include "engine.h"
+#include "runner.h"
+#include "jobserver.h"
+#include "stats.h"
+#include "output.h"
+#include "batch.h"
+
+
+extern char **environ;
+
+
+size_t batch_arg_limit();
+size_t batch_arg_size(const char *arg);
+void fill_batch_argv(char **argv, int fixedc, char **args, const int *starts,
+                     int batch);
+int run_batches_in_order(char **argv, int fixedc, char **args,
+                         const int *starts, int batches);
+int run_batches_concurrently(char **argv, int fixedc, char **args,
+                             const int *starts, int batches, int jobs);
+
+
+int run_batch(command_t *command)
+{
+    char **args = command_get_args(command);
+    int argc = command_get_args_num(command);
+    int jobs = 1;
+    int i = 0;
+
+    if (argc > 1 && (!strcmp(args[0], "-j") || !strcmp(args[0], "--jobs"))) {
+        jobs = atoi(args[1]);
+        i = 2;
+    }
+
+    if (i == argc || jobs < 1) {
+        output_stderr("Usage: batch [-j N] command [fixed args...] "
+                      "[-- items...]\n");
+        return -1;
+    }
+
+    // Fixed arguments end at "--". Without it, every argument is an item.
+    int fixed_end = i + 1;
+    int first_item = i + 1;
+    for (int j = i + 1; j < argc; j++) {
+        if (!strcmp(args[j], "--")) {
+            fixed_end = j;
+            first_item = j + 1;
+            break;
+        }
+    }
+
+    // Space taken in every invocation: environment, binary, fixed arguments
+    // and the terminating NULL of argv.
+    size_t limit = batch_arg_limit();
+    size_t base = sizeof(char *);
+    for (char **env = environ; *env; env++) base += batch_arg_size(*env);
+    for (int j = i; j < fixed_end; j++) base += batch_arg_size(args[j]);
+
+    // Kernel limits the length of a single string too.
+    size_t max_strlen = 32 * sysconf(_SC_PAGESIZE);
+
+    // Index of the first item of each invocation, plus one past the end.
+    int *starts = (int *) malloc(sizeof(int) * (argc - first_item + 2));
+    assert(starts);
+    int batches = 0;
+    size_t size = base;
+
+    for (int j = first_item; j < argc; j++) {
+        size_t arg_size = batch_arg_size(args[j]);
+        if (strlen(args[j]) >= max_strlen || base + arg_size > limit) {
+            output_stderr("batch: Argument '%.32s...' does not fit in an "
+                          "invocation of '%s'.\n", args[j], args[i]);
+            free(starts);
+            return -1;
+        }
+        if (batches == 0 || size + arg_size > limit) {
+            starts[batches++] = j;
+            size = base;
+        }
+        size += arg_size;
+    }
+    if (batches == 0) starts[batches++] = first_item;  // Just the binary.
+    starts[batches] = argc;
+
+    // Binary and fixed arguments stay in place, items follow them.
+    int fixedc = 0;
+    char **argv = (char **) malloc(
+        sizeof(char *) * ((fixed_end - i) + (argc - first_item) + 1));
+    assert(argv);
+    for (int j = i; j < fixed_end; j++) argv[fixedc++] = args[j];
+
+    int rc;
+    if (jobs == 1 || batches == 1) {
+        rc = run_batches_in_order(argv, fixedc, args, starts, batches);
+    }
+    else {
+        rc = run_batches_concurrently(argv, fixedc, args, starts, batches,
+                                      jobs);
+    }
+
+    free(argv);
+    free(starts);
+
+    return rc;
+}
+
+/**
+ * Returns the number of bytes available to arguments and environment of a
+ * binary, as kernel computes it when exec()ing it.
+ */
+size_t batch_arg_limit()
+{
+    long arg_max = sysconf(_SC_ARG_MAX);
+    size_t limit = arg_max > 0 ? (size_t) arg_max : 131072;
+
+    struct rlimit stack;
+    if (!getrlimit(RLIMIT_STACK, &stack) && stack.rlim_cur != RLIM_INFINITY &&
+        stack.rlim_cur / 4 < limit) {
+        limit = stack.rlim_cur / 4;
+    }
+
+    return limit > BATCH_HEADROOM ? limit - BATCH_HEADROOM : 0;
+}
+
+/**
+ * Returns the space an argument takes when exec()ing a binary.
+ */
+size_t batch_arg_size(const char *arg)
+{
+    return strlen(arg) + 1 + sizeof(char *);
+}
+
+/**
+ * Places the items of an invocation after the fixed arguments of argv and
+ * terminates it.
+ */
+void fill_batch_argv(char **argv, int fixedc, char **args, const int *starts,
+                     int batch)
+{
+    int itemc = starts[batch+1] - starts[batch];
+    memcpy(argv + fixedc, args + starts[batch], sizeof(char *) * itemc);
+    argv[fixedc + itemc] = NULL;
+}
+
+/**
+ * Runs invocations one after the other.
+ *
+ * Returns:
+ *  0 if all succeeded, else the status of the first one failed.
+ */
+int run_batches_in_order(char **argv, int fixedc, char **args,
+                         const int *starts, int batches)
+{
+    int rc = 0;
+
+    for (int b = 0; b < batches; b++) {
+        fill_batch_argv(argv, fixedc, args, starts, b);
+        int status = exec_argv(argv, &engine_default_timeout);
+        if (status && !rc) rc = status;
+    }
+
+    return rc;
+}
+
+/**
+ * Runs invocations in workers, keeping up to the given number of them
+ * running at once.
+ *
+ * Returns:
+ *  0 if all succeeded, else the status of the first one failed, in order.
+ */
+int run_batches_concurrently(char **argv, int fixedc, char **args,
+                             const int *starts, int batches, int jobs)
+{
+    pid_t *pids = (pid_t *) malloc(sizeof(pid_t) * batches);
+    int *stats_fds = (int *) malloc(sizeof(int) * batches);
+    int *statuses = (int *) calloc(batches, sizeof(int));
+    assert(pids && stats_fds && statuses);
+
+    int next = 0;     // Next invocation to be started.
+    int running = 0;  // Workers currently running.
+
+    // Workers have nothing else to do, so they become the binary, unless it
+    // has to be waited for.
+    int waiting = exec_needs_waiting();
+
+    while (next < batches || running > 0) {
+        while (next < batches && running < jobs &&
+               !jobserver_acquire(running)) {
+            fill_batch_argv(argv, fixedc, args, starts, next);
+            pids[next] = worker_fork(&stats_fds[next]);
+
+            if (pids[next] == 0) {  // Worker code.
+                int status = waiting ?
+                    exec_argv(argv, &engine_default_timeout) :
+                    exec_in_place(argv);
+                if (WIFSIGNALED(status)) exit(128 + WTERMSIG(status));
+                exit(WEXITSTATUS(status));
+            }
+            // Worker counts its spawn only when it doesn't become the binary.
+            if (!waiting) shell_stats.spawns++;
+
+            next++;
+            running++;
+        }
+
+        int status;
+        pid_t pid = worker_wait(&status, next < batches && running < jobs);
+        if (pid < 0) break;
+        if (pid == 0) continue;  // A job slot may have been freed.
+
+        for (int b = 0; b < next; b++) {
+            if (pids[b] != pid) continue;
+
+            statuses[b] = status;
+            running--;
+            jobserver_release(running);
+            worker_reap(stats_fds[b]);
+            break;
+        }
+    }
+
+    int rc = 0;
+    for (int b = 0; b < batches && !rc; b++) rc = statuses[b];
+
+    free(pids);
+    free(stats_fds);
+    free(statuses);
+
+    return rc;
+}
@@ -0,0 +1,62 @@
+/**
+ * batch.h
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This header provides the 'batch' built-in command, which runs a binary on
+ * an argument list of any length, like xargs does.
+ *
+ * Kernel refuses to exec() a binary whose arguments and environment don't
+ * fit in the space it reserves for them on the new stack, which is the
+ * smaller of ARG_MAX and a quarter of the stack limit. Each string takes its
+ * length plus a terminating null byte and a pointer to it. 'batch' sums
+ * these sizes and packs as many items into each invocation as fit, so the
+ * whole list runs in the fewest possible exec() calls.
+ *
+ * Constants defined in batch.h:
+ *  -BATCH_HEADROOM
+ *
+ * Functions defined in batch.h:
+ *  -int run_batch(command_t *command)
+ *
+ * Version: 0.1
+ */
+
+#ifndef __batch_h__
+#define __batch_h__
+
+#include "command.h"
+
+
+// Bytes of the argument space left unused, for the path of the binary that
+// kernel copies too and for the auxiliary vector.
+#define BATCH_HEADROOM 4096
+
+
+/**
+ * Implements 'batch' built-in command, invoked as:
+ *  batch [-j N] command [fixed args...] [-- items...]
+ *
+ * Binary is invoked with its fixed arguments followed by as many items as
+ * fit. Without "--", all arguments after the command are items. Without
+ * any items, binary is invoked once. Invocations run in order, or up to N
+ * at once with -j, taking jobserver slots like scripts do (see runner.h).
+ * All invocations run, even after one of them fails.
+ *
+ * Parameters:
+ *  -command : The 'batch' command, whose arguments are the options, the
+ *          binary and its arguments.
+ *
+ * Returns:
+ *  0 if all invocations succeeded, the status of the first failed one in
+ *  order, or -1 on invalid usage or when an invocation can't fit even a
+ *  single item.
+ */
+int run_batch(command_t *command);
+
+#endif
@@ -0,0 +1,390 @@
+/**
+ * bench.c
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This file provides an implementation for routines declared in bench.h
+ * header.
+ *
+ * Version: 0.1
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/utsname.h>
+#include "command.h"
+#include "engine.h"
+#include "parser.h"
+#include "stats.h"
+#include "output.h"
+#include "bench.h"
+
+
+// Statistics of a series of samples, in seconds.
+typedef struct {
+    double mean;
+    double stddev;
+    double min;
+    double max;
+    double median;
+    double p90;
+    double p95;
+    double p99;
+} bench_summary_t;
+
+
+int run_prepare(char *prepare);
+void summarize(const double *samples, int count, bench_summary_t *summary);
+double percentile(const double *sorted, int count, double fraction);
+int compare_doubles(const void *a, const void *b);
+double mean_of(const double *samples, int count);
+void print_bench_summary(const char *name, const bench_summary_t *wall,
+                         double user, double sys, int runs);
+const char *time_unit(double seconds, double *scale);
+int export_json(const char *path, const char *name, const bench_summary_t *wall,
+                double user, double sys, const double *times,
+                const int *exit_codes, int runs);
+void write_json_string(FILE *file, const char *str);
+double timeval_seconds(const struct timeval *tv);
+
+
+int run_bench(command_t *command)
+{
+    char **args = command_get_args(command);
+    int argc = command_get_args_num(command);
+    int runs = BENCH_DEFAULT_RUNS;
+    int warmups = 0;
+    int ignore_failure = 0;
+    char *prepare = NULL;
+    char *json_path = NULL;
+    int i;
+
+    for (i = 0; i < argc && args[i][0] == '-'; i++) {
+        if ((!strcmp(args[i], "-n") || !strcmp(args[i], "--runs")) &&
+            i + 1 < argc) {
+            runs = atoi(args[++i]);
+        }
+        else if ((!strcmp(args[i], "-w") || !strcmp(args[i], "--warmup")) &&
+                 i + 1 < argc) {
+            warmups = atoi(args[++i]);
+        }
+        else if (!strcmp(args[i], "--prepare") && i + 1 < argc) {
+            prepare = args[++i];
+        }
+        else if (!strcmp(args[i], "--export-json") && i + 1 < argc) {
+            json_path = args[++i];
+        }
+        else if (!strcmp(args[i], "-i") ||
+                 !strcmp(args[i], "--ignore-failure")) {
+            ignore_failure = 1;
+        }
+        else {
+            break;
+        }
+    }
+
+    if (i == argc || runs < 1 || warmups < 0) {
+        output_stderr("Usage: bench [-n RUNS] [-w WARMUPS] [--prepare COMMANDS] "
+                      "[--export-json PATH] [-i] command [args...]\n");
+        return -1;
+    }
+
+    // Arguments of binary, NULL terminated, along with its name.
+    char **argv = (char **) malloc(sizeof(char *) * (argc - i + 1));
+    assert(argv);
+    memcpy(argv, args + i, sizeof(char *) * (argc - i));
+    argv[argc - i] = NULL;
+
+    // Name of benchmark, as the words of the command.
+    size_t name_length = 1;
+    for (int j = i; j < argc; j++) name_length += strlen(args[j]) + 1;
+    char *name = (char *) malloc(name_length);
+    assert(name);
+    name[0] = '\0';
+    for (int j = i; j < argc; j++) {
+        if (j > i) strcat(name, " ");
+        strcat(name, args[j]);
+    }
+
+    double *times = (double *) malloc(sizeof(double) * runs);
+    double *user_times = (double *) malloc(sizeof(double) * runs);
+    double *sys_times = (double *) malloc(sizeof(double) * runs);
+    int *exit_codes = (int *) malloc(sizeof(int) * runs);
+    assert(times && user_times && sys_times && exit_codes);
+
+    int rc = 0;
+
+    for (int run = -warmups; run < runs && !rc; run++) {
+        if (prepare && run_prepare(prepare)) {
+            output_stderr("bench: Prepare command failed.\n");
+            rc = -1;
+            break;
+        }
+
+        unsigned long long start_ns = stats_now_ns();
+        int status = exec_argv(argv, &engine_default_timeout);
+        unsigned long long wall_ns = stats_now_ns() - start_ns;
+
+        if (status && !ignore_failure) {
+            output_stderr("bench: Command failed in %s run %d. Use -i to "
+                          "ignore failures.\n",
+                          run < 0 ? "warmup" : "timed",
+                          run < 0 ? run + warmups + 1 : run + 1);
+            rc = status;
+            break;
+        }
+        if (run < 0) continue;  // Warmup runs are not timed.
+
+        times[run] = wall_ns / 1e9;
+        user_times[run] = timeval_seconds(&engine_last_usage.ru_utime);
+        sys_times[run] = timeval_seconds(&engine_last_usage.ru_stime);
+        if (WIFEXITED(status)) exit_codes[run] = WEXITSTATUS(status);
+        else exit_codes[run] = 128 + WTERMSIG(status);
+    }
+
+    if (!rc) {
+        bench_summary_t wall;
+        summarize(times, runs, &wall);
+        double user = mean_of(user_times, runs);
+        double sys = mean_of(sys_times, runs);
+
+        print_bench_summary(name, &wall, user, sys, runs);
+
+        if (json_path && export_json(json_path, name, &wall, user, sys,
+                                     times, exit_codes, runs)) {
+            output_stderr("bench: Failed to write %s.\n", json_path);
+            rc = -1;
+        }
+    }
+
+    free(times);
+    free(user_times);
+    free(sys_times);
+    free(exit_codes);
+    free(name);
+    free(argv);
+
+    return rc;
+}
+
+/**
+ * Executes the line of commands given to --prepare.
+ *
+ * Returns:
+ *  0 if all commands succeeded, else non-zero.
+ */
+int run_prepare(char *prepare)
+{
+    // Parser writes into the line, so keep the argument intact.
+    char *line = strdup(prepare);
+    assert(line);
+
+    command_t **commands;
+    int commandc;
+    int rc = parse_line(line, &commands, &commandc);
+    if (!rc) {
+        rc = exec_commands(commands, commandc);
+        for (int i = 0; i < commandc; i++) command_destroy(commands[i]);
+        free(commands);
+    }
+
+    free(line);
+
+    return rc;
+}
+
+/**
+ * Computes the statistics of a series of samples.
+ */
+void summarize(const double *samples, int count, bench_summary_t *summary)
+{
+    double *sorted = (double *) malloc(sizeof(double) * count);
+    assert(sorted);
+    memcpy(sorted, samples, sizeof(double) * count);
+    qsort(sorted, count, sizeof(double), compare_doubles);
+
+    summary->mean = mean_of(samples, count);
+
+    // Sample standard deviation, undefined for a single sample.
+    double squares = 0;
+    for (int i = 0; i < count; i++) {
+        double d = samples[i] - summary->mean;
+        squares += d * d;
+    }
+    summary->stddev = count > 1 ? sqrt(squares / (count - 1)) : 0;
+
+    summary->min = sorted[0];
+    summary->max = sorted[count-1];
+    summary->median = percentile(sorted, count, 0.5);
+    summary->p90 = percentile(sorted, count, 0.9);
+    summary->p95 = percentile(sorted, count, 0.95);
+    summary->p99 = percentile(sorted, count, 0.99);
+
+    free(sorted);
+}
+
+/**
+ * Computes a percentile of sorted samples, interpolating linearly between
+ * the two closest ranks.
+ */
+double percentile(const double *sorted, int count, double fraction)
+{
+    double rank = fraction * (count - 1);
+    int low = (int) rank;
+    if (low + 1 >= count) return sorted[count-1];
+    return sorted[low] + (rank - low) * (sorted[low+1] - sorted[low]);
+}
+
+/**
+ * Compares two doubles, for qsort().
+ */
+int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Returns the mean of samples.
+ */
+double mean_of(const double *samples, int count)
+{
+    double sum = 0;
+    for (int i = 0; i < count; i++) sum += samples[i];
+    return sum / count;
+}
+
+/**
+ * Prints statistics of a benchmark in human readable form.
+ */
+void print_bench_summary(const char *name, const bench_summary_t *wall,
+                         double user, double sys, int runs)
+{
+    double scale;
+    const char *unit = time_unit(wall->mean, &scale);
+
+    output_stdout("Benchmark: %s\n", name);
+    output_stdout("  Time (mean +/- sd):   %8.3f %s +/- %8.3f %s"
+                  "    [User: %.3f %s, System: %.3f %s]\n",
+                  wall->mean * scale, unit, wall->stddev * scale, unit,
+                  user * scale, unit, sys * scale, unit);
+    output_stdout("  Range (min ... max):  %8.3f %s ... %8.3f %s"
+                  "    %d runs\n",
+                  wall->min * scale, unit, wall->max * scale, unit, runs);
+    output_stdout("  Percentiles:          p50 %.3f %s, p90 %.3f %s, "
+                  "p95 %.3f %s, p99 %.3f %s\n",
+                  wall->median * scale, unit, wall->p90 * scale, unit,
+                  wall->p95 * scale, unit, wall->p99 * scale, unit);
+}
+
+/**
+ * Picks the unit in which a time is printed best.
+ *
+ * Parameters:
+ *  -seconds : The time.
+ *  -scale : A reference where the factor converting seconds to returned
+ *          unit is stored.
+ *
+ * Returns:
+ *  Name of the unit.
+ */
+const char *time_unit(double seconds, double *scale)
+{
+    if (seconds < 1e-3) {
+        *scale = 1e6;
+        return "us";
+    }
+    if (seconds < 1) {
+        *scale = 1e3;
+        return "ms";
+    }
+    *scale = 1;
+    return "s";
+}
+
+/**
+ * Writes results of a benchmark to a JSON file. Times are in seconds.
+ *
+ * Returns:
+ *  0 on success, else -1.
+ */
+int export_json(const char *path, const char *name, const bench_summary_t *wall,
+                double user, double sys, const double *times,
+                const int *exit_codes, int runs)
+{
+    FILE *file = fopen(path, "w");
+    if (!file) return -1;
+
+    // Describe the host, so results of different ones can be compared.
+    struct utsname host;
+    if (uname(&host)) memset(&host, 0, sizeof(host));
+
+    fprintf(file, "{\n  \"host\": {\n    \"hostname\": ");
+    write_json_string(file, host.nodename);
+    fprintf(file, ",\n    \"kernel\": ");
+    write_json_string(file, host.release);
+    fprintf(file, ",\n    \"machine\": ");
+    write_json_string(file, host.machine);
+    fprintf(file, ",\n    \"cpus\": %ld\n  },\n",
+            sysconf(_SC_NPROCESSORS_ONLN));
+
+    fprintf(file, "  \"results\": [\n    {\n      \"command\": ");
+    write_json_string(file, name);
+    fprintf(file, ",\n      \"runs\": %d,\n", runs);
+    fprintf(file, "      \"mean\": %.9f,\n", wall->mean);
+    fprintf(file, "      \"stddev\": %.9f,\n", wall->stddev);
+    fprintf(file, "      \"median\": %.9f,\n", wall->median);
+    fprintf(file, "      \"p90\": %.9f,\n", wall->p90);
+    fprintf(file, "      \"p95\": %.9f,\n", wall->p95);
+    fprintf(file, "      \"p99\": %.9f,\n", wall->p99);
+    fprintf(file, "      \"user\": %.9f,\n", user);
+    fprintf(file, "      \"system\": %.9f,\n", sys);
+    fprintf(file, "      \"min\": %.9f,\n", wall->min);
+    fprintf(file, "      \"max\": %.9f,\n", wall->max);
+
+    fprintf(file, "      \"times\": [");
+    for (int i = 0; i < runs; i++)
+        fprintf(file, "%s%.9f", i ? ", " : "", times[i]);
+    fprintf(file, "],\n      \"exit_codes\": [");
+    for (int i = 0; i < runs; i++)
+        fprintf(file, "%s%d", i ? ", " : "", exit_codes[i]);
+    fprintf(file, "]\n    }\n  ]\n}\n");
+
+    int failed = ferror(file);
+    if (fclose(file)) failed = 1;
+
+    return failed ? -1 : 0;
+}
+
+/**
+ * Writes a string to a file as a JSON string literal.
+ */
+void write_json_string(FILE *file, const char *str)
+{
+    fputc('"', file);
+    for (const unsigned char *c = (const unsigned char *) str; *c; c++) {
+        if (*c == '"' || *c == '\\') fprintf(file, "\\%c", *c);
+        else if (*c < 0x20) fprintf(file, "\\u%04x", *c);
+        else fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+/**
+ * Converts a timeval to seconds.
+ */
+double timeval_seconds(const struct timeval *tv)
+{
+    return tv->tv_sec + tv->tv_usec / 1e6;
+}
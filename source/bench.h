@@ -0,0 +1,59 @@
+/**
+ * bench.h
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This header provides the 'bench' built-in command, which runs a binary
+ * many times and reports statistics of its run time, like hyperfine does.
+ *
+ * Binary is spawned through exec_argv(), the same path every binary invoked
+ * by the shell takes, so samples carry no shell startup cost. Wall time is
+ * measured around each spawn, while user and system time of each run are
+ * the ones reported by wait4().
+ *
+ * Constants defined in bench.h:
+ *  -BENCH_DEFAULT_RUNS
+ *
+ * Functions defined in bench.h:
+ *  -int run_bench(command_t *command)
+ *
+ * Version: 0.1
+ */
+
+#ifndef __bench_h__
+#define __bench_h__
+
+#include "command.h"
+
+
+// Number of timed runs, when not given.
+#define BENCH_DEFAULT_RUNS 10
+
+
+/**
+ * Implements 'bench' built-in command, invoked as:
+ *  bench [-n RUNS] [-w WARMUPS] [--prepare COMMANDS] [--export-json PATH]
+ *        [-i] command [args...]
+ *
+ * Before each run, including warmup ones, the line of commands given to
+ * --prepare is executed. Mean, standard deviation, min, max and percentiles
+ * of wall time are printed, along with mean user and system time. With
+ * --export-json, results are also written to PATH along with a description
+ * of the host. Benchmark stops at the first run that fails, unless -i is
+ * given.
+ *
+ * Parameters:
+ *  -command : The 'bench' command, whose arguments are the options and the
+ *          binary to run.
+ *
+ * Returns:
+ *  0 on success, the status of the run that failed, or -1 on invalid usage.
+ */
+int run_bench(command_t *command);
+
+#endif
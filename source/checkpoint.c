@@ -0,0 +1,272 @@
+/**
+ * checkpoint.c
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This file provides an implementation for routines declared in checkpoint.h
+ * header.
+ *
+ * Version: 0.1
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "engine.h"
+#include "stats.h"
+#include "output.h"
+#include "checkpoint.h"
+
+
+#define CHECKPOINT_MAGIC "CRUSHCK1"
+#define CHECKPOINT_SLOT_SIZE 4096  // Bytes reserved for each slot in file.
+#define CHECKPOINT_CWD_SIZE 3968   // Longest working dir that can be kept.
+
+
+// Contents of a slot. Fields have fixed sizes, so the file layout doesn't
+// depend on the platform.
+typedef struct {
+    char magic[8];              // CHECKPOINT_MAGIC, without terminator.
+    uint64_t sequence;          // Incremented by every write.
+    uint64_t line_number;       // Last completed line of script.
+    uint64_t offset;            // Offset in script after that line.
+    uint64_t script_size;       // Size of script when checkpoint was taken.
+    int64_t script_mtime_ns;    // Modification time of script.
+    int64_t timeout_ns;         // engine_default_timeout.duration_ns
+    int64_t kill_after_ns;      // engine_default_timeout.kill_after_ns
+    int32_t signal;             // engine_default_timeout.signal
+    uint32_t cwd_length;        // Length of cwd. 0 if unknown.
+    char cwd[CHECKPOINT_CWD_SIZE];  // Working directory of shell.
+    uint64_t checksum;          // Checksum of all previous fields.
+} checkpoint_record_t;
+
+_Static_assert(sizeof(checkpoint_record_t) <= CHECKPOINT_SLOT_SIZE,
+               "checkpoint record doesn't fit in a slot");
+
+
+int load_checkpoint(checkpoint_record_t *record);
+int write_checkpoint();
+void capture_shell_state();
+uint64_t checksum_record(const checkpoint_record_t *record);
+
+
+int checkpoint_fd = -1;
+checkpoint_record_t checkpoint_record;   // Newest checkpoint recorded.
+int checkpoint_dirty = 0;                // Whether it has not been written.
+unsigned long long checkpoint_last_sync = 0;
+int checkpoint_hooked = 0;               // Whether close at exit is registered.
+int checkpoint_cwd_captured = 0;         // Whether record holds the cwd,
+unsigned long long checkpoint_cwd_changes = 0;  // as of that many 'cd'.
+
+
+int checkpoint_open(const char *path, const char *script, int resume,
+                    int *line_number, size_t *offset)
+{
+    struct stat st;
+    if (stat(script, &st)) {
+        output_stderr("Failed to open %s script.\n", script);
+        return -1;
+    }
+    int64_t mtime_ns = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+
+    checkpoint_fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (checkpoint_fd < 0) {
+        output_stderr("Failed to open checkpoint %s: %s\n",
+                      path, strerror(errno));
+        return -1;
+    }
+
+    if (resume) {
+        if (load_checkpoint(&checkpoint_record)) {
+            output_stderr("No valid checkpoint found in %s.\n", path);
+            goto fail;
+        }
+        if (checkpoint_record.script_size != (uint64_t) st.st_size ||
+            checkpoint_record.script_mtime_ns != mtime_ns) {
+            output_stderr("Script %s changed after checkpoint %s was taken.\n",
+                          script, path);
+            goto fail;
+        }
+        if (checkpoint_record.cwd_length &&
+            chdir(checkpoint_record.cwd)) {
+            output_stderr("Failed to restore working directory %s: %s\n",
+                          checkpoint_record.cwd, strerror(errno));
+            goto fail;
+        }
+        engine_default_timeout.duration_ns = checkpoint_record.timeout_ns;
+        engine_default_timeout.kill_after_ns = checkpoint_record.kill_after_ns;
+        engine_default_timeout.signal = checkpoint_record.signal;
+        checkpoint_cwd_captured = checkpoint_record.cwd_length != 0;
+        checkpoint_cwd_changes = engine_cwd_changes;
+    }
+    else {
+        // Drop both slots of any previous run, so none of them is newer.
+        if (ftruncate(checkpoint_fd, 0)) {
+            output_stderr("Failed to reset checkpoint %s: %s\n",
+                          path, strerror(errno));
+            goto fail;
+        }
+        memset(&checkpoint_record, 0, sizeof(checkpoint_record));
+        memcpy(checkpoint_record.magic, CHECKPOINT_MAGIC, 8);
+        checkpoint_record.script_size = st.st_size;
+        checkpoint_record.script_mtime_ns = mtime_ns;
+        capture_shell_state();
+        if (write_checkpoint()) {
+            output_stderr("Failed to write checkpoint %s: %s\n",
+                          path, strerror(errno));
+            goto fail;
+        }
+    }
+
+    *line_number = checkpoint_record.line_number;
+    *offset = checkpoint_record.offset;
+
+    if (!checkpoint_hooked) {
+        atexit(checkpoint_close);
+        checkpoint_hooked = 1;
+    }
+
+    return 0;
+
+fail:
+    close(checkpoint_fd);
+    checkpoint_fd = -1;
+    return -1;
+}
+
+void checkpoint_update(int line_number, size_t offset)
+{
+    if (checkpoint_fd < 0) return;
+
+    checkpoint_record.line_number = line_number;
+    checkpoint_record.offset = offset;
+    capture_shell_state();
+    checkpoint_dirty = 1;
+
+    if (stats_now_ns() - checkpoint_last_sync >=
+            CHECKPOINT_SYNC_INTERVAL * 1000000ULL &&
+        write_checkpoint()) {
+        output_perror("Failed to write checkpoint");
+    }
+}
+
+void checkpoint_close()
+{
+    if (checkpoint_fd < 0) return;
+
+    if (checkpoint_dirty && write_checkpoint())
+        output_perror("Failed to write checkpoint");
+
+    close(checkpoint_fd);
+    checkpoint_fd = -1;
+}
+
+/**
+ * Loads the newest valid checkpoint out of the two slots of file.
+ *
+ * Returns:
+ *  0 on success, or -1 if no slot holds a valid checkpoint.
+ */
+int load_checkpoint(checkpoint_record_t *record)
+{
+    checkpoint_record_t slot;
+    int found = 0;
+
+    for (int i = 0; i < 2; i++) {
+        ssize_t n = pread(checkpoint_fd, &slot, sizeof(slot),
+                          i * CHECKPOINT_SLOT_SIZE);
+        if (n != sizeof(slot) ||
+            memcmp(slot.magic, CHECKPOINT_MAGIC, 8) ||
+            slot.checksum != checksum_record(&slot) ||
+            slot.cwd_length >= CHECKPOINT_CWD_SIZE) {
+            continue;  // Torn, never written or not a checkpoint at all.
+        }
+        if (!found || slot.sequence > record->sequence) {
+            *record = slot;
+            found = 1;
+        }
+    }
+
+    return found ? 0 : -1;
+}
+
+/**
+ * Writes the recorded checkpoint to the slot not holding the newest one
+ * and syncs it to disk.
+ *
+ * Returns:
+ *  0 on success, else -1 with errno set.
+ */
+int write_checkpoint()
+{
+    checkpoint_record.sequence++;
+    checkpoint_record.checksum = checksum_record(&checkpoint_record);
+
+    off_t position = (checkpoint_record.sequence % 2) * CHECKPOINT_SLOT_SIZE;
+    ssize_t n = pwrite(checkpoint_fd, &checkpoint_record,
+                       sizeof(checkpoint_record), position);
+    checkpoint_last_sync = stats_now_ns();
+    checkpoint_dirty = 0;
+
+    if (n != sizeof(checkpoint_record)) {
+        if (n >= 0) errno = EIO;
+        return -1;
+    }
+    return fdatasync(checkpoint_fd);
+}
+
+/**
+ * Copies the current state of the shell into the recorded checkpoint.
+ */
+void capture_shell_state()
+{
+    // Working directory changes only through 'cd', so it is read again only
+    // after one, instead of after every line.
+    if (!checkpoint_cwd_captured ||
+        checkpoint_cwd_changes != engine_cwd_changes) {
+        if (getcwd(checkpoint_record.cwd, CHECKPOINT_CWD_SIZE)) {
+            checkpoint_record.cwd_length = strlen(checkpoint_record.cwd);
+        }
+        else {
+            checkpoint_record.cwd[0] = '\0';
+            checkpoint_record.cwd_length = 0;
+        }
+        // Keep unused bytes zeroed, so checksum doesn't depend on stale ones.
+        memset(checkpoint_record.cwd + checkpoint_record.cwd_length, 0,
+               CHECKPOINT_CWD_SIZE - checkpoint_record.cwd_length);
+
+        checkpoint_cwd_captured = 1;
+        checkpoint_cwd_changes = engine_cwd_changes;
+    }
+
+    checkpoint_record.timeout_ns = engine_default_timeout.duration_ns;
+    checkpoint_record.kill_after_ns = engine_default_timeout.kill_after_ns;
+    checkpoint_record.signal = engine_default_timeout.signal;
+}
+
+/**
+ * Computes the FNV-1a hash of all fields of a record before its checksum.
+ */
+uint64_t checksum_record(const checkpoint_record_t *record)
+{
+    const unsigned char *bytes = (const unsigned char *) record;
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < offsetof(checkpoint_record_t, checksum); i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
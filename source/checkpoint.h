@@ -0,0 +1,89 @@
+/**
+ * checkpoint.h
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This header provides checkpoints of the progress of a script, so that a
+ * script that stopped can later be resumed from the line after the last one
+ * completed, instead of being run again from its beginning.
+ *
+ * A checkpoint records the number and byte offset of the last completed
+ * line, along with the state of the shell that later lines depend on: the
+ * working directory and the default timeout of binaries. Size and
+ * modification time of the script are recorded too, so a script changed in
+ * the meantime is never resumed from a stale offset.
+ *
+ * The checkpoint file holds two slots, each one carrying a sequence number
+ * and a checksum. Every write goes to the slot not holding the newest
+ * checkpoint, so a write torn by a crash never damages the previous
+ * checkpoint, and the newest valid slot is the one loaded. Checkpoints are
+ * written and synced to disk at most once every CHECKPOINT_SYNC_INTERVAL
+ * milliseconds while lines complete, and once more when shell exits.
+ *
+ * Constants defined in checkpoint.h:
+ *  -CHECKPOINT_SYNC_INTERVAL
+ *
+ * Functions defined in checkpoint.h:
+ *  -int checkpoint_open(const char *path, const char *script, int resume,
+ *                       int *line_number, size_t *offset)
+ *  -void checkpoint_update(int line_number, size_t offset)
+ *  -void checkpoint_close()
+ *
+ * Version: 0.1
+ */
+
+#ifndef __checkpoint_h__
+#define __checkpoint_h__
+
+#include <stddef.h>
+
+
+// Minimum number of milliseconds between two syncs of checkpoint file.
+#define CHECKPOINT_SYNC_INTERVAL 1000
+
+
+/**
+ * Opens a checkpoint file for a script, creating it if it doesn't exist.
+ *
+ * When resuming, the newest checkpoint is loaded, the shell changes to its
+ * working directory and its default timeout is restored. Otherwise, any
+ * previous checkpoint is overwritten by one at the beginning of script.
+ *
+ * Parameters:
+ *  -path : Path to the checkpoint file.
+ *  -script : Path to the script whose progress is recorded.
+ *  -resume : Non-zero for resuming from the checkpoint in file.
+ *  -line_number : A reference where the number of the last completed line
+ *          is stored, 0 if none.
+ *  -offset : A reference where the offset in script after the last
+ *          completed line is stored.
+ *
+ * Returns:
+ *  0 on success, else -1, after describing the error on stderr.
+ */
+int checkpoint_open(const char *path, const char *script, int resume,
+                    int *line_number, size_t *offset);
+
+/**
+ * Records that a line of the script completed. Checkpoint is written if
+ * enough time passed since the last one was. Does nothing if no checkpoint
+ * file is open.
+ *
+ * Parameters:
+ *  -line_number : Number of the completed line.
+ *  -offset : Offset in script right after the completed line.
+ */
+void checkpoint_update(int line_number, size_t offset);
+
+/**
+ * Writes the last recorded checkpoint, if not yet written, and closes the
+ * checkpoint file. Does nothing if no checkpoint file is open.
+ */
+void checkpoint_close();
+
+#endif
@@ -18,6 +18,7 @@
 #include <string.h>
 #include <assert.h>
 #include "string_utils.h"
+#include "output.h"
 #include "command.h"
 
 
@@ -26,7 +27,7 @@ command_t *command_create()
     // Allocate space for command_t.
     command_t *comm = (command_t *) malloc(sizeof(command_t));
     if (!comm) {
-        printf("command_create: Failed to allocate memory.\n");
+        output_stderr("command_create: Failed to allocate memory.\n");
         return NULL;
     }
 
@@ -38,6 +39,26 @@ command_t *command_create()
     // Set default execution policy.
     comm->exec_policy = COMMAND_ALWAYS;
 
+    comm->type = COMMAND_SIMPLE;
+    comm->group = NULL;
+    comm->groupc = 0;
+    comm->builtin = COMMAND_BUILTIN_UNKNOWN;
+    comm->patterns = NULL;
+    comm->origin = NULL;
+
+    return comm;
+}
+
+command_t *command_create_group(int type, command_t **commands, int commandc)
+{
+    command_t *comm = command_create();
+    assert(comm);
+
+    command_set_name(comm, type == COMMAND_GROUP_BRACES ? "{" : "(");
+    comm->type = type;
+    comm->group = commands;
+    comm->groupc = commandc;
+
     return comm;
 }
 
@@ -48,6 +69,12 @@ void command_destroy(command_t *comm)
         for (int i = 0; i < comm->argc; i++) free(comm->argv[i]);
         free(comm->argv);
     }
+    free(comm->patterns);
+    if (comm->group) {
+        for (int i = 0; i < comm->groupc; i++) command_destroy(comm->group[i]);
+        free(comm->group);
+    }
+    free(comm);
 }
 
 command_t *command_create_from_str(char *str)
@@ -112,4 +139,22 @@ void command_add_arg(command_t *comm, char *arg)
     assert(comm->argv[comm->argc-1]);
 
     strcpy(comm->argv[comm->argc-1], arg);
+
+    // Flags are kept only once a pattern has been added.
+    if (comm->patterns) {
+        comm->patterns = (char *) realloc(comm->patterns, comm->argc);
+        assert(comm->patterns);
+        comm->patterns[comm->argc-1] = 0;
+    }
+}
+
+void command_add_pattern(command_t *comm, char *pattern)
+{
+    command_add_arg(comm, pattern);
+
+    if (!comm->patterns) {
+        comm->patterns = (char *) calloc(comm->argc, sizeof(char));
+        assert(comm->patterns);
+    }
+    comm->patterns[comm->argc-1] = 1;
 }
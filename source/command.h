@@ -11,12 +11,21 @@
  * This header provides an interface for proper representation of shell
  * commands and their arguments.
  *
+ * A command is either a simple one, i.e. a name with its arguments, or a
+ * group of commands enclosed in braces or parentheses, which is executed
+ * as a single command.
+ *
  * Types defined in command.h:
  *  -command_t
  *
  * Constants defined in command.h:
  *  -COMMAND_ON_PREVIOUS_SUCCEED
  *  -COMMAND_ALWAYS
+ *  -COMMAND_ON_PREVIOUS_FAIL
+ *  -COMMAND_SIMPLE
+ *  -COMMAND_GROUP_BRACES
+ *  -COMMAND_GROUP_SUBSHELL
+ *  -COMMAND_BUILTIN_UNKNOWN
  *
  * Macros defined in command.h:
  *  -command_get_name(comm)
@@ -24,13 +33,24 @@
  *  -command_get_args_num(comm)
  *  -command_get_exec_policy(comm)
  *  -command_set_exec_policy(comm, policy)
+ *  -command_get_type(comm)
+ *  -command_get_group(comm)
+ *  -command_get_group_size(comm)
+ *  -command_get_builtin(comm)
+ *  -command_set_builtin(comm, id)
+ *  -command_has_patterns(comm)
+ *  -command_is_pattern(comm, i)
+ *  -command_get_origin(comm)
  *
  * Functions defined in command.h:
  *  -command_t *command_create()
  *  -command_t *command_create_from_str(char *str)
+ *  -command_t *command_create_group(int type, command_t **commands,
+ *                                   int commandc)
  *  -void command_destroy(command_t *comm)
  *  -void command_set_name(command_t *comm, char *name)
  *  -void command_add_arg(command_t *comm, char *arg)
+ *  -void command_add_pattern(command_t *comm, char *pattern)
  *
  * Version: 0.1
  */
@@ -39,17 +59,32 @@
 #define __comand_h__
 
 
-typedef struct {
+typedef struct command {
     char *name;       // Name of command.
     char **argv;      // An array consisting of all command's arguments.
     int argc;         // Number of arguments.
     int exec_policy;  // Execution policy of this command.
+    int type;         // Whether command is simple or a group.
+    struct command **group;  // Commands of a group, NULL for simple ones.
+    int groupc;              // Number of commands of a group.
+    int builtin;      // Index of built-in it invokes, -1 if none.
+    char *patterns;   // Whether each argument is a pattern, NULL if none is.
+    struct command *origin;  // Command this one was expanded from, if any.
 } command_t;
 
 
 // Constants defining allowed execution policies.
 #define COMMAND_ON_PREVIOUS_SUCCEED 1  // Execute if previous command succeeded.
 #define COMMAND_ALWAYS 2               // Always execute this command.
+#define COMMAND_ON_PREVIOUS_FAIL 3     // Execute if previous command failed.
+
+// Constants defining types of commands.
+#define COMMAND_SIMPLE 0          // A name along with its arguments.
+#define COMMAND_GROUP_BRACES 1    // A group executed by the shell itself.
+#define COMMAND_GROUP_SUBSHELL 2  // A group isolated from the shell.
+
+// Built-in index of a command not looked up yet.
+#define COMMAND_BUILTIN_UNKNOWN -2
 
 /**
  * Returns the name of a command.
@@ -77,6 +112,50 @@ typedef struct {
  */
 #define command_set_exec_policy(comm, policy) comm->exec_policy = policy
 
+/**
+ * Returns the type of this command.
+ */
+#define command_get_type(comm) comm->type
+
+/**
+ * Returns the array of commands contained in a group.
+ */
+#define command_get_group(comm) comm->group
+
+/**
+ * Returns the number of commands contained in a group.
+ */
+#define command_get_group_size(comm) comm->groupc
+
+/**
+ * Returns the index of the built-in this command invokes (see engine.h), -1
+ * if it invokes none, or COMMAND_BUILTIN_UNKNOWN if not looked up yet.
+ */
+#define command_get_builtin(comm) comm->builtin
+
+/**
+ * Records the index of the built-in this command invokes, so it is not
+ * looked up every time it gets executed.
+ */
+#define command_set_builtin(comm, id) comm->builtin = id
+
+/**
+ * Returns whether any argument of this command is a pattern, to be expanded
+ * when the command gets executed.
+ */
+#define command_has_patterns(comm) (comm->patterns != NULL)
+
+/**
+ * Returns whether the i-th argument of this command is a pattern.
+ */
+#define command_is_pattern(comm, i) (comm->patterns && comm->patterns[i])
+
+/**
+ * Returns the command as parsed, before its patterns got expanded. That is
+ * the command itself, unless it is a copy made for execution (see engine.h).
+ */
+#define command_get_origin(comm) (comm->origin ? comm->origin : comm)
+
 /**
  * Creates an empty command object.
  *
@@ -108,7 +187,25 @@ command_t *command_create();
 command_t *command_create_from_str(char *str);
 
 /**
- * Destroys a command object.
+ * Creates a group of commands, executed as a single command.
+ *
+ * The name of a group is its opening delimiter, i.e. "{" or "(". Execution
+ * policy is set to COMMAND_ALWAYS.
+ *
+ * Parameters:
+ *  -type : COMMAND_GROUP_BRACES or COMMAND_GROUP_SUBSHELL.
+ *  -commands : Commands of the group. Group takes ownership of both the
+ *          array and the commands.
+ *  -commandc : Number of commands.
+ *
+ * Returns:
+ *  The newly created command object.
+ */
+command_t *command_create_group(int type, command_t **commands, int commandc);
+
+/**
+ * Destroys a command object, releasing the object itself along with its
+ * name and arguments, or the commands of a group.
  *
  * Parameters:
  *  -comm : Command object to destroy.
@@ -135,4 +232,15 @@ void command_set_name(command_t *comm, char *name);
  */
 void command_add_arg(command_t *comm, char *arg);
 
+/**
+ * Adds an argument to the end of argument list of given command, marking it
+ * as a pattern, which is replaced by the paths it matches when the command
+ * gets executed (see globbing.h).
+ *
+ * Parameters:
+ *  -comm : Command object in which new argument will be added.
+ *  -pattern : The pattern.
+ */
+void command_add_pattern(command_t *comm, char *pattern);
+
 #endif
@@ -0,0 +1,405 @@
+/**
+ * completion.c
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This file provides an implementation for routines declared in
+ * completion.h header.
+ *
+ * Version: 0.1
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include "dircache.h"
+#include "engine.h"
+#include "output.h"
+#include "completion.h"
+
+
+// Maximum number of PATH directories tracked separately. Directories after
+// that share the last bit of a node's directory mask.
+#define MAX_PATH_DIRS 64
+#define INOTIFY_BUFFER 16384
+
+
+// Node of the trie of command names. Children are kept sorted by char.
+typedef struct trie_node {
+    char c;                     // Character leading to this node.
+    struct trie_node *child;    // First child.
+    struct trie_node *sibling;  // Next sibling.
+    uint64_t dirs;              // PATH directories containing this command.
+    int builtin;                // Whether this command is a built-in.
+} trie_node_t;
+
+// A growable list of names collected out of the trie.
+typedef struct {
+    char **names;
+    int count;
+    int capacity;
+} name_list_t;
+
+
+void *index_commands(void *arg);
+void index_directory(int dir_id);
+void update_entry(int dir_id, const char *name, int exists);
+trie_node_t *trie_find(const char *prefix, int create);
+void trie_clear_dir(trie_node_t *node, uint64_t mask);
+void trie_collect(trie_node_t *node, char *buffer, size_t depth,
+                  name_list_t *list);
+void name_list_add(name_list_t *list, const char *name, const char *suffix);
+uint64_t dir_mask(int dir_id);
+
+
+trie_node_t trie_root;       // Root of the trie of command names.
+pthread_mutex_t trie_lock = PTHREAD_MUTEX_INITIALIZER;
+int indexer_started = 0;
+
+char *path_dirs[MAX_PATH_DIRS * 4];   // Directories contained in PATH.
+int path_wds[MAX_PATH_DIRS * 4];      // Inotify watch of each directory.
+int path_dirc = 0;
+int inotify_fd = -1;
+
+
+void completion_start()
+{
+    if (indexer_started) return;
+    indexer_started = 1;
+
+    // Built-ins are known right away.
+    pthread_mutex_lock(&trie_lock);
+    for (int i = 0; engine_builtins[i]; i++) {
+        if (!engine_builtins[i][0]) continue;
+        trie_find(engine_builtins[i], 1)->builtin = 1;
+    }
+    pthread_mutex_unlock(&trie_lock);
+
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread, &attr, index_commands, NULL)) {
+        output_stderr("Failed to start indexing of commands.\n");
+    }
+    pthread_attr_destroy(&attr);
+}
+
+int completion_find_commands(const char *prefix, char ***matches)
+{
+    name_list_t list = { NULL, 0, 0 };
+    char buffer[NAME_MAX + 1];
+    size_t length = strlen(prefix);
+
+    *matches = NULL;
+    if (length > NAME_MAX) return 0;
+
+    pthread_mutex_lock(&trie_lock);
+    trie_node_t *node = trie_find(prefix, 0);
+    if (node) {
+        memcpy(buffer, prefix, length);
+        trie_collect(node, buffer, length, &list);
+    }
+    pthread_mutex_unlock(&trie_lock);
+
+    *matches = list.names;
+    return list.count;
+}
+
+int completion_find_paths(const char *prefix, char ***matches)
+{
+    name_list_t list = { NULL, 0, 0 };
+
+    *matches = NULL;
+
+    // Split prefix into the directory to be listed and the name prefix.
+    const char *slash = strrchr(prefix, '/');
+    const char *base = slash ? slash + 1 : prefix;
+    size_t dir_length = base - prefix;
+    char *dir_part = strndup(prefix, dir_length);
+    char *dir = strndup(prefix, slash == prefix ? 1 : (slash ? dir_length - 1 : 0));
+    assert(dir_part && dir);
+
+    dir_listing_t *listing = dircache_get(dir);
+    if (listing) {
+        size_t base_length = strlen(base);
+
+        // Entries are sorted, so find the first one not less than base.
+        size_t low = 0, high = listing->count;
+        while (low < high) {
+            size_t mid = (low + high) / 2;
+            if (strcmp(listing->entries[mid].name, base) < 0) low = mid + 1;
+            else high = mid;
+        }
+
+        for (size_t i = low; i < listing->count; i++) {
+            dir_entry_t *entry = &listing->entries[i];
+            if (strncmp(entry->name, base, base_length)) break;
+            // Hidden entries only when explicitly asked for.
+            if (entry->name[0] == '.' && base[0] != '.') continue;
+
+            size_t size = dir_length + strlen(entry->name) + 1;
+            char *path = (char *) malloc(size);
+            assert(path);
+            snprintf(path, size, "%s%s", dir_part, entry->name);
+            name_list_add(&list, path,
+                          dircache_entry_is_dir(listing, entry) ? "/" : "");
+            free(path);
+        }
+    }
+
+    free(dir_part);
+    free(dir);
+
+    *matches = list.names;
+    return list.count;
+}
+
+void completion_free_matches(char **matches, int count)
+{
+    for (int i = 0; i < count; i++) free(matches[i]);
+    free(matches);
+}
+
+/**
+ * Entry point of background thread. Indexes all PATH directories and then
+ * applies the changes reported by inotify forever.
+ */
+void *index_commands(void *arg)
+{
+    (void) arg;
+
+    char *path_env = getenv("PATH");
+    if (!path_env) return NULL;
+    char *path = strdup(path_env);
+    assert(path);
+
+    inotify_fd = inotify_init1(IN_CLOEXEC);
+
+    char *saveptr;
+    for (char *dir = strtok_r(path, ":", &saveptr);
+         dir && path_dirc < MAX_PATH_DIRS * 4;
+         dir = strtok_r(NULL, ":", &saveptr)) {
+
+        path_dirs[path_dirc] = strdup(dir[0] ? dir : ".");
+        path_wds[path_dirc] = -1;
+        // Watch before scanning, so nothing changed in between is missed.
+        if (inotify_fd >= 0) {
+            path_wds[path_dirc] = inotify_add_watch(inotify_fd, dir[0] ? dir : ".",
+                IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                IN_ATTRIB | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF);
+        }
+        index_directory(path_dirc);
+        path_dirc++;
+    }
+    free(path);
+
+    if (inotify_fd < 0) return NULL;
+
+    char buffer[INOTIFY_BUFFER]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t length;
+
+    while ((length = read(inotify_fd, buffer, sizeof(buffer))) > 0) {
+        for (char *ptr = buffer; ptr < buffer + length;) {
+            struct inotify_event *event = (struct inotify_event *) ptr;
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events were lost, so start over.
+                for (int i = 0; i < path_dirc; i++) index_directory(i);
+                continue;
+            }
+
+            int dir_id = -1;
+            for (int i = 0; i < path_dirc; i++) {
+                if (path_wds[i] == event->wd) dir_id = i;
+            }
+            if (dir_id < 0) continue;
+
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                pthread_mutex_lock(&trie_lock);
+                trie_clear_dir(&trie_root, dir_mask(dir_id));
+                pthread_mutex_unlock(&trie_lock);
+                continue;
+            }
+            if (!event->len) continue;
+
+            int exists = !(event->mask & (IN_DELETE | IN_MOVED_FROM));
+            update_entry(dir_id, event->name, exists);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Indexes all executables of a PATH directory.
+ *
+ * Parameters:
+ *  -dir_id : Index of directory in path_dirs.
+ */
+void index_directory(int dir_id)
+{
+    pthread_mutex_lock(&trie_lock);
+    trie_clear_dir(&trie_root, dir_mask(dir_id));
+    pthread_mutex_unlock(&trie_lock);
+
+    DIR *dir = opendir(path_dirs[dir_id]);
+    if (!dir) return;
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+        update_entry(dir_id, entry->d_name, 1);
+    }
+
+    closedir(dir);
+}
+
+/**
+ * Adds or removes a single entry of a PATH directory to the index.
+ *
+ * Parameters:
+ *  -dir_id : Index of directory in path_dirs.
+ *  -name : Name of the entry.
+ *  -exists : Whether the entry may exist. If it exists, it is indexed only
+ *          if it is an executable file.
+ */
+void update_entry(int dir_id, const char *name, int exists)
+{
+    if (strlen(name) > NAME_MAX) return;
+
+    if (exists) {
+        struct stat st;
+        size_t size = strlen(path_dirs[dir_id]) + strlen(name) + 2;
+        char *full_path = (char *) malloc(size);
+        assert(full_path);
+        snprintf(full_path, size, "%s/%s", path_dirs[dir_id], name);
+        exists = !stat(full_path, &st) && S_ISREG(st.st_mode) &&
+                 (st.st_mode & (S_IXUSR | S_IXGRP | S_IXOTH));
+        free(full_path);
+    }
+
+    pthread_mutex_lock(&trie_lock);
+    trie_node_t *node = trie_find(name, exists);
+    if (node) {
+        if (exists) node->dirs |= dir_mask(dir_id);
+        else node->dirs &= ~dir_mask(dir_id);
+    }
+    pthread_mutex_unlock(&trie_lock);
+}
+
+/**
+ * Finds the node of the trie that corresponds to given string.
+ *
+ * WARNING: trie_lock should be held by caller.
+ *
+ * Parameters:
+ *  -prefix : The string.
+ *  -create : If non-zero, missing nodes are created.
+ *
+ * Returns:
+ *  The node of the string, or NULL if it is missing and not created.
+ */
+trie_node_t *trie_find(const char *prefix, int create)
+{
+    trie_node_t *node = &trie_root;
+
+    for (const char *c = prefix; *c; c++) {
+        trie_node_t **link = &node->child;
+        while (*link && (*link)->c < *c) link = &(*link)->sibling;
+
+        if (!*link || (*link)->c != *c) {
+            if (!create) return NULL;
+            trie_node_t *new_node = (trie_node_t *) calloc(1, sizeof(trie_node_t));
+            assert(new_node);
+            new_node->c = *c;
+            new_node->sibling = *link;
+            *link = new_node;
+        }
+        node = *link;
+    }
+
+    return node;
+}
+
+/**
+ * Removes a directory from all nodes of a subtrie.
+ */
+void trie_clear_dir(trie_node_t *node, uint64_t mask)
+{
+    for (; node; node = node->sibling) {
+        node->dirs &= ~mask;
+        trie_clear_dir(node->child, mask);
+    }
+}
+
+/**
+ * Collects in ascending order all command names of a subtrie.
+ *
+ * Parameters:
+ *  -node : Root of the subtrie.
+ *  -buffer : Buffer holding the string that leads to node.
+ *  -depth : Length of the string in buffer.
+ *  -list : List where names are appended.
+ */
+void trie_collect(trie_node_t *node, char *buffer, size_t depth,
+                  name_list_t *list)
+{
+    if (node->dirs || node->builtin) {
+        buffer[depth] = '\0';
+        name_list_add(list, buffer, "");
+    }
+
+    if (depth >= NAME_MAX) return;
+
+    for (trie_node_t *child = node->child; child; child = child->sibling) {
+        buffer[depth] = child->c;
+        trie_collect(child, buffer, depth + 1, list);
+    }
+}
+
+/**
+ * Appends name + suffix to a list of names.
+ */
+void name_list_add(name_list_t *list, const char *name, const char *suffix)
+{
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 16;
+        list->names = (char **) realloc(list->names,
+                                        sizeof(char *) * list->capacity);
+        assert(list->names);
+    }
+
+    size_t size = strlen(name) + strlen(suffix) + 1;
+    char *copy = (char *) malloc(size);
+    assert(copy);
+    snprintf(copy, size, "%s%s", name, suffix);
+
+    list->names[list->count++] = copy;
+}
+
+/**
+ * Returns the bit of a PATH directory in directory masks of nodes.
+ */
+uint64_t dir_mask(int dir_id)
+{
+    return 1ULL << (dir_id < MAX_PATH_DIRS ? dir_id : MAX_PATH_DIRS - 1);
+}
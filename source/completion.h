@@ -0,0 +1,82 @@
+/**
+ * completion.h
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This header provides lookups for completing command names and paths
+ * typed by user.
+ *
+ * Command names are served by an index of all executables found in
+ * directories of PATH, along with all built-in commands, kept in a trie.
+ * The index is built by a background thread, which afterwards keeps it up
+ * to date by watching each PATH directory through inotify. Lookups never
+ * touch the file system, so their latency doesn't depend on PATH size.
+ *
+ * Paths are completed out of cached directory listings (see dircache.h).
+ *
+ * Functions defined in completion.h:
+ *  -void completion_start()
+ *  -int completion_find_commands(const char *prefix, char ***matches)
+ *  -int completion_find_paths(const char *prefix, char ***matches)
+ *  -void completion_free_matches(char **matches, int count)
+ *
+ * Version: 0.1
+ */
+
+#ifndef __completion_h__
+#define __completion_h__
+
+
+/**
+ * Starts the background thread that builds and maintains the index of
+ * commands. Calling it more than once has no effect.
+ */
+void completion_start();
+
+/**
+ * Finds all command names that start with given prefix.
+ *
+ * Commands not indexed yet by background thread are not returned.
+ *
+ * Parameters:
+ *  -prefix : Prefix of command names.
+ *  -matches : A reference where a newly allocated array with all matching
+ *          names, in ascending order, will be returned. It should be
+ *          released with completion_free_matches().
+ *
+ * Returns:
+ *  Number of matching names.
+ */
+int completion_find_commands(const char *prefix, char ***matches);
+
+/**
+ * Finds all paths that start with given prefix.
+ *
+ * Returned paths of directories end with '/'.
+ *
+ * Parameters:
+ *  -prefix : Prefix of paths, either absolute or relative to cwd.
+ *  -matches : A reference where a newly allocated array with all matching
+ *          paths, in ascending order, will be returned. It should be
+ *          released with completion_free_matches().
+ *
+ * Returns:
+ *  Number of matching paths.
+ */
+int completion_find_paths(const char *prefix, char ***matches);
+
+/**
+ * Releases the matches returned by a completion lookup.
+ *
+ * Parameters:
+ *  -matches : The array of matches.
+ *  -count : Number of matches in array.
+ */
+void completion_free_matches(char **matches, int count);
+
+#endif
@@ -0,0 +1,379 @@
+/**
+ * coproc.c
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This file provides an implementation for routines declared in coproc.h
+ * header.
+ *
+ * Version: 0.1
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/wait.h>
+#include "command.h"
+#include "stats.h"
+#include "output.h"
+#include "coproc.h"
+
+
+// Initial size of the buffer for output of a coprocess.
+#define COPROC_BUFFER_SIZE 4096
+
+
+// A running coprocess.
+typedef struct {
+    char *name;
+    pid_t pid;
+    int in_fd;        // Where input of coprocess is written.
+    int out_fd;       // Where output of coprocess is read from.
+    char *buffer;     // Output read, but not yet consumed.
+    size_t start;     // First unconsumed byte of buffer.
+    size_t end;       // End of data in buffer.
+    size_t capacity;  // Allocated size of buffer.
+} coproc_t;
+
+
+coproc_t *find_coproc(const char *name);
+pid_t spawn_coproc(char **argv, int *in_fd, int *out_fd);
+int write_fully(int fd, const char *data, size_t length);
+char *read_coproc_line(coproc_t *coproc);
+
+
+coproc_t *coprocs = NULL;  // Running coprocesses.
+int coprocc = 0;
+int coprocs_capacity = 0;
+
+
+int start_coproc(command_t *command)
+{
+    char **args = command_get_args(command);
+    int argc = command_get_args_num(command);
+
+    if (argc < 2 || !args[0][0]) {
+        output_stderr("Usage: coproc NAME command [args...]\n");
+        return -1;
+    }
+    if (find_coproc(args[0])) {
+        output_stderr("coproc: '%s' is already running.\n", args[0]);
+        return -1;
+    }
+
+    char **argv = (char **) malloc(sizeof(char *) * argc);
+    assert(argv);
+    memcpy(argv, args + 1, sizeof(char *) * (argc - 1));
+    argv[argc - 1] = NULL;
+
+    int in_fd, out_fd;
+    pid_t pid = spawn_coproc(argv, &in_fd, &out_fd);
+    free(argv);
+    if (pid < 0) return -1;
+
+    if (coprocc == coprocs_capacity) {
+        coprocs_capacity = coprocs_capacity ? coprocs_capacity * 2 : 4;
+        coprocs = (coproc_t *) realloc(coprocs,
+                                       sizeof(coproc_t) * coprocs_capacity);
+        assert(coprocs);
+    }
+
+    coproc_t *coproc = &coprocs[coprocc++];
+    coproc->name = strdup(args[0]);
+    coproc->pid = pid;
+    coproc->in_fd = in_fd;
+    coproc->out_fd = out_fd;
+    coproc->capacity = COPROC_BUFFER_SIZE;
+    coproc->buffer = (char *) malloc(coproc->capacity);
+    coproc->start = coproc->end = 0;
+    assert(coproc->name && coproc->buffer);
+
+    return 0;
+}
+
+int send_to_coproc(command_t *command)
+{
+    char **args = command_get_args(command);
+    int argc = command_get_args_num(command);
+
+    if (argc < 1) {
+        output_stderr("Usage: coproc-send NAME words...\n");
+        return -1;
+    }
+    coproc_t *coproc = find_coproc(args[0]);
+    if (!coproc) {
+        output_stderr("coproc-send: No coprocess '%s'.\n", args[0]);
+        return -1;
+    }
+
+    size_t length = 1;
+    for (int i = 1; i < argc; i++) length += strlen(args[i]) + 1;
+    char *line = (char *) malloc(length);
+    assert(line);
+    size_t n = 0;
+    for (int i = 1; i < argc; i++) {
+        if (i > 1) line[n++] = ' ';
+        memcpy(line + n, args[i], strlen(args[i]));
+        n += strlen(args[i]);
+    }
+    line[n++] = '\n';
+
+    int rc = write_fully(coproc->in_fd, line, n);
+    free(line);
+    if (rc) output_stderr("coproc-send: '%s' is not reading input.\n", args[0]);
+
+    return rc;
+}
+
+int receive_from_coproc(command_t *command)
+{
+    char **args = command_get_args(command);
+    int argc = command_get_args_num(command);
+    long lines = 1;
+    const char *marker = NULL;
+
+    if (argc == 3 && !strcmp(args[1], "-n")) lines = atol(args[2]);
+    else if (argc == 3 && !strcmp(args[1], "--until")) marker = args[2];
+    else if (argc != 1) lines = 0;  // Invalid usage.
+
+    if (lines < 1) {
+        output_stderr("Usage: coproc-recv NAME [-n LINES | --until MARKER]\n");
+        return -1;
+    }
+    coproc_t *coproc = find_coproc(args[0]);
+    if (!coproc) {
+        output_stderr("coproc-recv: No coprocess '%s'.\n", args[0]);
+        return -1;
+    }
+
+    for (long i = 0; marker || i < lines; i++) {
+        char *line = read_coproc_line(coproc);
+        if (!line) {
+            output_stderr("coproc-recv: Output of '%s' ended.\n", args[0]);
+            return -1;
+        }
+        if (marker && !strcmp(line, marker)) break;
+        output_stdout("%s\n", line);
+    }
+
+    return 0;
+}
+
+int close_coproc(command_t *command)
+{
+    char **args = command_get_args(command);
+    int argc = command_get_args_num(command);
+
+    if (argc != 1) {
+        output_stderr("Usage: coproc-close NAME\n");
+        return -1;
+    }
+    coproc_t *coproc = find_coproc(args[0]);
+    if (!coproc) {
+        output_stderr("coproc-close: No coprocess '%s'.\n", args[0]);
+        return -1;
+    }
+
+    // Input ending is what tells a coprocess to exit.
+    close(coproc->in_fd);
+    int status = 0;
+    while (waitpid(coproc->pid, &status, 0) < 0 && errno == EINTR);
+    close(coproc->out_fd);
+
+    free(coproc->name);
+    free(coproc->buffer);
+    *coproc = coprocs[--coprocc];
+
+    return status;
+}
+
+int coproc_count()
+{
+    return coprocc;
+}
+
+/**
+ * Returns the running coprocess with the given name, or NULL.
+ */
+coproc_t *find_coproc(const char *name)
+{
+    for (int i = 0; i < coprocc; i++) {
+        if (!strcmp(coprocs[i].name, name)) return &coprocs[i];
+    }
+    return NULL;
+}
+
+/**
+ * Starts a binary with its input and output connected to the shell.
+ *
+ * Parameters:
+ *  -argv : NULL terminated arguments of binary, along with its name.
+ *  -in_fd : A reference where the descriptor to its input is stored.
+ *  -out_fd : A reference where the descriptor to its output is stored.
+ *
+ * Returns:
+ *  Process ID of coprocess, or -1 if binary couldn't be executed.
+ */
+pid_t spawn_coproc(char **argv, int *in_fd, int *out_fd)
+{
+    // Ends kept by the shell are never inherited by binaries it spawns, or
+    // coprocesses would never see their input end.
+    int to_child[2], from_child[2], exec_pipe[2];
+    if (pipe2(to_child, O_CLOEXEC)) return -1;
+    if (pipe2(from_child, O_CLOEXEC)) {
+        close(to_child[0]);
+        close(to_child[1]);
+        return -1;
+    }
+    if (pipe2(exec_pipe, O_CLOEXEC)) {
+        close(to_child[0]);
+        close(to_child[1]);
+        close(from_child[0]);
+        close(from_child[1]);
+        return -1;
+    }
+
+    shell_stats.spawns++;
+    output_flush();  // Otherwise, buffered output is written by child too.
+
+    pid_t pid = fork();
+    if (pid == 0) {  // Child code.
+        dup2(to_child[0], STDIN_FILENO);
+        dup2(from_child[1], STDOUT_FILENO);
+        execvp(argv[0], argv);
+
+        int exec_errno = errno;
+        write(exec_pipe[1], &exec_errno, sizeof(exec_errno));
+        output_stderr("No command '%s' found.\n", argv[0]);
+        output_flush();
+        _exit(exec_errno);
+    }
+
+    close(to_child[0]);
+    close(from_child[1]);
+    close(exec_pipe[1]);
+
+    int exec_errno = 0;
+    ssize_t n = -1;
+    if (pid > 0) {
+        // Blocks until child either exec()ed or failed to.
+        while ((n = read(exec_pipe[0], &exec_errno, sizeof(exec_errno))) < 0 &&
+               errno == EINTR);
+    }
+    close(exec_pipe[0]);
+
+    if (pid < 0 || n == sizeof(exec_errno)) {
+        shell_stats.spawn_failures++;
+        if (pid < 0) output_perror("coproc");
+        else while (waitpid(pid, NULL, 0) < 0 && errno == EINTR);
+        close(to_child[1]);
+        close(from_child[0]);
+        return -1;
+    }
+
+    *in_fd = to_child[1];
+    *out_fd = from_child[0];
+
+    return pid;
+}
+
+/**
+ * Writes all given data to a pipe. A reader that went away makes write
+ * fail with EPIPE, rather than terminate the shell with SIGPIPE.
+ *
+ * Returns:
+ *  0 on success, else -1.
+ */
+int write_fully(int fd, const char *data, size_t length)
+{
+    sigset_t pipe_mask, old_mask;
+    sigemptyset(&pipe_mask);
+    sigaddset(&pipe_mask, SIGPIPE);
+    sigprocmask(SIG_BLOCK, &pipe_mask, &old_mask);
+
+    int rc = 0;
+    while (length > 0) {
+        ssize_t n = write(fd, data, length);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            rc = -1;
+            break;
+        }
+        data += n;
+        length -= n;
+    }
+
+    // Discard the SIGPIPE raised, unless one was already pending before.
+    if (rc && errno == EPIPE && !sigismember(&old_mask, SIGPIPE)) {
+        struct timespec zero = { 0, 0 };
+        while (sigtimedwait(&pipe_mask, NULL, &zero) < 0 && errno == EINTR);
+    }
+    sigprocmask(SIG_SETMASK, &old_mask, NULL);
+
+    return rc;
+}
+
+/**
+ * Reads the next line of output of a coprocess, without its newline. A
+ * last line without newline is returned too.
+ *
+ * Returns:
+ *  A reference to the line inside the buffer of coprocess, valid until
+ *  the next read, or NULL when output has ended.
+ */
+char *read_coproc_line(coproc_t *coproc)
+{
+    size_t scanned = coproc->start;
+
+    while (1) {
+        char *newline = memchr(coproc->buffer + scanned, '\n',
+                               coproc->end - scanned);
+        if (newline) {
+            *newline = '\0';
+            char *line = coproc->buffer + coproc->start;
+            coproc->start = newline - coproc->buffer + 1;
+            return line;
+        }
+        scanned = coproc->end;
+
+        // Make room at the end, first by dropping consumed bytes.
+        if (coproc->start > 0) {
+            memmove(coproc->buffer, coproc->buffer + coproc->start,
+                    coproc->end - coproc->start);
+            coproc->end -= coproc->start;
+            scanned -= coproc->start;
+            coproc->start = 0;
+        }
+        if (coproc->end + 1 >= coproc->capacity) {
+            coproc->capacity *= 2;
+            coproc->buffer = (char *) realloc(coproc->buffer,
+                                              coproc->capacity);
+            assert(coproc->buffer);
+        }
+
+        ssize_t n = read(coproc->out_fd, coproc->buffer + coproc->end,
+                         coproc->capacity - coproc->end - 1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            if (coproc->end == coproc->start) return NULL;
+            coproc->buffer[coproc->end] = '\0';  // Room is always left.
+            char *line = coproc->buffer + coproc->start;
+            coproc->start = coproc->end;
+            return line;
+        }
+        coproc->end += n;
+    }
+}
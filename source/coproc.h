@@ -0,0 +1,102 @@
+/**
+ * coproc.h
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This header provides coprocesses: binaries started once and kept running
+ * in the background, with their standard input and output connected to the
+ * shell through pipes. A script can then stream many requests to a single
+ * warm process (e.g. an interpreter or a database client), instead of
+ * paying its startup for every one of them.
+ *
+ * Coprocesses are addressed by the name given when started. Lines are
+ * written to their input and their output is read back one line at a time,
+ * through a buffer kept for each coprocess. Most binaries buffer their
+ * output when it is not a terminal, so they should be told to flush it
+ * after every response (e.g. 'python3 -u').
+ *
+ * Functions defined in coproc.h:
+ *  -int start_coproc(command_t *command)
+ *  -int send_to_coproc(command_t *command)
+ *  -int receive_from_coproc(command_t *command)
+ *  -int close_coproc(command_t *command)
+ *  -int coproc_count()
+ *
+ * Version: 0.1
+ */
+
+#ifndef __coproc_h__
+#define __coproc_h__
+
+#include "command.h"
+
+
+/**
+ * Implements 'coproc' built-in command, invoked as:
+ *  coproc NAME command [args...]
+ *
+ * Parameters:
+ *  -command : The 'coproc' command.
+ *
+ * Returns:
+ *  0 if binary was started, else -1.
+ */
+int start_coproc(command_t *command);
+
+/**
+ * Implements 'coproc-send' built-in command, invoked as:
+ *  coproc-send NAME words...
+ *
+ * Words are joined by spaces and written to the input of the coprocess,
+ * followed by a newline.
+ *
+ * Parameters:
+ *  -command : The 'coproc-send' command.
+ *
+ * Returns:
+ *  0 on success, else -1 (e.g. when coprocess has exited).
+ */
+int send_to_coproc(command_t *command);
+
+/**
+ * Implements 'coproc-recv' built-in command, invoked as:
+ *  coproc-recv NAME [-n LINES | --until MARKER]
+ *
+ * Reads lines from the output of the coprocess and prints them, blocking
+ * until they arrive. Either the given number of lines are read (1 by
+ * default), or all lines up to one equal to MARKER, which is not printed.
+ *
+ * Parameters:
+ *  -command : The 'coproc-recv' command.
+ *
+ * Returns:
+ *  0 on success, else -1 (e.g. when output ended first).
+ */
+int receive_from_coproc(command_t *command);
+
+/**
+ * Implements 'coproc-close' built-in command, invoked as:
+ *  coproc-close NAME
+ *
+ * Closes the input of the coprocess and waits for it to exit.
+ *
+ * Parameters:
+ *  -command : The 'coproc-close' command.
+ *
+ * Returns:
+ *  The status of coprocess as returned by wait(), or -1 if no such
+ *  coprocess exists.
+ */
+int close_coproc(command_t *command);
+
+/**
+ * Returns the number of coprocesses started and not yet closed.
+ */
+int coproc_count();
+
+#endif
@@ -0,0 +1,621 @@
+/**
+ * copy.c
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This file provides an implementation for routines declared in copy.h
+ * header.
+ *
+ * Version: 0.1
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include "command.h"
+#include "engine.h"
+#include "output.h"
+#include "copy.h"
+
+
+#define COPY_CHUNK (1L << 30)         // Bytes requested by each copy call.
+#define COPY_BUFFER_SIZE (64 * 1024)  // Buffer used when nothing else works.
+
+
+int has_unknown_option(command_t *command, const char **known);
+int copy_fd(int in, int out);
+int copy_unsupported(int err);
+int copy_with_buffer(int in, int out, size_t limit);
+int cat_path(const char *path);
+int copy_to_path(const char *source, const char *dest);
+char *copy_dest_in_dir(const char *source, const char *dir);
+int tee_fds(int in, int *outs, char **names, int outc);
+int tee_with_buffer(int in, int *outs, char **names, int outc);
+int splice_fully(int in, int out, size_t length, size_t *left);
+void drop_output(int *outs, char **names, int j);
+void block_sigpipe(sigset_t *old_mask);
+void restore_sigpipe(const sigset_t *old_mask);
+
+
+const char *cat_options[] = { "-", NULL };
+const char *cp_options[] = { NULL };
+const char *tee_options[] = { "-a", "--append", NULL };
+
+
+int run_cat(command_t *command)
+{
+    if (has_unknown_option(command, cat_options))
+        return exec_binary(command);
+
+    char **args = command_get_args(command);
+    int argc = command_get_args_num(command);
+    int rc = 0;
+
+    output_flush();  // Output of shell precedes the files.
+
+    sigset_t old_mask;
+    block_sigpipe(&old_mask);
+
+    if (argc == 0) rc = cat_path("-");
+    for (int i = 0; i < argc; i++) {
+        if (cat_path(args[i])) {
+            rc = -1;
+            if (errno == EPIPE) break;  // Nobody reads the rest.
+        }
+    }
+
+    restore_sigpipe(&old_mask);
+
+    return rc;
+}
+
+int run_cp(command_t *command)
+{
+    if (has_unknown_option(command, cp_options))
+        return exec_binary(command);
+
+    char **args = command_get_args(command);
+    int argc = command_get_args_num(command);
+
+    if (argc < 2) {
+        output_stderr("Usage: cp source dest\n"
+                      "       cp sources... directory\n");
+        return -1;
+    }
+
+    char *target = args[argc-1];
+    struct stat st;
+    int to_dir = !stat(target, &st) && S_ISDIR(st.st_mode);
+    if (argc > 2 && !to_dir) {
+        output_stderr("cp: target '%s' is not a directory\n", target);
+        return -1;
+    }
+
+    int rc = 0;
+    for (int i = 0; i < argc - 1; i++) {
+        char *dest = to_dir ? copy_dest_in_dir(args[i], target) : target;
+        if (copy_to_path(args[i], dest)) rc = -1;
+        if (to_dir) free(dest);
+    }
+
+    return rc;
+}
+
+int run_tee(command_t *command)
+{
+    if (has_unknown_option(command, tee_options))
+        return exec_binary(command);
+
+    char **args = command_get_args(command);
+    int argc = command_get_args_num(command);
+    int append = 0;
+    int rc = 0;
+
+    int *outs = (int *) malloc(sizeof(int) * (argc + 1));
+    char **names = (char **) malloc(sizeof(char *) * (argc + 1));
+    assert(outs && names);
+
+    for (int i = 0; i < argc; i++)
+        if (args[i][0] == '-') append = 1;
+
+    outs[0] = STDOUT_FILENO;
+    names[0] = "standard output";
+    int outc = 1;
+
+    for (int i = 0; i < argc; i++) {
+        if (args[i][0] == '-') continue;
+        int fd = open(args[i], O_WRONLY | O_CREAT | O_CLOEXEC |
+                      (append ? O_APPEND : O_TRUNC), 0666);
+        if (fd < 0) {
+            output_stderr("tee: %s: %s\n", args[i], strerror(errno));
+            rc = -1;
+            continue;
+        }
+        outs[outc] = fd;
+        names[outc] = args[i];
+        outc++;
+    }
+
+    output_flush();  // Output of shell precedes the data.
+
+    sigset_t old_mask;
+    block_sigpipe(&old_mask);
+
+    if (tee_fds(STDIN_FILENO, outs, names, outc)) rc = -1;
+
+    restore_sigpipe(&old_mask);
+
+    for (int j = 1; j < outc; j++) {
+        if (outs[j] >= 0 && close(outs[j])) {
+            output_stderr("tee: %s: %s\n", names[j], strerror(errno));
+            rc = -1;
+        }
+    }
+    free(outs);
+    free(names);
+
+    return rc;
+}
+
+/**
+ * Checks whether a command is given any option not in the given list. An
+ * argument is an option when it starts with '-'.
+ *
+ * Parameters:
+ *  -command : Command whose arguments are checked.
+ *  -known : NULL terminated list of options handled by the built-in.
+ *
+ * Returns:
+ *  1 if an unknown option is found, else 0.
+ */
+int has_unknown_option(command_t *command, const char **known)
+{
+    char **args = command_get_args(command);
+    int argc = command_get_args_num(command);
+
+    for (int i = 0; i < argc; i++) {
+        if (args[i][0] != '-') continue;
+
+        int found = 0;
+        for (int j = 0; known[j] && !found; j++)
+            found = !strcmp(args[i], known[j]);
+        if (!found) return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Copies everything left in a descriptor to another one, through the first
+ * method that supports them (see copy.h).
+ *
+ * Returns:
+ *  0 on success, else -1 with errno set.
+ */
+int copy_fd(int in, int out)
+{
+    struct stat in_st, out_st;
+    ssize_t n;
+
+    // Files of /proc and /sys report no size, so copy_file_range() would
+    // find nothing to copy in them.
+    if (!fstat(in, &in_st) && !fstat(out, &out_st) &&
+        S_ISREG(in_st.st_mode) && S_ISREG(out_st.st_mode) &&
+        in_st.st_size > 0) {
+        while ((n = copy_file_range(in, NULL, out, NULL, COPY_CHUNK, 0)) > 0 ||
+               (n < 0 && errno == EINTR));
+        if (n == 0) return 0;
+        if (!copy_unsupported(errno)) return -1;
+    }
+
+    // Each method keeps the offsets where the previous one stopped.
+    while ((n = sendfile(out, in, NULL, COPY_CHUNK)) > 0 ||
+           (n < 0 && errno == EINTR));
+    if (n == 0) return 0;
+    if (!copy_unsupported(errno)) return -1;
+
+    while ((n = splice(in, NULL, out, NULL, COPY_CHUNK, SPLICE_F_MORE)) > 0 ||
+           (n < 0 && errno == EINTR));
+    if (n == 0) return 0;
+    if (!copy_unsupported(errno)) return -1;
+
+    return copy_with_buffer(in, out, 0);
+}
+
+/**
+ * Checks whether an error of a copy call means that it cannot copy between
+ * the given descriptors, so another method should be tried.
+ */
+int copy_unsupported(int err)
+{
+    return err == EINVAL || err == ENOSYS || err == EXDEV ||
+           err == EOPNOTSUPP || err == EBADF;
+}
+
+/**
+ * Copies data from a descriptor to another one, through a buffer.
+ *
+ * Parameters:
+ *  -in : Descriptor to read from.
+ *  -out : Descriptor to write to.
+ *  -limit : Number of bytes to copy, or 0 to copy until end of input.
+ *
+ * Returns:
+ *  0 on success, else -1 with errno set.
+ */
+int copy_with_buffer(int in, int out, size_t limit)
+{
+    char *buffer = (char *) malloc(COPY_BUFFER_SIZE);
+    assert(buffer);
+    int rc = 0;
+    size_t copied = 0;
+
+    while (!limit || copied < limit) {
+        size_t size = COPY_BUFFER_SIZE;
+        if (limit && limit - copied < size) size = limit - copied;
+
+        ssize_t n = read(in, buffer, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) rc = -1;
+        if (n <= 0) break;
+
+        for (ssize_t written = 0; written < n && !rc; ) {
+            ssize_t w = write(out, buffer + written, n - written);
+            if (w < 0 && errno != EINTR) rc = -1;
+            else if (w > 0) written += w;
+        }
+        if (rc) break;
+        copied += n;
+    }
+
+    int saved_errno = errno;
+    free(buffer);
+    errno = saved_errno;
+
+    return rc;
+}
+
+/**
+ * Writes a file, or stdin if path is "-", to stdout. Errors are reported,
+ * unless stdout is a pipe without readers.
+ *
+ * Returns:
+ *  0 on success, else -1 with errno set.
+ */
+int cat_path(const char *path)
+{
+    int in = STDIN_FILENO;
+    if (strcmp(path, "-")) {
+        in = open(path, O_RDONLY | O_CLOEXEC);
+        if (in < 0) {
+            output_stderr("cat: %s: %s\n", path, strerror(errno));
+            return -1;
+        }
+    }
+
+    int rc = copy_fd(in, STDOUT_FILENO);
+    int saved_errno = errno;
+    if (rc && errno != EPIPE)
+        output_stderr("cat: %s: %s\n", path, strerror(errno));
+
+    if (in != STDIN_FILENO) close(in);
+    errno = saved_errno;
+
+    return rc;
+}
+
+/**
+ * Copies a file to the given path, truncating any file already there.
+ *
+ * Returns:
+ *  0 on success, else -1.
+ */
+int copy_to_path(const char *source, const char *dest)
+{
+    int in = open(source, O_RDONLY | O_CLOEXEC);
+    struct stat in_st, out_st;
+    if (in < 0 || fstat(in, &in_st)) {
+        output_stderr("cp: cannot stat '%s': %s\n", source, strerror(errno));
+        if (in >= 0) close(in);
+        return -1;
+    }
+
+    if (S_ISDIR(in_st.st_mode)) {
+        output_stderr("cp: -r not specified; omitting directory '%s'\n",
+                      source);
+        close(in);
+        return -1;
+    }
+
+    // Truncating the destination would destroy the source too.
+    if (!stat(dest, &out_st) && out_st.st_dev == in_st.st_dev &&
+        out_st.st_ino == in_st.st_ino) {
+        output_stderr("cp: '%s' and '%s' are the same file\n", source, dest);
+        close(in);
+        return -1;
+    }
+
+    int out = open(dest, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                   in_st.st_mode & 07777);
+    if (out < 0) {
+        output_stderr("cp: cannot create regular file '%s': %s\n",
+                      dest, strerror(errno));
+        close(in);
+        return -1;
+    }
+
+    int rc = copy_fd(in, out);
+    if (rc) {
+        output_stderr("cp: error copying '%s' to '%s': %s\n",
+                      source, dest, strerror(errno));
+    }
+    close(in);
+    if (close(out) && !rc) {
+        output_stderr("cp: failed to close '%s': %s\n", dest, strerror(errno));
+        rc = -1;
+    }
+
+    return rc;
+}
+
+/**
+ * Builds the path of the copy of a file in a directory, which gets the last
+ * component of the path of the file.
+ *
+ * Returns:
+ *  The path, which should be freed by the caller.
+ */
+char *copy_dest_in_dir(const char *source, const char *dir)
+{
+    size_t end = strlen(source);
+    while (end > 1 && source[end-1] == '/') end--;
+    size_t start = end;
+    while (start > 0 && source[start-1] != '/') start--;
+
+    char *dest;
+    if (asprintf(&dest, "%s/%.*s", dir, (int) (end - start),
+                 source + start) < 0) {
+        dest = NULL;
+    }
+    assert(dest);
+
+    return dest;
+}
+
+/**
+ * Writes everything read from a descriptor to all given outputs. When input
+ * is a pipe, each chunk available in it is duplicated through tee() into a
+ * private pipe and spliced to every output but the last one, which is
+ * spliced the chunk right out of the input. Outputs that fail are dropped.
+ *
+ * Parameters:
+ *  -in : Descriptor to read from.
+ *  -outs : Descriptors to write to. Dropped ones are set to -1.
+ *  -names : Names of outputs, for error messages.
+ *  -outc : Number of outputs.
+ *
+ * Returns:
+ *  0 if all outputs were written successfully, else -1.
+ */
+int tee_fds(int in, int *outs, char **names, int outc)
+{
+    struct stat st;
+    if (fstat(in, &st) || !S_ISFIFO(st.st_mode))
+        return tee_with_buffer(in, outs, names, outc);
+
+    // Private pipe should hold whatever input pipe holds.
+    int capacity = fcntl(in, F_GETPIPE_SZ);
+    int priv[2];
+    if (capacity <= 0 || pipe2(priv, O_CLOEXEC))
+        return tee_with_buffer(in, outs, names, outc);
+    if (fcntl(priv[1], F_SETPIPE_SZ, capacity) < capacity) {
+        close(priv[0]);
+        close(priv[1]);
+        return tee_with_buffer(in, outs, names, outc);
+    }
+
+    int rc = 0;
+
+    while (1) {
+        int last = -1;
+        for (int j = 0; j < outc; j++) if (outs[j] >= 0) last = j;
+        if (last < 0) break;  // Nobody left to write to.
+
+        // Wait for a chunk, without consuming it.
+        struct pollfd pfd = { in, POLLIN, 0 };
+        int available = 0;
+        if (poll(&pfd, 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            rc = -1;
+            break;
+        }
+        if (ioctl(in, FIONREAD, &available) || available == 0) break;
+        if (available > capacity) available = capacity;
+
+        for (int j = 0; j < last; j++) {
+            if (outs[j] < 0) continue;
+
+            ssize_t n;
+            while ((n = tee(in, priv[1], available, 0)) < 0 && errno == EINTR);
+            if (n != available) {
+                output_stderr("tee: read error: %s\n",
+                              n < 0 ? strerror(errno) : "short tee");
+                rc = -1;
+                last = -1;
+                break;
+            }
+
+            size_t left;
+            if (splice_fully(priv[0], outs[j], available, &left)) {
+                drop_output(outs, names, j);
+                rc = -1;
+
+                // Data left in private pipe belongs to this chunk only.
+                close(priv[0]);
+                close(priv[1]);
+                if (pipe2(priv, O_CLOEXEC) ||
+                    fcntl(priv[1], F_SETPIPE_SZ, capacity) < capacity) {
+                    output_perror("tee");
+                    return -1;
+                }
+            }
+        }
+        if (last < 0) break;
+
+        // Last output consumes the chunk from input.
+        size_t left;
+        if (splice_fully(in, outs[last], available, &left)) {
+            drop_output(outs, names, last);
+            rc = -1;
+            // Rest of chunk was written to the other outputs already.
+            int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+            if (null_fd < 0 || splice_fully(in, null_fd, left, &left)) {
+                output_perror("tee");
+                last = -1;
+            }
+            if (null_fd >= 0) close(null_fd);
+            if (last < 0) break;
+        }
+    }
+
+    close(priv[0]);
+    close(priv[1]);
+
+    return rc;
+}
+
+/**
+ * Writes everything read from a descriptor to all given outputs, through a
+ * buffer. Used when input is not a pipe.
+ *
+ * Returns:
+ *  0 if all outputs were written successfully, else -1.
+ */
+int tee_with_buffer(int in, int *outs, char **names, int outc)
+{
+    char *buffer = (char *) malloc(COPY_BUFFER_SIZE);
+    assert(buffer);
+    int rc = 0;
+    int live = outc;
+
+    while (live > 0) {
+        ssize_t n = read(in, buffer, COPY_BUFFER_SIZE);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            output_stderr("tee: read error: %s\n", strerror(errno));
+            rc = -1;
+        }
+        if (n <= 0) break;
+
+        for (int j = 0; j < outc; j++) {
+            if (outs[j] < 0) continue;
+            for (ssize_t written = 0; written < n; ) {
+                ssize_t w = write(outs[j], buffer + written, n - written);
+                if (w < 0 && errno == EINTR) continue;
+                if (w < 0) {
+                    drop_output(outs, names, j);
+                    rc = -1;
+                    live--;
+                    break;
+                }
+                written += w;
+            }
+        }
+    }
+
+    free(buffer);
+
+    return rc;
+}
+
+/**
+ * Moves exactly the given number of bytes from a pipe to a descriptor.
+ * Outputs that don't support splice() get the rest through a buffer.
+ *
+ * Parameters:
+ *  -in : Pipe to read from.
+ *  -out : Descriptor to write to.
+ *  -length : Number of bytes to move.
+ *  -left : A reference where the number of bytes not moved is stored.
+ *
+ * Returns:
+ *  0 on success, else -1 with errno set.
+ */
+int splice_fully(int in, int out, size_t length, size_t *left)
+{
+    while (length > 0) {
+        ssize_t n = splice(in, NULL, out, NULL, length, SPLICE_F_MORE);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno == EINVAL) {
+            *left = length;
+            if (copy_with_buffer(in, out, length)) return -1;
+            length = 0;
+            break;
+        }
+        if (n <= 0) break;
+        length -= n;
+    }
+
+    *left = length;
+    return length > 0 ? -1 : 0;
+}
+
+/**
+ * Stops writing to an output of 'tee' that failed, reporting why, unless
+ * it is a pipe without readers.
+ */
+void drop_output(int *outs, char **names, int j)
+{
+    if (errno != EPIPE)
+        output_stderr("tee: %s: %s\n", names[j], strerror(errno));
+    if (outs[j] != STDOUT_FILENO) close(outs[j]);
+    outs[j] = -1;
+}
+
+/**
+ * Blocks SIGPIPE, so writing to a pipe without readers fails with EPIPE,
+ * rather than terminating the shell.
+ *
+ * Parameters:
+ *  -old_mask : A reference where the previous signal mask is stored.
+ */
+void block_sigpipe(sigset_t *old_mask)
+{
+    sigset_t pipe_mask;
+    sigemptyset(&pipe_mask);
+    sigaddset(&pipe_mask, SIGPIPE);
+    sigprocmask(SIG_BLOCK, &pipe_mask, old_mask);
+}
+
+/**
+ * Discards any SIGPIPE raised while it was blocked by block_sigpipe() and
+ * restores the previous signal mask.
+ */
+void restore_sigpipe(const sigset_t *old_mask)
+{
+    if (!sigismember(old_mask, SIGPIPE)) {
+        sigset_t pipe_mask;
+        sigemptyset(&pipe_mask);
+        sigaddset(&pipe_mask, SIGPIPE);
+        struct timespec zero = { 0, 0 };
+        while (sigtimedwait(&pipe_mask, NULL, &zero) > 0 || errno == EINTR);
+    }
+    sigprocmask(SIG_SETMASK, old_mask, NULL);
+}
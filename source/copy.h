@@ -0,0 +1,91 @@
+/**
+ * copy.h
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This header provides 'cat', 'cp' and 'tee' built-in commands, which move
+ * data between files inside the kernel, so copying a file costs neither a
+ * fork nor passing its bytes through a buffer of the shell.
+ *
+ * Data is copied with the first of the following calls that works for the
+ * given pair of descriptors:
+ *  -copy_file_range(), between regular files, which lets the file system
+ *   share the blocks (reflink) or copy them on the server (NFS, SMB).
+ *  -sendfile(), from a regular file to anything else, e.g. a pipe.
+ *  -splice(), when either of them is a pipe.
+ * Only when none works (e.g. between two terminals), data is read into a
+ * buffer and written back.
+ *
+ * 'tee' duplicates the pages of its input pipe through tee() into each one
+ * of its outputs, consuming them only for the last one.
+ *
+ * The built-ins support only the plain form of each command. When given any
+ * option they don't know, the binary of the same name is executed instead,
+ * so scripts behave as with coreutils.
+ *
+ * Functions defined in copy.h:
+ *  -int run_cat(command_t *command)
+ *  -int run_cp(command_t *command)
+ *  -int run_tee(command_t *command)
+ *
+ * Version: 0.1
+ */
+
+#ifndef __copy_h__
+#define __copy_h__
+
+#include "command.h"
+
+
+/**
+ * Implements 'cat' built-in command, invoked as:
+ *  cat [files...]
+ *
+ * Files are written to stdout in order. "-", or no file at all, stands for
+ * stdin.
+ *
+ * Parameters:
+ *  -command : The 'cat' command, whose arguments are the files.
+ *
+ * Returns:
+ *  0 if all files were written, else -1.
+ */
+int run_cat(command_t *command);
+
+/**
+ * Implements 'cp' built-in command, invoked as:
+ *  cp source dest
+ *  cp sources... directory
+ *
+ * Created files get the permissions of their sources, masked by umask.
+ * Existing files keep their permissions and are truncated.
+ *
+ * Parameters:
+ *  -command : The 'cp' command, whose arguments are the paths.
+ *
+ * Returns:
+ *  0 if all sources were copied, else -1.
+ */
+int run_cp(command_t *command);
+
+/**
+ * Implements 'tee' built-in command, invoked as:
+ *  tee [-a] [files...]
+ *
+ * Stdin is written to stdout and to every file given, which is truncated,
+ * or appended to with -a.
+ *
+ * Parameters:
+ *  -command : The 'tee' command, whose arguments are the files.
+ *
+ * Returns:
+ *  0 if all data were written to all files, else -1.
+ */
+int run_tee(command_t *command);
+
+#endif
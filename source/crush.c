@@ -10,13 +10,36 @@
  *
  * This file is the entry point for the implementation of CRuSh shell.
  *
- * CRuSh can be run into the following two modes:
+ * CRuSh can be run into the following five modes:
  *  1. Interactive Mode : Shell is invoked for manual command input by user.
  *      --> Executed as ./crush_exec_path
  *  2. Batch Mode : Shell is invoked for the execution of a provided script.
  *      --> Executed as ./crush_exec_path <script_path>
  *              where:
  *                  -script path: Path to the script file.
+ *  3. Concurrent Batch Mode : Shell is invoked for the execution of many
+ *          scripts, running up to N of them at once.
+ *      --> Executed as ./crush_exec_path -j N <script_path> ...
+ *  4. Command Mode : Shell is invoked for the execution of the commands
+ *          given as an argument, e.g. as SHELL of make. Nothing besides
+ *          these commands is done, so startup is as fast as possible. The
+ *          shell is replaced by the last binary invoked, instead of waiting
+ *          for it.
+ *      --> Executed as ./crush_exec_path -c <commands>
+ *  5. Dependency Graph Mode : Shell is invoked for the execution of a script
+ *          whose lines are steps depending on each other (see dag.h).
+ *          Independent steps run at once, up to N of them (by default, as
+ *          many as the online CPUs).
+ *      --> Executed as ./crush_exec_path --dag [-j N] <script_path>
+ *
+ * Options accepted before script path in all modes:
+ *  --metrics-file <path> : Periodically and at exit, export runtime counters
+ *          of the shell to given file in Prometheus textfile format.
+ *
+ * Options accepted before script path in batch mode:
+ *  --checkpoint <path> : Record the progress of script in given file. Script
+ *          stops at the first line that fails.
+ *  --resume : Resume script after the last line recorded in checkpoint.
  *
  * Version: 0.1
  */
@@ -26,43 +49,221 @@
 #include <string.h>
 #include <assert.h>
 #include <unistd.h>
+#include <getopt.h>
+#include <sys/wait.h>
 #include "command.h"
 #include "string_utils.h"
 #include "engine.h"
 #include "parser.h"
+#include "stats.h"
+#include "reader.h"
+#include "completion.h"
+#include "history.h"
+#include "runner.h"
+#include "dag.h"
+#include "checkpoint.h"
+#include "jobserver.h"
+#include "prefetch.h"
+#include "snapshot.h"
+#include "parsecache.h"
+#include "perfstat.h"
+#include "output.h"
 
 
-#define LINE_SIZE 512               // Maximum allowed length of each line.
 const char *DEFAULT_PROMPT = ">";   // Prompt to be displayed on shell.
+int checkpointing = 0;  // Whether completed lines are recorded to checkpoint.
+int tail_exec = 0;      // Whether shell may be replaced by its last command.
 
 
-void start_shell(FILE *input_stream);
+int start_shell(reader_t *reader, int interactive);
+int run_script(const char *path);
+void share_jobs(int jobs);
 char *get_prompt(char *buffer, size_t size);
 void print_welcome_message();
+void print_usage(const char *exec_name);
+
+
+// Long options accepted by the shell.
+static struct option long_options[] = {
+    {"metrics-file", required_argument, NULL, 'm'},
+    {"jobs", required_argument, NULL, 'j'},
+    {"dag", no_argument, NULL, 'd'},
+    {"checkpoint", required_argument, NULL, 'k'},
+    {"resume", no_argument, NULL, 'r'},
+    {"save-state", required_argument, NULL, 's'},
+    {"load-state", required_argument, NULL, 'l'},
+    {"perfstat", no_argument, NULL, 'p'},
+    {0, 0, 0, 0}
+};
 
 
 int main(int argc, char *argv[])
 {
-    FILE *input_stream;  // Input stream to read commands from.
+    reader_t *reader;  // Reader of the lines of commands.
+    int interactive;   // Whether commands are typed by user.
+    int jobs = 0;      // Scripts run at once, when many scripts are given.
+    int dag = 0;       // Whether script is a dependency graph.
+    char *checkpoint = NULL;  // Checkpoint file of script.
+    int resume = 0;    // Whether script resumes from checkpoint.
+    char *commands = NULL;  // Commands given to -c.
+    int metrics = 0;   // Whether metrics file is written at exit.
+    char *save_state = NULL;  // Snapshot written at exit.
+    int opt;
+
+    // Parse options. Stop on the first non-option, which is the script.
+    while ((opt = getopt_long(argc, argv, "+j:c:", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'm':
+                stats_set_metrics_file(optarg);
+                metrics = 1;
+                break;
+            case 'c':
+                commands = optarg;
+                break;
+            case 'd':
+                dag = 1;
+                break;
+            case 'k':
+                checkpoint = optarg;
+                break;
+            case 'r':
+                resume = 1;
+                break;
+            case 's':
+                save_state = optarg;
+                break;
+            case 'l':
+                if (snapshot_load(optarg)) exit(-1);
+                break;
+            case 'p':
+                perfstat_report_at_exit();
+                break;
+            case 'j':
+                jobs = atoi(optarg);
+                if (jobs < 1) {
+                    print_usage(argv[0]);
+                    exit(-1);
+                }
+                break;
+            default:
+                print_usage(argv[0]);
+                exit(-1);
+        }
+    }
+
+    // Checkpoints apply only to a single script run line by line.
+    if ((checkpoint || resume) &&
+        (!checkpoint || commands || jobs || dag || argc - optind != 1)) {
+        print_usage(argv[0]);
+        exit(-1);
+    }
+
+    if (save_state) snapshot_save_at_exit(save_state);
+
+    // With -c, just run the given commands and exit with their status.
+    // No banner, prompt, history or completion is set up on this path.
+    if (commands) {
+        // Like dash, exec the last binary instead of waiting for it, unless
+        // metrics or state have to be written at exit.
+        tail_exec = !metrics && !save_state;
+        reader = reader_create_from_string(commands);
+        start_shell(reader, 0);
+        reader_destroy(reader);
+        return exit_code(engine_last_status);
+    }
+
+    // With --dag, the single script given is run as a graph of steps.
+    if (dag) {
+        if (argc - optind != 1) {
+            print_usage(argv[0]);
+            exit(-1);
+        }
+        if (!jobs) jobs = sysconf(_SC_NPROCESSORS_ONLN);
+        if (jobs < 1) jobs = 1;
+        share_jobs(jobs);
+        int failures = run_dag(argv[optind], jobs);
+        if (failures < 0) return 2;
+        return failures ? 1 : 0;
+    }
 
-    // If a script is provided, commands stream is redirected to this file.
-    if (argc > 1) {
-        input_stream = fopen(argv[1], "r");
-        if (!input_stream) {
-            printf("Failed to open %s script.\n", argv[1]);
+    // With -j, all scripts given are run concurrently.
+    if (jobs) {
+        if (optind == argc) {
+            print_usage(argv[0]);
             exit(-1);
         }
+        share_jobs(jobs);
+        int failures = run_scripts(argv + optind, argc - optind, jobs,
+                                   run_script);
+        return failures ? 1 : 0;
+    }
+
+    // If a script is provided, commands are read from this file.
+    if (optind < argc) {
+        reader = reader_create_from_file(argv[optind]);
+        if (!reader) {
+            output_stderr("Failed to open %s script.\n", argv[optind]);
+            exit(-1);
+        }
+        interactive = 0;
+
+        // Like -c, the last binary of the script replaces the shell, unless
+        // something is left to be done at exit.
+        tail_exec = !metrics && !save_state && !checkpoint;
+
+        if (checkpoint) {
+            int line_number;
+            size_t offset;
+            if (checkpoint_open(checkpoint, argv[optind], resume,
+                                &line_number, &offset)) {
+                exit(-1);
+            }
+            // Continue right after the last completed line.
+            if (reader_seek(reader, offset, line_number)) {
+                output_stderr("Cannot resume %s script, since it is not a "
+                              "regular file.\n", argv[optind]);
+                exit(-1);
+            }
+            checkpointing = 1;
+        }
+    }
+    else if (!isatty(STDIN_FILENO)) {
+        // Commands fed by another process are run like a script, without
+        // banner or prompts, which would be mixed with output.
+        reader = reader_create_from_fd(STDIN_FILENO);
+        interactive = 0;
     }
     else {
         print_welcome_message();
-        input_stream = stdin;
+        if (isatty(STDOUT_FILENO)) {
+            // Commands typed on a terminal get line editing, completion
+            // and persistent history.
+            char history_path[4096];
+            if (history_default_path(history_path, sizeof(history_path)))
+                history_open(history_path);
+            completion_start();
+            reader = reader_create_from_terminal();
+        }
+        else {
+            reader = reader_create_from_stream(stdin);
+        }
+        reader_set_prompt(reader, get_prompt);
+        interactive = 1;
     }
 
     // Invoke the shell.
-    start_shell(input_stream);
+    int failed_lines = start_shell(reader, interactive);
+
+    reader_destroy(reader);
+    history_close();
+    checkpoint_close();
+
+    // A checkpointed script stops at its first failure, which is reported.
+    if (checkpointing && failed_lines) return exit_code(engine_last_status);
 
-    // If a script file was used as source for commands, release it.
-    if (input_stream != stdin) fclose(input_stream);
+    // Like sh, a script exits with the status of its last command, which is
+    // also the status of a last binary that replaced the shell.
+    if (optind < argc) return exit_code(engine_last_status);
 
     return 0;
 }
@@ -71,55 +272,127 @@ int main(int argc, char *argv[])
  * Invokes the shell.
  *
  * Parameters:
- *  -input_stream : The file stream, from where commands will be read. If
- *          shell is invoked in interactive mode, that argument should be
+ *  -reader : The reader, from where lines of commands will be read. If
+ *          shell is invoked in interactive mode, that should be a reader of
  *          stdin. If shell is invoked in batch mode, in order to run a script,
- *          this argument should be the FILE object representing the script
- *          file.
+ *          this should be a reader of the script file.
+ *  -interactive : Non-zero when commands are typed by user. Prompt is
+ *          displayed by the reader itself.
+ *
+ * Returns:
+ *  The number of lines that either failed to parse or contained commands
+ *  that failed.
  */
-void start_shell(FILE *input_stream)
+int start_shell(reader_t *reader, int interactive)
 {
-    char line[LINE_SIZE];  // Text of each line to be executed.
-    char prompt[1024];     // Prompt to be displayed. Don't allocate for prompts
-                           // larger than 1024 chars. They are useless anyway.
+    char *line;            // Text of each line to be executed.
     command_t **commands;  // Commands parsed out of current line.
     int commandc;          // Number of parsed commands.
+    int shared;            // Whether commands are owned by parse cache.
+    int failed_lines = 0;  // Lines that failed to parse or execute.
     int rc;
-    int line_count = 0;    // Counter of current line read. Meaningful only
-                           // when executing scripts.
 
-    // When at interactive mode, initially print prompt.
-    if (input_stream == stdin) printf("%s ", get_prompt(prompt, sizeof(prompt)));
+    // Keep reading a line from reader, whatever it is (script or stdin).
+    while((line = reader_next_line(reader)) != NULL) {
 
-    // Keep reading a line from input stream, whatever it is (script or stdin).
-    while(fgets(line, LINE_SIZE, input_stream)) {
-
-        if (input_stream != stdin) line_count++;
+        if (interactive) history_add(line, reader_get_line_length(reader));
 
         // Parse the current line into commands that can be executed.
-        rc = parse_line(line, &commands, &commandc);
+        rc = parsecache_parse_line(line, reader_get_line_length(reader),
+                                   reader_get_structurals(reader),
+                                   reader_get_structc(reader),
+                                   &commands, &commandc, &shared);
         if (rc) {
-            printf("Could not parse line ");
-            if (input_stream != stdin) printf("%d ", line_count);
-            printf(": '%s'\n", line);
+            output_stderr("Could not parse line ");
+            if (!interactive)
+                output_stderr("%d ", reader_get_line_number(reader));
+            output_stderr(": '%s'\n", line);
+            // Like sh, a line that cannot be parsed fails with status 2.
+            engine_last_status = W_EXITCODE(2, 0);
+        }
+
+        // Start reading the binaries of the next lines, while this one runs.
+        if (!interactive && reader_get_lookahead(reader)) {
+            prefetch_ahead(reader_get_lookahead(reader),
+                           reader_get_lookahead_size(reader),
+                           reader_get_offset(reader));
         }
 
         // Execute the parsed commands, only if parsing succeeded.
         if (!rc) {
-            rc = exec_commands(commands, commandc);
+            if (tail_exec && reader_at_end(reader))
+                rc = exec_commands_tail(commands, commandc);
+            else
+                rc = exec_commands(commands, commandc);
             // if (rc) {
-            //     printf("Execution of line '%s' failed.\n",
+            //     output_stderr("Execution of line '%s' failed.\n",
             //            command_get_name(commands[rc-1]));
             // }
         }
 
-        // Cleanup already executed commands.
-        for (int i = 0; i < commandc; i++) command_destroy(commands[i]);
+        if (rc) failed_lines++;
+
+        // Cleanup already executed commands, unless kept for next times.
+        if (!shared) {
+            for (int i = 0; i < commandc; i++) command_destroy(commands[i]);
+            free(commands);
+        }
+
+        stats_tick();
+
+        // When checkpointing, stop at a failed line, so that resuming starts
+        // from it.
+        if (checkpointing) {
+            if (rc) {
+                output_stderr("Stopped at line %d, which failed.\n",
+                              reader_get_line_number(reader));
+                break;
+            }
+            checkpoint_update(reader_get_line_number(reader),
+                              reader_get_offset(reader));
+        }
+    }
+
+    return failed_lines;
+}
 
-        // Print prompt for the next command.
-        if (input_stream == stdin)
-            printf("%s ", get_prompt(prompt, sizeof(prompt)));
+/**
+ * Runs a script in batch mode. Used by the workers of concurrent batch mode.
+ *
+ * Parameters:
+ *  -path : Path to the script file.
+ *
+ * Returns:
+ *  0 if all lines of the script executed successfully, 1 if any of them
+ *  failed, or 2 if script cannot be opened.
+ */
+int run_script(const char *path)
+{
+    reader_t *reader = reader_create_from_file(path);
+    if (!reader) {
+        output_stderr("Failed to open %s script.\n", path);
+        return 2;
     }
+
+    int failed_lines = start_shell(reader, 0);
+    reader_destroy(reader);
+
+    return failed_lines ? 1 : 0;
+}
+
+/**
+ * Makes concurrent jobs count against the jobserver of make, when shell
+ * runs under it. Otherwise, shell serves the given number of job slots
+ * itself, to any make or shell spawned by its jobs.
+ *
+ * Parameters:
+ *  -jobs : Maximum number of jobs running at once.
+ */
+void share_jobs(int jobs)
+{
+    if (!jobserver_connect()) return;
+    if (jobserver_serve(jobs))
+        output_stderr("Failed to set up a jobserver for %d jobs.\n", jobs);
 }
 
 /**
@@ -154,9 +427,9 @@ char *get_prompt(char *buffer, size_t size)
     static char *no_space_buffer = NULL;
     if (size < strlen(fallback_text)+1) {
         if (!no_space) {
-            printf("Internal Error: Someone idiot,\n");
-            printf("did not allocate memory even for a tiny prompt.\n");
-            printf("No detailed prompt for you.\n");
+            output_stderr("Internal Error: Someone idiot,\n");
+            output_stderr("did not allocate memory even for a tiny prompt.\n");
+            output_stderr("No detailed prompt for you.\n");
             no_space = 1;  // Display this massage only one.
             no_space_buffer = (char *) malloc(sizeof(char) * 2);
             no_space_buffer[0] = '>';
@@ -204,9 +477,42 @@ char *get_prompt(char *buffer, size_t size)
  */
 void print_welcome_message()
 {
-    printf("Welcome to CRuSh (Completely Rubbish Shell)!\n");
-    printf("The shell that won't let you sleep again...\n");
-    printf("--Brought to you by Dimitrios Karageorgiou--\n");
-    printf("--Official repo: https://github.com/dkarageo/crush --\n");
-    printf("\n");
+    output_stdout("Welcome to CRuSh (Completely Rubbish Shell)!\n");
+    output_stdout("The shell that won't let you sleep again...\n");
+    output_stdout("--Brought to you by Dimitrios Karageorgiou--\n");
+    output_stdout("--Official repo: https://github.com/dkarageo/crush --\n");
+    output_stdout("\n");
+}
+
+/**
+ * Prints the accepted command line arguments.
+ *
+ * Parameters:
+ *  -exec_name : Name the shell was invoked with.
+ */
+void print_usage(const char *exec_name)
+{
+    output_stderr("Usage: %s [options] [script]\n", exec_name);
+    output_stderr("       %s [options] -j N script...\n", exec_name);
+    output_stderr("       %s [options] -c commands\n", exec_name);
+    output_stderr("       %s [options] --dag [-j N] script\n", exec_name);
+    output_stderr("       %s [options] --checkpoint file [--resume] script\n",
+                  exec_name);
+    output_stderr("Options:\n");
+    output_stderr("  --metrics-file <path>  Export runtime counters in Prometheus "
+                  "textfile format.\n");
+    output_stderr("  -j, --jobs N           Run all given scripts, up to N at "
+                  "once.\n");
+    output_stderr("  -c commands            Run the given commands and exit.\n");
+    output_stderr("  --dag                  Run the steps of script by their "
+                  "dependencies.\n");
+    output_stderr("  --checkpoint file      Record progress of script, stopping "
+                  "at a failed line.\n");
+    output_stderr("  --resume               Resume script from its checkpoint.\n");
+    output_stderr("  --save-state file      Save state of shell to file at "
+                  "exit.\n");
+    output_stderr("  --load-state file      Start with the state saved in "
+                  "file.\n");
+    output_stderr("  --perfstat             Report performance counters of "
+                  "every binary run.\n");
 }
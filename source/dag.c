@@ -0,0 +1,539 @@
+/**
+ * dag.c
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This file provides an implementation for routines declared in dag.h
+ * header.
+ *
+ * Version: 0.1
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "command.h"
+#include "engine.h"
+#include "parser.h"
+#include "reader.h"
+#include "runner.h"
+#include "jobserver.h"
+#include "stats.h"
+#include "output.h"
+#include "dag.h"
+
+
+// States of a step.
+#define STEP_WAITING 0     // Some dependencies haven't finished yet.
+#define STEP_READY 1       // Waiting for a free worker.
+#define STEP_RUNNING 2
+#define STEP_SUCCEEDED 3
+#define STEP_FAILED 4
+#define STEP_CANCELLED 5   // A dependency failed, so it never ran.
+
+
+typedef struct {
+    char *name;              // Name of step.
+    char *command;           // Line of commands run by step.
+    char **dep_names;        // Names of steps it depends on.
+    int depc;                // Number of dependencies.
+    int *dependents;         // Steps depending on this one.
+    int dependentc;
+    int pending;             // Dependencies not finished yet.
+    int critical;            // Steps in longest chain starting from this one.
+    int state;               // One of STEP_* constants.
+    int line_number;         // Line of script defining the step.
+    pid_t pid;               // Worker running the step.
+    int stats_fd;            // Where worker reports its counters.
+    int status;              // Status of worker, as returned by wait().
+    unsigned long long start_ns;
+    unsigned long long end_ns;
+} step_t;
+
+typedef struct {
+    step_t *steps;
+    int count;
+    int capacity;
+    int *ready;              // Heap of ready steps, by critical path.
+    int readyc;
+} dag_t;
+
+
+int load_steps(dag_t *dag, const char *path);
+int parse_step(dag_t *dag, char *line, int line_number);
+int link_steps(dag_t *dag);
+int order_steps(dag_t *dag);
+void run_steps(dag_t *dag, int jobs);
+void start_step(dag_t *dag, int id);
+void finish_step(dag_t *dag, int id, int status);
+int cancel_dependents(dag_t *dag, int id);
+void ready_push(dag_t *dag, int id);
+int ready_pop(dag_t *dag);
+int ready_before(dag_t *dag, int a, int b);
+int compare_names(const void *a, const void *b);
+void print_steps_summary(dag_t *dag);
+void destroy_steps(dag_t *dag);
+
+
+dag_t *sort_dag;  // Graph whose steps are sorted by compare_names().
+
+
+int run_dag(const char *path, int jobs)
+{
+    dag_t dag;
+    memset(&dag, 0, sizeof(dag));
+
+    if (load_steps(&dag, path) || link_steps(&dag) || order_steps(&dag)) {
+        destroy_steps(&dag);
+        return -1;
+    }
+
+    run_steps(&dag, jobs);
+    print_steps_summary(&dag);
+
+    int failures = 0;
+    for (int i = 0; i < dag.count; i++) {
+        if (dag.steps[i].state != STEP_SUCCEEDED) failures++;
+    }
+
+    destroy_steps(&dag);
+
+    return failures;
+}
+
+/**
+ * Reads all steps defined in a script.
+ *
+ * Returns:
+ *  0 on success, else -1.
+ */
+int load_steps(dag_t *dag, const char *path)
+{
+    reader_t *reader = reader_create_from_file(path);
+    if (!reader) {
+        output_stderr("Failed to open %s script.\n", path);
+        return -1;
+    }
+
+    int rc = 0;
+    char *line;
+    while (!rc && (line = reader_next_line(reader)) != NULL) {
+        rc = parse_step(dag, line, reader_get_line_number(reader));
+    }
+
+    reader_destroy(reader);
+
+    if (!rc && !dag->count) {
+        output_stderr("No steps defined in %s script.\n", path);
+        rc = -1;
+    }
+
+    return rc;
+}
+
+/**
+ * Parses a line of the form "step <name>: <dependencies> -> <commands>"
+ * and adds the defined step to graph. Blank and comment lines are ignored.
+ *
+ * Returns:
+ *  0 on success, else -1.
+ */
+int parse_step(dag_t *dag, char *line, int line_number)
+{
+    char *p = line + strspn(line, " \t\r\n");
+    if (!*p || *p == '#') return 0;
+
+    char *arrow = strstr(p, "->");
+    if (strncmp(p, "step", 4) || !strchr(" \t", p[4]) || !arrow) {
+        output_stderr("Line %d: Expected 'step <name>: <dependencies> -> "
+                      "<commands>'.\n", line_number);
+        return -1;
+    }
+
+    // Name, terminated by ':'.
+    p += 4;
+    p += strspn(p, " \t");
+    size_t name_length = strcspn(p, " \t:");
+    char *colon = p + name_length + strspn(p + name_length, " \t");
+    if (!name_length || *colon != ':' || colon > arrow) {
+        output_stderr("Line %d: Expected ':' after name of step.\n",
+                      line_number);
+        return -1;
+    }
+
+    if (dag->count == dag->capacity) {
+        dag->capacity = dag->capacity ? dag->capacity * 2 : 16;
+        dag->steps = (step_t *) realloc(dag->steps,
+                                        sizeof(step_t) * dag->capacity);
+        assert(dag->steps);
+    }
+    step_t *step = &dag->steps[dag->count++];
+    memset(step, 0, sizeof(step_t));
+    step->name = strndup(p, name_length);
+    step->line_number = line_number;
+
+    // Dependencies, separated by blanks, up to the arrow.
+    *arrow = '\0';
+    char *dep = colon + 1;
+    while (*(dep += strspn(dep, " \t"))) {
+        size_t length = strcspn(dep, " \t");
+        step->dep_names = (char **) realloc(step->dep_names,
+                                            sizeof(char *) * (step->depc + 1));
+        assert(step->dep_names);
+        step->dep_names[step->depc++] = strndup(dep, length);
+        dep += length;
+    }
+    *arrow = '-';
+
+    // Commands, without surrounding blanks.
+    char *command = arrow + 2;
+    command += strspn(command, " \t");
+    size_t length = strlen(command);
+    while (length && strchr(" \t\r\n", command[length-1])) length--;
+    step->command = strndup(command, length);
+
+    return 0;
+}
+
+/**
+ * Resolves the dependencies of all steps by name and finds the dependents
+ * of each step.
+ *
+ * Returns:
+ *  0 on success, or -1 if names are duplicate or unknown.
+ */
+int link_steps(dag_t *dag)
+{
+    // Index of steps sorted by name, for looking them up.
+    int *sorted = (int *) malloc(sizeof(int) * dag->count);
+    assert(sorted);
+    for (int i = 0; i < dag->count; i++) sorted[i] = i;
+    sort_dag = dag;
+    qsort(sorted, dag->count, sizeof(int), compare_names);
+
+    int rc = 0;
+    for (int i = 1; i < dag->count; i++) {
+        step_t *a = &dag->steps[sorted[i-1]];
+        step_t *b = &dag->steps[sorted[i]];
+        if (!strcmp(a->name, b->name)) {
+            output_stderr("Line %d: Step '%s' is already defined in line %d.\n",
+                          b->line_number, b->name, a->line_number);
+            rc = -1;
+        }
+    }
+
+    for (int i = 0; i < dag->count && !rc; i++) {
+        step_t *step = &dag->steps[i];
+        step->pending = step->depc;
+
+        for (int d = 0; d < step->depc; d++) {
+            // Look up name among sorted steps.
+            int low = 0, high = dag->count;
+            while (low < high) {
+                int mid = (low + high) / 2;
+                if (strcmp(dag->steps[sorted[mid]].name, step->dep_names[d]) < 0)
+                    low = mid + 1;
+                else
+                    high = mid;
+            }
+            if (low == dag->count ||
+                strcmp(dag->steps[sorted[low]].name, step->dep_names[d])) {
+                output_stderr("Line %d: Step '%s' depends on unknown step "
+                              "'%s'.\n", step->line_number, step->name,
+                              step->dep_names[d]);
+                rc = -1;
+                break;
+            }
+
+            step_t *dep = &dag->steps[sorted[low]];
+            dep->dependents = (int *) realloc(dep->dependents,
+                                              sizeof(int) * (dep->dependentc + 1));
+            assert(dep->dependents);
+            dep->dependents[dep->dependentc++] = i;
+        }
+    }
+
+    free(sorted);
+
+    return rc;
+}
+
+/**
+ * Sorts steps topologically, in order to detect cycles and compute the
+ * critical path of each step. Steps without dependencies become ready.
+ *
+ * Returns:
+ *  0 on success, or -1 if graph contains a cycle.
+ */
+int order_steps(dag_t *dag)
+{
+    int *order = (int *) malloc(sizeof(int) * dag->count);
+    int *pending = (int *) malloc(sizeof(int) * dag->count);
+    assert(order && pending);
+
+    // Kahn's algorithm, using order[] as the queue.
+    int head = 0, tail = 0;
+    for (int i = 0; i < dag->count; i++) {
+        pending[i] = dag->steps[i].depc;
+        if (!pending[i]) order[tail++] = i;
+    }
+    while (head < tail) {
+        step_t *step = &dag->steps[order[head++]];
+        for (int d = 0; d < step->dependentc; d++) {
+            if (!--pending[step->dependents[d]]) {
+                order[tail++] = step->dependents[d];
+            }
+        }
+    }
+
+    int rc = 0;
+    if (tail < dag->count) {
+        output_stderr("Dependencies of steps form a cycle, among:");
+        for (int i = 0; i < dag->count; i++) {
+            if (pending[i]) output_stderr(" %s", dag->steps[i].name);
+        }
+        output_stderr("\n");
+        rc = -1;
+    }
+    else {
+        // Dependents precede in reverse order, so their chains are known.
+        for (int i = dag->count - 1; i >= 0; i--) {
+            step_t *step = &dag->steps[order[i]];
+            step->critical = 1;
+            for (int d = 0; d < step->dependentc; d++) {
+                int chain = dag->steps[step->dependents[d]].critical + 1;
+                if (chain > step->critical) step->critical = chain;
+            }
+        }
+
+        dag->ready = (int *) malloc(sizeof(int) * dag->count);
+        assert(dag->ready);
+        for (int i = 0; i < dag->count; i++) {
+            if (!dag->steps[i].depc) ready_push(dag, i);
+        }
+    }
+
+    free(order);
+    free(pending);
+
+    return rc;
+}
+
+/**
+ * Runs all steps, until every one of them has either finished or got
+ * cancelled.
+ */
+void run_steps(dag_t *dag, int jobs)
+{
+    int running = 0;
+
+    while (running > 0 || dag->readyc > 0) {
+        while (running < jobs && dag->readyc > 0 &&
+               !jobserver_acquire(running)) {
+            start_step(dag, ready_pop(dag));
+            running++;
+        }
+
+        int status;
+        pid_t pid = worker_wait(&status, running < jobs && dag->readyc > 0);
+        if (pid < 0) break;
+        if (pid == 0) continue;  // A job slot may have been freed.
+
+        for (int i = 0; i < dag->count; i++) {
+            if (dag->steps[i].state == STEP_RUNNING &&
+                dag->steps[i].pid == pid) {
+                running--;
+                jobserver_release(running);
+                finish_step(dag, i, status);
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * Starts a step in a worker.
+ */
+void start_step(dag_t *dag, int id)
+{
+    step_t *step = &dag->steps[id];
+
+    step->state = STEP_RUNNING;
+    step->start_ns = stats_now_ns();
+    step->pid = worker_fork(&step->stats_fd);
+
+    if (step->pid == 0) {  // Worker code.
+        command_t **commands;
+        int commandc;
+        if (parse_line(step->command, &commands, &commandc)) exit(2);
+        exit(exec_commands(commands, commandc) ? 1 : 0);
+    }
+}
+
+/**
+ * Accounts for a step whose worker has exited, either making ready the
+ * steps depending on it, or cancelling them.
+ */
+void finish_step(dag_t *dag, int id, int status)
+{
+    step_t *step = &dag->steps[id];
+
+    step->status = status;
+    step->end_ns = stats_now_ns();
+    worker_reap(step->stats_fd);
+
+    if (status) {
+        step->state = STEP_FAILED;
+        int cancelled = cancel_dependents(dag, id);
+        output_stderr("Step '%s' failed", step->name);
+        if (cancelled) output_stderr(", cancelling %d dependent steps", cancelled);
+        output_stderr(".\n");
+        return;
+    }
+
+    step->state = STEP_SUCCEEDED;
+    for (int d = 0; d < step->dependentc; d++) {
+        step_t *dependent = &dag->steps[step->dependents[d]];
+        if (!--dependent->pending && dependent->state == STEP_WAITING) {
+            ready_push(dag, step->dependents[d]);
+        }
+    }
+}
+
+/**
+ * Cancels all steps depending, directly or not, on the given one.
+ *
+ * Returns:
+ *  Number of steps cancelled.
+ */
+int cancel_dependents(dag_t *dag, int id)
+{
+    int cancelled = 0;
+    step_t *step = &dag->steps[id];
+
+    for (int d = 0; d < step->dependentc; d++) {
+        step_t *dependent = &dag->steps[step->dependents[d]];
+        // Only waiting steps can depend on an unfinished step.
+        if (dependent->state != STEP_WAITING) continue;
+        dependent->state = STEP_CANCELLED;
+        cancelled += 1 + cancel_dependents(dag, step->dependents[d]);
+    }
+
+    return cancelled;
+}
+
+/**
+ * Adds a step to the heap of ready steps.
+ */
+void ready_push(dag_t *dag, int id)
+{
+    dag->steps[id].state = STEP_READY;
+
+    int i = dag->readyc++;
+    while (i > 0 && ready_before(dag, id, dag->ready[(i-1) / 2])) {
+        dag->ready[i] = dag->ready[(i-1) / 2];
+        i = (i-1) / 2;
+    }
+    dag->ready[i] = id;
+}
+
+/**
+ * Removes from the heap of ready steps the one to be run first.
+ */
+int ready_pop(dag_t *dag)
+{
+    int top = dag->ready[0];
+    int last = dag->ready[--dag->readyc];
+
+    int i = 0;
+    while (2*i + 1 < dag->readyc) {
+        int child = 2*i + 1;
+        if (child + 1 < dag->readyc &&
+            ready_before(dag, dag->ready[child+1], dag->ready[child])) {
+            child++;
+        }
+        if (!ready_before(dag, dag->ready[child], last)) break;
+        dag->ready[i] = dag->ready[child];
+        i = child;
+    }
+    if (dag->readyc) dag->ready[i] = last;
+
+    return top;
+}
+
+/**
+ * Checks whether step a should run before step b: longest critical path
+ * first and then the one defined first in script.
+ */
+int ready_before(dag_t *dag, int a, int b)
+{
+    if (dag->steps[a].critical != dag->steps[b].critical)
+        return dag->steps[a].critical > dag->steps[b].critical;
+    return a < b;
+}
+
+/**
+ * Compares two steps of sort_dag by name, for qsort().
+ */
+int compare_names(const void *a, const void *b)
+{
+    return strcmp(sort_dag->steps[*(const int *) a].name,
+                  sort_dag->steps[*(const int *) b].name);
+}
+
+/**
+ * Prints status and runtime of every step.
+ */
+void print_steps_summary(dag_t *dag)
+{
+    char status[32];
+
+    output_stdout("\n%-10s %12s  %s\n", "STATUS", "TIME", "STEP");
+    for (int i = 0; i < dag->count; i++) {
+        step_t *step = &dag->steps[i];
+        double seconds = 0;
+
+        if (step->state == STEP_CANCELLED) {
+            snprintf(status, sizeof(status), "cancelled");
+        }
+        else if (step->state != STEP_SUCCEEDED && step->state != STEP_FAILED) {
+            snprintf(status, sizeof(status), "not run");
+        }
+        else {
+            if (WIFEXITED(step->status))
+                snprintf(status, sizeof(status), "%d", WEXITSTATUS(step->status));
+            else
+                snprintf(status, sizeof(status), "signal %d",
+                         WTERMSIG(step->status));
+            seconds = (step->end_ns - step->start_ns) / 1e9;
+        }
+
+        output_stdout("%-10s %10.3f s  %s\n", status, seconds, step->name);
+    }
+}
+
+/**
+ * Releases all resources held by graph.
+ */
+void destroy_steps(dag_t *dag)
+{
+    for (int i = 0; i < dag->count; i++) {
+        step_t *step = &dag->steps[i];
+        for (int d = 0; d < step->depc; d++) free(step->dep_names[d]);
+        free(step->dep_names);
+        free(step->dependents);
+        free(step->name);
+        free(step->command);
+    }
+    free(dag->steps);
+    free(dag->ready);
+}
@@ -0,0 +1,54 @@
+/**
+ * dag.h
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This header provides execution of scripts whose lines are steps of a
+ * dependency graph, instead of a sequence.
+ *
+ * Each non-blank, non-comment line of such a script defines a step as:
+ *     step <name>: <dependency> <dependency> ... -> <commands>
+ * where <commands> is any line accepted by the shell and is executed only
+ * after all steps it depends on have succeeded. Steps can be defined in any
+ * order.
+ *
+ * The graph is checked for cycles and unknown dependencies before anything
+ * runs. Steps whose dependencies are met run concurrently, each one in a
+ * worker process (see runner.h), up to a given number at once. Among ready
+ * steps, the one heading the longest chain of dependent steps runs first,
+ * so the critical path of the graph is never delayed by other steps. When a
+ * step fails, all steps depending on it, directly or not, are cancelled,
+ * while independent steps keep running.
+ *
+ * Functions defined in dag.h:
+ *  -int run_dag(const char *path, int jobs)
+ *
+ * Version: 0.1
+ */
+
+#ifndef __dag_h__
+#define __dag_h__
+
+
+/**
+ * Runs a script of steps.
+ *
+ * When all steps finish, a summary with the status and runtime of each one
+ * is printed.
+ *
+ * Parameters:
+ *  -path : Path to the script.
+ *  -jobs : Maximum number of steps running at once.
+ *
+ * Returns:
+ *  Number of steps that failed or got cancelled, or -1 if script cannot be
+ *  read or its graph is invalid.
+ */
+int run_dag(const char *path, int jobs);
+
+#endif
@@ -0,0 +1,258 @@
+/**
+ * dircache.c
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This file provides an implementation for routines declared in dircache.h
+ * header.
+ *
+ * Version: 0.1
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "dircache.h"
+
+
+#define GETDENTS_BUFFER (256 * 1024)  // Bytes of entries read per syscall.
+// Modification times closer than that to the time of reading a directory
+// may hide a later change, due to coarse granularity of fs timestamps.
+#define RACY_WINDOW_NS 50000000LL
+
+
+// Layout of records returned by getdents64 syscall.
+struct linux_dirent64 {
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+
+dir_listing_t *read_listing(const char *path, struct stat *st);
+void listing_destroy(dir_listing_t *listing);
+int compare_entries(const void *a, const void *b);
+long long timespec_diff_ns(struct timespec *a, struct timespec *b);
+
+
+dir_listing_t *dircache[DIRCACHE_MAX_DIRS];  // Cached listings.
+unsigned long long dircache_clock = 0;       // Logical time of lookups.
+
+
+dir_listing_t *dircache_get(const char *path)
+{
+    const char *dir = path[0] ? path : ".";
+    struct stat st;
+
+    if (stat(dir, &st) || !S_ISDIR(st.st_mode)) return NULL;
+
+    int slot = -1;     // Slot of path in cache.
+    int victim = -1;   // Free slot if any, else least recently used one.
+    for (int i = 0; i < DIRCACHE_MAX_DIRS; i++) {
+        if (!dircache[i]) {
+            if (victim < 0 || dircache[victim]) victim = i;
+            continue;
+        }
+        if (!strcmp(dircache[i]->path, path)) {
+            slot = i;
+            break;
+        }
+        if (victim < 0 || (dircache[victim] &&
+                           dircache[i]->last_use < dircache[victim]->last_use)) {
+            victim = i;
+        }
+    }
+
+    dir_listing_t *listing = slot >= 0 ? dircache[slot] : NULL;
+
+    // A listing is valid as long as it refers to the same directory, which
+    // has not been modified since it was read.
+    if (listing && (listing->racy ||
+                    listing->dev != st.st_dev || listing->ino != st.st_ino ||
+                    listing->mtime.tv_sec != st.st_mtim.tv_sec ||
+                    listing->mtime.tv_nsec != st.st_mtim.tv_nsec)) {
+        listing_destroy(listing);
+        dircache[slot] = NULL;
+        listing = NULL;
+        victim = slot;
+    }
+
+    if (!listing) {
+        listing = read_listing(path, &st);
+        if (!listing) return NULL;
+
+        if (slot < 0) slot = victim;
+        if (dircache[slot]) listing_destroy(dircache[slot]);
+        dircache[slot] = listing;
+    }
+
+    listing->last_use = ++dircache_clock;
+
+    return listing;
+}
+
+dir_entry_t *dircache_find(dir_listing_t *listing, const char *name)
+{
+    dir_entry_t key;
+    key.name = (char *) name;
+
+    return (dir_entry_t *) bsearch(&key, listing->entries, listing->count,
+                                   sizeof(dir_entry_t), compare_entries);
+}
+
+int dircache_entry_is_dir(dir_listing_t *listing, dir_entry_t *entry)
+{
+    if (entry->type == DT_DIR) return 1;
+    if (entry->type != DT_LNK && entry->type != DT_UNKNOWN) return 0;
+
+    // Type is not enough, so resolve the entry relative to its directory.
+    size_t size = strlen(listing->path) + strlen(entry->name) + 2;
+    char *full_path = (char *) malloc(size);
+    assert(full_path);
+    snprintf(full_path, size, "%s%s%s", listing->path,
+             listing->path[0] ? "/" : "", entry->name);
+
+    struct stat st;
+    int is_dir = !stat(full_path, &st) && S_ISDIR(st.st_mode);
+
+    free(full_path);
+
+    return is_dir;
+}
+
+/**
+ * Reads all entries of a directory.
+ *
+ * Parameters:
+ *  -path : Path to the directory.
+ *  -st : Result of stat() on directory, taken before reading it.
+ *
+ * Returns:
+ *  A new listing of the directory, or NULL on failure.
+ */
+dir_listing_t *read_listing(const char *path, struct stat *st)
+{
+    struct timespec read_time;
+    clock_gettime(CLOCK_REALTIME, &read_time);
+
+    int fd = open(path[0] ? path : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    char *buffer = (char *) malloc(GETDENTS_BUFFER);
+    assert(buffer);
+
+    size_t names_size = 0, names_capacity = 4096;
+    size_t count = 0, capacity = 64;
+    char *names = (char *) malloc(names_capacity);
+    size_t *offsets = (size_t *) malloc(capacity * sizeof(size_t));
+    unsigned char *types = (unsigned char *) malloc(capacity);
+    assert(names && offsets && types);
+
+    long nread;
+    while ((nread = syscall(SYS_getdents64, fd, buffer, GETDENTS_BUFFER)) > 0) {
+        for (long bpos = 0; bpos < nread;) {
+            struct linux_dirent64 *d = (struct linux_dirent64 *) (buffer + bpos);
+            bpos += d->d_reclen;
+
+            if (!strcmp(d->d_name, ".") || !strcmp(d->d_name, "..")) continue;
+
+            size_t length = strlen(d->d_name) + 1;
+            if (names_size + length > names_capacity) {
+                while (names_size + length > names_capacity) names_capacity *= 2;
+                names = (char *) realloc(names, names_capacity);
+                assert(names);
+            }
+            if (count == capacity) {
+                capacity *= 2;
+                offsets = (size_t *) realloc(offsets, capacity * sizeof(size_t));
+                types = (unsigned char *) realloc(types, capacity);
+                assert(offsets && types);
+            }
+
+            memcpy(names + names_size, d->d_name, length);
+            offsets[count] = names_size;
+            types[count] = d->d_type;
+            names_size += length;
+            count++;
+        }
+    }
+
+    free(buffer);
+    close(fd);
+
+    if (nread < 0) {
+        free(names);
+        free(offsets);
+        free(types);
+        return NULL;
+    }
+
+    dir_listing_t *listing = (dir_listing_t *) malloc(sizeof(dir_listing_t));
+    assert(listing);
+    listing->path = strdup(path);
+    listing->dev = st->st_dev;
+    listing->ino = st->st_ino;
+    listing->mtime = st->st_mtim;
+    listing->racy = timespec_diff_ns(&read_time, &st->st_mtim) < RACY_WINDOW_NS;
+    listing->names = names;
+    listing->count = count;
+
+    // Names storage is final now, so entries can point into it.
+    listing->entries = (dir_entry_t *) malloc(
+        (count ? count : 1) * sizeof(dir_entry_t));
+    assert(listing->entries);
+    for (size_t i = 0; i < count; i++) {
+        listing->entries[i].name = names + offsets[i];
+        listing->entries[i].type = types[i];
+    }
+    qsort(listing->entries, count, sizeof(dir_entry_t), compare_entries);
+
+    free(offsets);
+    free(types);
+
+    return listing;
+}
+
+/**
+ * Releases all memory held by a listing.
+ */
+void listing_destroy(dir_listing_t *listing)
+{
+    free(listing->path);
+    free(listing->entries);
+    free(listing->names);
+    free(listing);
+}
+
+/**
+ * Compares two directory entries by name, for qsort() and bsearch().
+ */
+int compare_entries(const void *a, const void *b)
+{
+    return strcmp(((const dir_entry_t *) a)->name,
+                  ((const dir_entry_t *) b)->name);
+}
+
+/**
+ * Returns a - b in nanoseconds.
+ */
+long long timespec_diff_ns(struct timespec *a, struct timespec *b)
+{
+    return (long long) (a->tv_sec - b->tv_sec) * 1000000000LL +
+           (a->tv_nsec - b->tv_nsec);
+}
@@ -0,0 +1,107 @@
+/**
+ * dircache.h
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This header provides a cache of directory listings.
+ *
+ * Directories are read with getdents64() in large batches and their
+ * entries are kept sorted by name. A cached listing is validated on each
+ * lookup by a single stat() of the directory, comparing its device, inode
+ * and modification time, so repeated lookups of an unchanged directory
+ * never read it again.
+ *
+ * Types defined in dircache.h:
+ *  -dir_entry_t
+ *  -dir_listing_t
+ *
+ * Constants defined in dircache.h:
+ *  -DIRCACHE_MAX_DIRS
+ *
+ * Functions defined in dircache.h:
+ *  -dir_listing_t *dircache_get(const char *path)
+ *  -dir_entry_t *dircache_find(dir_listing_t *listing, const char *name)
+ *  -int dircache_entry_is_dir(dir_listing_t *listing, dir_entry_t *entry)
+ *
+ * Version: 0.1
+ */
+
+#ifndef __dircache_h__
+#define __dircache_h__
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <time.h>
+
+
+// Maximum number of directories kept in cache. Least recently used
+// listings are dropped when exceeded.
+#define DIRCACHE_MAX_DIRS 64
+
+
+typedef struct {
+    char *name;          // Name of the entry.
+    unsigned char type;  // Type of the entry, as reported by getdents64().
+} dir_entry_t;
+
+typedef struct {
+    char *path;              // Path the listing was requested with.
+    dev_t dev;               // Device of the directory when read.
+    ino_t ino;               // Inode of the directory when read.
+    struct timespec mtime;   // Modification time of directory when read.
+    int racy;                // Whether directory may have been modified
+                             // within the same timestamp tick it was read.
+    dir_entry_t *entries;    // Entries sorted by name, without "." and "..".
+    size_t count;            // Number of entries.
+    char *names;             // Storage of all entries' names.
+    unsigned long long last_use;  // Logical time of last lookup.
+} dir_listing_t;
+
+
+/**
+ * Returns the listing of a directory, reading it only if it is not cached
+ * or it has changed since it was cached.
+ *
+ * WARNING: Returned listing is owned by the cache and may be released by
+ * any subsequent call to dircache_get().
+ *
+ * Parameters:
+ *  -path : Path to the directory. An empty string means current directory.
+ *
+ * Returns:
+ *  The listing of the directory, or NULL if it cannot be read.
+ */
+dir_listing_t *dircache_get(const char *path);
+
+/**
+ * Looks up an entry of a listing by name, using binary search.
+ *
+ * Parameters:
+ *  -listing : Listing to be searched.
+ *  -name : Name of the entry.
+ *
+ * Returns:
+ *  The entry if found, else NULL.
+ */
+dir_entry_t *dircache_find(dir_listing_t *listing, const char *name);
+
+/**
+ * Checks whether an entry of a listing is a directory, following symbolic
+ * links. stat() is only called when type reported by getdents64() is not
+ * enough to tell.
+ *
+ * Parameters:
+ *  -listing : Listing that contains the entry.
+ *  -entry : Entry to be checked.
+ *
+ * Returns:
+ *  1 if entry is a directory, else 0.
+ */
+int dircache_entry_is_dir(dir_listing_t *listing, dir_entry_t *entry);
+
+#endif
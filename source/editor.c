@@ -0,0 +1,564 @@
+/**
+ * editor.c
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This file provides an implementation for routines declared in editor.h
+ * header.
+ *
+ * Version: 0.1
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <errno.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include "completion.h"
+#include "history.h"
+#include "output.h"
+#include "editor.h"
+
+
+// Codes of control keys.
+#define KEY_CTRL(k) ((k) & 0x1f)
+#define KEY_TAB 9
+#define KEY_ENTER 13
+#define KEY_ESC 27
+#define KEY_BACKSPACE 127
+#define KEY_SEQ(c) ((c) + 1000)    // Key of escape sequence ending in c.
+#define KEY_UP KEY_SEQ('A')
+#define KEY_DOWN KEY_SEQ('B')
+#define KEY_RIGHT KEY_SEQ('C')
+#define KEY_LEFT KEY_SEQ('D')
+#define KEY_HOME KEY_SEQ('H')
+#define KEY_END KEY_SEQ('F')
+#define KEY_DELETE KEY_SEQ('~')
+
+#define SEARCH_QUERY_SIZE 256  // Maximum length of reverse search query.
+
+
+// State of the line being edited.
+typedef struct {
+    const char *prompt;  // Prompt displayed before line.
+    char *buf;           // Text of line.
+    size_t length;       // Length of text.
+    size_t capacity;     // Allocated size of buf.
+    size_t pos;          // Position of cursor in text.
+    int last_key;        // Previous key pressed.
+    int hist_index;      // Record of history being displayed.
+    int hist_end;        // Records in history when editing started.
+    char *saved;         // Line typed before browsing history, or NULL.
+} edit_state_t;
+
+
+int enable_raw_mode(struct termios *saved);
+int read_key(int *key);
+void refresh_line(edit_state_t *state);
+void insert_text(edit_state_t *state, const char *text, size_t length);
+void delete_range(edit_state_t *state, size_t from, size_t to);
+void set_text(edit_state_t *state, const char *text, size_t length);
+void browse_history(edit_state_t *state, int step);
+int reverse_search(edit_state_t *state);
+void refresh_search(const char *query, int match, int failed);
+void complete_word(edit_state_t *state);
+void list_candidates(edit_state_t *state, char **matches, int count);
+void write_all(const char *data, size_t length);
+
+
+ssize_t editor_read_line(const char *prompt, char **line, size_t *capacity)
+{
+    struct termios saved;
+    edit_state_t state;
+
+    output_flush();  // Anything printed so far should precede the prompt.
+
+    if (enable_raw_mode(&saved)) {
+        // Not a terminal after all, so fallback to plain reading.
+        write_all(prompt, strlen(prompt));
+        write_all(" ", 1);
+        return getline(line, capacity, stdin);
+    }
+
+    state.prompt = prompt;
+    state.capacity = 256;
+    state.buf = (char *) malloc(state.capacity);
+    assert(state.buf);
+    state.buf[0] = '\0';
+    state.length = 0;
+    state.pos = 0;
+    state.last_key = 0;
+    state.hist_end = state.hist_index = history_count();
+    state.saved = NULL;
+
+    refresh_line(&state);
+
+    int key;
+    int pending = 0;  // Key to be processed before reading a new one.
+    int done = 0;
+    int eof = 0;
+    while (!done) {
+        if (pending) {
+            key = pending;
+            pending = 0;
+        }
+        else if (read_key(&key)) {
+            break;
+        }
+
+        switch (key) {
+            case KEY_ENTER:
+            case '\n':
+                done = 1;
+                break;
+            case KEY_CTRL('d'):
+                if (state.length == 0) {
+                    eof = done = 1;
+                    break;
+                }
+                // Otherwise, like delete.
+                /* fall through */
+            case KEY_DELETE:
+                if (state.pos < state.length)
+                    delete_range(&state, state.pos, state.pos + 1);
+                break;
+            case KEY_BACKSPACE:
+            case KEY_CTRL('h'):
+                if (state.pos > 0) {
+                    delete_range(&state, state.pos - 1, state.pos);
+                }
+                break;
+            case KEY_CTRL('c'):
+                write_all("^C\n", 3);
+                state.length = state.pos = 0;
+                state.buf[0] = '\0';
+                break;
+            case KEY_CTRL('a'):
+            case KEY_HOME:
+                state.pos = 0;
+                break;
+            case KEY_CTRL('e'):
+            case KEY_END:
+                state.pos = state.length;
+                break;
+            case KEY_CTRL('b'):
+            case KEY_LEFT:
+                if (state.pos > 0) state.pos--;
+                break;
+            case KEY_CTRL('f'):
+            case KEY_RIGHT:
+                if (state.pos < state.length) state.pos++;
+                break;
+            case KEY_CTRL('u'):
+                delete_range(&state, 0, state.pos);
+                break;
+            case KEY_CTRL('k'):
+                delete_range(&state, state.pos, state.length);
+                break;
+            case KEY_CTRL('l'):
+                write_all("\x1b[H\x1b[2J", 7);
+                break;
+            case KEY_TAB:
+                complete_word(&state);
+                break;
+            case KEY_UP:
+            case KEY_CTRL('p'):
+                browse_history(&state, -1);
+                break;
+            case KEY_DOWN:
+            case KEY_CTRL('n'):
+                browse_history(&state, 1);
+                break;
+            case KEY_CTRL('r'):
+                pending = reverse_search(&state);
+                break;
+            default:
+                if (key >= 32 && key < 256) {
+                    char c = (char) key;
+                    insert_text(&state, &c, 1);
+                }
+                break;
+        }
+        state.last_key = key;
+        if (!done) refresh_line(&state);
+    }
+
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &saved);
+    write_all("\n", 1);
+
+    free(state.saved);
+
+    if (eof || !done) {
+        free(state.buf);
+        return -1;
+    }
+
+    // Hand line to caller in getline() fashion, with its newline.
+    if (!*line || *capacity < state.length + 2) {
+        *capacity = state.length + 2;
+        *line = (char *) realloc(*line, *capacity);
+        assert(*line);
+    }
+    memcpy(*line, state.buf, state.length);
+    (*line)[state.length] = '\n';
+    (*line)[state.length+1] = '\0';
+    free(state.buf);
+
+    return state.length + 1;
+}
+
+/**
+ * Switches terminal of stdin into raw mode.
+ *
+ * Parameters:
+ *  -saved : Where the previous mode is stored, so it can be restored.
+ *
+ * Returns:
+ *  0 on success, else a non-zero value.
+ */
+int enable_raw_mode(struct termios *saved)
+{
+    if (!isatty(STDIN_FILENO) || tcgetattr(STDIN_FILENO, saved)) return -1;
+
+    struct termios raw = *saved;
+    raw.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+    raw.c_cflag |= CS8;
+    raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+
+    return tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw);
+}
+
+/**
+ * Reads a key. Escape sequences of arrows, Home, End and Delete are
+ * translated into KEY_* codes.
+ *
+ * Parameters:
+ *  -key : Where the key is stored.
+ *
+ * Returns:
+ *  0 on success, else a non-zero value when input ended.
+ */
+int read_key(int *key)
+{
+    unsigned char c;
+    ssize_t n;
+
+    while ((n = read(STDIN_FILENO, &c, 1)) < 0 && errno == EINTR);
+    if (n <= 0) return -1;
+
+    *key = c;
+    if (c != KEY_ESC) return 0;
+
+    unsigned char seq[3];
+    if (read(STDIN_FILENO, &seq[0], 1) != 1) return 0;
+    if (read(STDIN_FILENO, &seq[1], 1) != 1) return 0;
+
+    if (seq[0] == '[' && seq[1] >= '0' && seq[1] <= '9') {
+        // Extended sequences, like ESC [ 3 ~.
+        if (read(STDIN_FILENO, &seq[2], 1) != 1) return 0;
+        if (seq[2] == '~') {
+            if (seq[1] == '1' || seq[1] == '7') *key = KEY_HOME;
+            else if (seq[1] == '4' || seq[1] == '8') *key = KEY_END;
+            else if (seq[1] == '3') *key = KEY_DELETE;
+        }
+    }
+    else if (seq[0] == '[' || seq[0] == 'O') {
+        *key = KEY_SEQ(seq[1]);
+    }
+
+    return 0;
+}
+
+/**
+ * Redraws prompt and line, placing cursor at its position.
+ */
+void refresh_line(edit_state_t *state)
+{
+    size_t prompt_length = strlen(state->prompt);
+    size_t size = prompt_length + state->length + 64;
+    char *out = (char *) malloc(size);
+    assert(out);
+
+    int n = snprintf(out, size, "\r%s %.*s\x1b[0K", state->prompt,
+                     (int) state->length, state->buf);
+    n += snprintf(out + n, size - n, "\r\x1b[%zuC",
+                  prompt_length + 1 + state->pos);
+
+    write_all(out, n);
+    free(out);
+}
+
+/**
+ * Inserts text at cursor position and moves cursor after it.
+ */
+void insert_text(edit_state_t *state, const char *text, size_t length)
+{
+    if (state->length + length + 1 > state->capacity) {
+        while (state->length + length + 1 > state->capacity)
+            state->capacity *= 2;
+        state->buf = (char *) realloc(state->buf, state->capacity);
+        assert(state->buf);
+    }
+
+    memmove(state->buf + state->pos + length, state->buf + state->pos,
+            state->length - state->pos + 1);
+    memcpy(state->buf + state->pos, text, length);
+    state->length += length;
+    state->pos += length;
+}
+
+/**
+ * Deletes characters in [from, to) and places cursor at from.
+ */
+void delete_range(edit_state_t *state, size_t from, size_t to)
+{
+    memmove(state->buf + from, state->buf + to, state->length - to + 1);
+    state->length -= to - from;
+    state->pos = from;
+}
+
+/**
+ * Replaces the whole text of line and moves cursor to its end.
+ */
+void set_text(edit_state_t *state, const char *text, size_t length)
+{
+    delete_range(state, 0, state->length);
+    insert_text(state, text, length);
+}
+
+/**
+ * Replaces line by an older (step -1) or newer (step 1) record of history.
+ * Moving past the newest record brings back the line typed before browsing.
+ */
+void browse_history(edit_state_t *state, int step)
+{
+    int index = state->hist_index + step;
+    if (index < 0 || index > state->hist_end) return;
+
+    if (state->hist_index == state->hist_end) {
+        free(state->saved);
+        state->saved = strndup(state->buf, state->length);
+        assert(state->saved);
+    }
+
+    state->hist_index = index;
+    if (index == state->hist_end) {
+        set_text(state, state->saved, strlen(state->saved));
+    }
+    else {
+        size_t length;
+        const char *record = history_get(index, &length);
+        set_text(state, record, length);
+    }
+}
+
+/**
+ * Runs an incremental reverse search of history, started by Ctrl-R.
+ *
+ * Typed chars extend the query, Backspace shortens it, Ctrl-R moves to the
+ * next older match and Ctrl-G cancels the search. Any other key accepts
+ * the current match into line.
+ *
+ * Returns:
+ *  The key that accepted the match, which should be processed as usual, or
+ *  0 if no key is left to be processed.
+ */
+int reverse_search(edit_state_t *state)
+{
+    char query[SEARCH_QUERY_SIZE];
+    size_t length = 0;
+    int match = -1;
+    int failed = 0;
+    int key = 0;
+
+    query[0] = '\0';
+    refresh_search(query, match, failed);
+
+    while (1) {
+        int found;
+
+        if (read_key(&key)) {
+            key = 0;  // Input ended, which is found again by caller.
+            break;
+        }
+
+        if (key == KEY_CTRL('r')) {
+            found = history_search(query, match >= 0 ? match : state->hist_end);
+        }
+        else if (key == KEY_BACKSPACE || key == KEY_CTRL('h')) {
+            if (length > 0) query[--length] = '\0';
+            // A shorter query is searched again from the newest record.
+            found = length ? history_search(query, state->hist_end) : -1;
+            match = -1;
+        }
+        else if (key >= 32 && key < 256 && length + 1 < sizeof(query)) {
+            query[length++] = (char) key;
+            query[length] = '\0';
+            // Current match is kept as long as it contains the query.
+            found = history_search(query, match >= 0 ? match + 1
+                                                     : state->hist_end);
+        }
+        else if (key == KEY_CTRL('g')) {
+            refresh_line(state);
+            return 0;
+        }
+        else {
+            break;
+        }
+
+        failed = found < 0;
+        if (!failed) match = found;
+        else write_all("\a", 1);
+
+        refresh_search(query, match, failed);
+    }
+
+    if (match >= 0) {
+        size_t record_length;
+        const char *record = history_get(match, &record_length);
+        set_text(state, record, record_length);
+        state->hist_index = match;
+    }
+
+    return key;
+}
+
+/**
+ * Displays the query and the match of reverse search in place of line.
+ */
+void refresh_search(const char *query, int match, int failed)
+{
+    const char *record = "";
+    size_t length = 0;
+    if (match >= 0) record = history_get(match, &length);
+
+    size_t size = strlen(query) + length + 64;
+    char *out = (char *) malloc(size);
+    assert(out);
+
+    int n = snprintf(out, size, "\r(%sreverse-i-search)`%s': %.*s\x1b[0K",
+                     failed ? "failed " : "", query, (int) length, record);
+    write_all(out, n);
+    free(out);
+}
+
+/**
+ * Completes the word that ends at cursor. Words at the beginning of a
+ * command are completed as command names, unless they contain a '/'. All
+ * other words are completed as paths.
+ */
+void complete_word(edit_state_t *state)
+{
+    size_t start = state->pos;
+    while (start > 0 && !strchr(" ;&|(", state->buf[start-1])) start--;
+
+    // A word is a command name if nothing but separators, or an opening
+    // brace, precede it.
+    size_t before = start;
+    while (before > 0 && state->buf[before-1] == ' ') before--;
+    int is_command = before == 0 || strchr(";&|(", state->buf[before-1]) ||
+                     (state->buf[before-1] == '{' &&
+                      (before == 1 || state->buf[before-2] == ' '));
+
+    char *word = strndup(state->buf + start, state->pos - start);
+    assert(word);
+
+    char **matches;
+    int count;
+    if (is_command && !strchr(word, '/')) {
+        count = completion_find_commands(word, &matches);
+    }
+    else {
+        count = completion_find_paths(word, &matches);
+    }
+
+    size_t word_length = strlen(word);
+
+    if (count == 0) {
+        write_all("\a", 1);
+    }
+    else {
+        // Longest common prefix of all candidates.
+        size_t common = strlen(matches[0]);
+        for (int i = 1; i < count; i++) {
+            size_t j = 0;
+            while (j < common && matches[i][j] == matches[0][j]) j++;
+            common = j;
+        }
+
+        if (common > word_length) {
+            insert_text(state, matches[0] + word_length, common - word_length);
+        }
+        if (count == 1) {
+            // Complete names are followed by a space, directories are not.
+            if (matches[0][common-1] != '/') insert_text(state, " ", 1);
+        }
+        else if (common == word_length) {
+            if (state->last_key == KEY_TAB) list_candidates(state, matches, count);
+            else write_all("\a", 1);
+        }
+    }
+
+    completion_free_matches(matches, count);
+    free(word);
+}
+
+/**
+ * Prints candidates of completion in columns, below current line.
+ */
+void list_candidates(edit_state_t *state, char **matches, int count)
+{
+    (void) state;
+
+    struct winsize ws;
+    int width = 80;
+    if (!ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) && ws.ws_col > 0) width = ws.ws_col;
+
+    size_t longest = 0;
+    for (int i = 0; i < count; i++) {
+        size_t length = strlen(matches[i]);
+        if (length > longest) longest = length;
+    }
+    int columns = width / (longest + 2);
+    if (columns < 1) columns = 1;
+
+    write_all("\n", 1);
+    for (int i = 0; i < count; i++) {
+        write_all(matches[i], strlen(matches[i]));
+        if ((i + 1) % columns == 0 || i == count - 1) {
+            write_all("\n", 1);
+        }
+        else {
+            for (size_t s = strlen(matches[i]); s < longest + 2; s++)
+                write_all(" ", 1);
+        }
+    }
+}
+
+/**
+ * Writes all given data to stdout, bypassing stdio buffers.
+ */
+void write_all(const char *data, size_t length)
+{
+    while (length > 0) {
+        ssize_t n = write(STDOUT_FILENO, data, length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += n;
+        length -= n;
+    }
+}
@@ -0,0 +1,56 @@
+/**
+ * editor.h
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This header provides a line editor for terminals, used for reading the
+ * commands typed by user in interactive mode.
+ *
+ * Terminal is switched to raw mode only while a line is edited. Supported
+ * keys are:
+ *  -Left/Right, Ctrl-B/Ctrl-F : Move cursor by a character.
+ *  -Home/End, Ctrl-A/Ctrl-E : Move cursor to start/end of line.
+ *  -Backspace, Delete : Delete character before/under cursor.
+ *  -Ctrl-U/Ctrl-K : Delete everything before/after cursor.
+ *  -Up/Down, Ctrl-P/Ctrl-N : Move to older/newer line of history.
+ *  -Ctrl-R : Incremental reverse search of history (see history.h).
+ *  -Ctrl-L : Clear screen.
+ *  -Ctrl-C : Discard current line.
+ *  -Ctrl-D : End of input, when line is empty.
+ *  -Tab : Complete command name or path under cursor (see completion.h).
+ *          Pressing it twice lists all candidates.
+ *
+ * Functions defined in editor.h:
+ *  -ssize_t editor_read_line(const char *prompt, char **line, size_t *capacity)
+ *
+ * Version: 0.1
+ */
+
+#ifndef __editor_h__
+#define __editor_h__
+
+#include <sys/types.h>
+
+
+/**
+ * Displays a prompt and lets user edit a line on terminal attached to
+ * stdin and stdout.
+ *
+ * Parameters:
+ *  -prompt : Prompt to be displayed before the line.
+ *  -line : A reference to a buffer allocated with malloc(), or to NULL,
+ *          where the line will be stored, NULL terminated and including a
+ *          final newline. Reallocated if needed, like getline() does.
+ *  -capacity : A reference to the allocated size of *line.
+ *
+ * Returns:
+ *  Length of the line, or -1 on end of input.
+ */
+ssize_t editor_read_line(const char *prompt, char **line, size_t *capacity);
+
+#endif
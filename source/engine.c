@@ -14,6 +14,8 @@
  * Version: 0.1
  */
 
+#define _GNU_SOURCE
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -21,8 +23,27 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <fcntl.h>
 #include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
 #include "string_utils.h"
+#include "stats.h"
+#include "output.h"
+#include "memstats.h"
+#include "bench.h"
+#include "batch.h"
+#include "watch.h"
+#include "coproc.h"
+#include "copy.h"
+#include "pathcache.h"
+#include "perfstat.h"
+#include "globbing.h"
+#include "runner.h"
 #include "engine.h"
 
 
@@ -30,11 +51,27 @@
 int quit(command_t *command);
 int change_dir(command_t *command);
 int do_nothing(command_t *command);
+int print_stats(command_t *command);
+int run_with_timeout(command_t *command);
+int print_memstats(command_t *command);
+int exec_builtin(command_t *command);
 
 // ------ Declaration of arbitrary util functions ------
 char **convert_2d_array_to_null_term(char **array, int n);
 char **create_null_term_array_reference(char **array, int n);
 char **array_push_at_beggining(char **array, char *new_obj);
+int wait_child(pid_t pid, const exec_timeout_t *timeout, int *status,
+               struct rusage *usage);
+int child_exited(pid_t pid, int pidfd, short revents);
+void arm_timer(int timer, long long ns);
+int parse_duration(const char *str, long long *ns);
+int parse_signal(const char *str);
+int replace_shell(command_t *command);
+void report_exec_failure(const char *name, int exec_errno);
+int exec_list(command_t **commands, int commandc, int tail, int *last_rc);
+int exec_group(command_t *group, int tail);
+int needs_isolation(command_t *group);
+command_t *expand_patterns(command_t *command);
 
 
 // Human readable names of built-in commands.
@@ -42,6 +79,21 @@ char *engine_builtins[] = {
         "quit",
         "exit",
         "cd",
+        "stats",
+        "timeout",
+        "memstats",
+        "bench",
+        "exec",
+        "batch",
+        "watch",
+        "coproc",
+        "coproc-send",
+        "coproc-recv",
+        "coproc-close",
+        "cat",
+        "cp",
+        "tee",
+        "perfstat",
         "",
         NULL
 };
@@ -51,57 +103,51 @@ int (*engine_builtins_map[]) (command_t *) = {
         quit,
         quit,
         change_dir,
+        print_stats,
+        run_with_timeout,
+        print_memstats,
+        run_bench,
+        exec_builtin,
+        run_batch,
+        run_watch,
+        start_coproc,
+        send_to_coproc,
+        receive_from_coproc,
+        close_coproc,
+        run_cat,
+        run_cp,
+        run_tee,
+        run_perfstat,
         do_nothing,
         NULL
 };
 
+// Names of signals accepted by 'timeout' built-in.
+struct {
+    const char *name;
+    int signal;
+} signal_names[] = {
+    {"HUP", SIGHUP}, {"INT", SIGINT}, {"QUIT", SIGQUIT}, {"KILL", SIGKILL},
+    {"USR1", SIGUSR1}, {"USR2", SIGUSR2}, {"ALRM", SIGALRM},
+    {"TERM", SIGTERM}, {"CONT", SIGCONT}, {"STOP", SIGSTOP}, {NULL, 0}
+};
 
-int exec_commands(command_t **commands, int commandc)
-{
-    int previous_rc = 0;  // First command is always executed.
-    int failures = 0;     // Count the total number of commands failed.
-
-    for (int i = 0; i < commandc; i++) {
-
-        command_t *comm = commands[i];
-
-        // Execute commands that require previous command to have succeed, only
-        // if such is the case. Otherwise, continue to next one.
-        int policy = command_get_exec_policy(comm);
-        if (policy == COMMAND_ON_PREVIOUS_SUCCEED && previous_rc) {
-            printf("Did not execute '%s', since previous command failed.\n",
-                   command_get_name(comm));
-            previous_rc = -1;  // Update return code to a failure one.
-            continue;  // Go to next one.
-        }
-
-        // Check if current command is a built-in and if it is execute the
-        // corresponding built-in.
-        int builtin_id;
-        if ((builtin_id = find_built_in(comm)) > -1) {
-            previous_rc = engine_builtins_map[builtin_id](comm);
-        }
-
-        // Check if a command refers to a local binary (starts with "./").
-        else if (is_local_bin(comm)) {
-            // Trim "./" at beggining.
-            char *trimmed = str_trim(command_get_name(comm), '.');
-            char *trimmed2 = str_trim(trimmed, '/');
-            command_set_name(comm, trimmed2);
-            free(trimmed);
-            free(trimmed2);
-
-            previous_rc = exec_binary(comm);
-        }
+exec_timeout_t engine_default_timeout = { 0, SIGTERM, 0 };
+int engine_last_status = 0;
+struct rusage engine_last_usage;
+unsigned long long engine_cwd_changes = 0;
 
-        else {
-            previous_rc = exec_binary(comm);
-        }
 
-        if (previous_rc) failures++;  // Count the commands failed.
-    }
+int exec_commands(command_t **commands, int commandc)
+{
+    int rc;
+    return exec_list(commands, commandc, 0, &rc);
+}
 
-    return failures;
+int exec_commands_tail(command_t **commands, int commandc)
+{
+    int rc;
+    return exec_list(commands, commandc, 1, &rc);
 }
 
 int exec_binary(command_t *command)
@@ -114,27 +160,87 @@ int exec_binary(command_t *command)
     args = array_push_at_beggining(args, name);
     assert(args);
 
-    pid_t pid;   // Process ID of the child to execute binary.
-    int status;  // Status code returned from child process.
+    int status = exec_argv(args, &engine_default_timeout);
+
+    // Cleanup resourcess.
+    free(args);
+
+    return status;
+}
+
+int exec_argv(char **argv, const exec_timeout_t *timeout)
+{
+    char *name = argv[0];
+    pid_t pid;          // Process ID of the child to execute binary.
+    int status;         // Status code returned from child process.
+    int exec_pipe[2];   // Pipe where child reports a failed exec().
+    int exec_errno = 0;
+    struct rusage usage;
+    perfstat_t counters;
+
+    // Write end is closed on a successful exec(), so parent can tell apart
+    // a failed exec from a binary that just returned non-zero.
+    if (pipe2(exec_pipe, O_CLOEXEC)) {
+        output_perror("Internal error: Cthulhu came up and your lovely CRUSH, crashed...!");
+        exit(-1);
+    }
+
+    unsigned long long start_ns = stats_now_ns();
+    shell_stats.spawns++;
+
+    // Resolved by the shell, so the next run of the same name skips PATH.
+    const char *path = pathcache_lookup(name);
+
+    // Counters are inherited by the child, so they are opened right before
+    // forking it.
+    int counting = perfstat_enabled && !perfstat_open(&counters);
+
+    output_flush();  // Otherwise, buffered output is written by child too.
 
     if ((pid = fork()) == -1) {
-        perror("Internal error: Cthulhu came up and your lovely CRUSH, crashed...!");
+        output_perror("Internal error: Cthulhu came up and your lovely CRUSH, crashed...!");
         exit(-1);
     }
     else if (pid == 0) {  // Child code.
-        execvp(name, args);
+        close(exec_pipe[0]);
+        if (path) execv(path, argv);
+        execvp(name, argv);  // Binary may have moved since it was cached.
 
         // If child reached here, then execvp() failed.
-        printf("No command '%s' found.\n", name);
-        exit(errno);  // Return errno to parent process.
+        exec_errno = errno;
+        write(exec_pipe[1], &exec_errno, sizeof(exec_errno));
+        report_exec_failure(name, exec_errno);
+        output_flush();
+        _exit(exec_errno);  // Return errno to parent process, skipping the
+                            // exit handlers of the shell.
     }
     else {  // Parent code.
-        waitpid(pid, &status, 0);
+        close(exec_pipe[1]);
+
+        // Blocks until child either exec()ed or failed to.
+        ssize_t n;
+        while ((n = read(exec_pipe[0], &exec_errno, sizeof(exec_errno))) < 0 &&
+               errno == EINTR);
+        if (n == sizeof(exec_errno)) shell_stats.spawn_failures++;
+        shell_stats.spawn_ns += stats_now_ns() - start_ns;
+        close(exec_pipe[0]);
+
+        int expired = wait_child(pid, timeout, &status, &usage);
+        engine_last_usage = usage;
+        shell_stats.child_user_us +=
+            usage.ru_utime.tv_sec * 1000000ULL + usage.ru_utime.tv_usec;
+        shell_stats.child_sys_us +=
+            usage.ru_stime.tv_sec * 1000000ULL + usage.ru_stime.tv_usec;
+
+        // Counts of a binary that never ran are meaningless.
+        if (counting)
+            perfstat_close(&counters, n == sizeof(exec_errno) ? NULL : name);
+
+        // Report timeouts the way coreutils timeout does.
+        if (expired == 1) status = W_EXITCODE(EXEC_TIMEOUT_STATUS, 0);
+        else if (expired == 2) status = W_EXITCODE(128 + SIGKILL, 0);
     }
 
-    // Cleanup resourcess.
-    free(args);
-
     return status;
 }
 
@@ -159,7 +265,21 @@ int find_built_in(command_t *command) {
 
 int quit(command_t *command)
 {
-    exit(0);
+    // Like sh, shell exits with the status of the last command, unless
+    // another one is given.
+    if (command_get_args_num(command) == 0)
+        exit(exit_code(engine_last_status));
+
+    char *arg = command_get_args(command)[0];
+    char *end;
+    long status = strtol(arg, &end, 10);
+    if (end == arg || *end || status < 0) {
+        output_stderr("%s: Illegal number: %s\n", command_get_name(command),
+                      arg);
+        exit(2);
+    }
+
+    exit(status & 0xff);
     return 0;
 }
 
@@ -168,13 +288,350 @@ int change_dir(command_t *command)
     int rc = chdir(command_get_args(command)[0]);
 
     if (rc)
-        printf("No such directory exists.\n");
+        output_stderr("No such directory exists.\n");
+    else
+        engine_cwd_changes++;
 
     return rc;
 }
 
 int do_nothing(command_t *command) { return 0; }
 
+int print_stats(command_t *command)
+{
+    (void) command;
+
+    stats_print();
+    return 0;
+}
+
+int print_memstats(command_t *command)
+{
+    (void) command;
+
+    memstats_print();
+    return 0;
+}
+
+int exec_builtin(command_t *command)
+{
+    int argc = command_get_args_num(command);
+    if (argc == 0) return 0;  // Nothing to replace shell with.
+
+    char **argv = create_null_term_array_reference(command_get_args(command),
+                                                   argc);
+    int status = exec_in_place(argv);  // Returns only on failure.
+    free(argv);
+
+    return status;
+}
+
+int run_with_timeout(command_t *command)
+{
+    char **args = command_get_args(command);
+    int argc = command_get_args_num(command);
+    exec_timeout_t limit = { 0, SIGTERM, 0 };
+    char *duration = NULL;
+    int set_default = 0;
+    int i;
+
+    // Options may come before or after duration, up to the command name.
+    for (i = 0; i < argc; i++) {
+        if (!strcmp(args[i], "--default")) {
+            set_default = 1;
+        }
+        else if ((!strcmp(args[i], "--signal") || !strcmp(args[i], "-s")) &&
+                 i + 1 < argc) {
+            if ((limit.signal = parse_signal(args[++i])) < 0) {
+                output_stderr("timeout: Invalid signal '%s'.\n", args[i]);
+                return -1;
+            }
+        }
+        else if ((!strcmp(args[i], "--kill-after") || !strcmp(args[i], "-k")) &&
+                 i + 1 < argc) {
+            if (parse_duration(args[++i], &limit.kill_after_ns)) {
+                output_stderr("timeout: Invalid duration '%s'.\n", args[i]);
+                return -1;
+            }
+        }
+        else if (!duration) {
+            duration = args[i];
+        }
+        else {
+            break;  // Command name reached.
+        }
+    }
+
+    if (!duration || (set_default && i < argc) || (!set_default && i == argc)) {
+        output_stderr("Usage: timeout [--signal SIG] [--kill-after DURATION] "
+                      "DURATION command [args...]\n"
+                      "       timeout --default [--signal SIG] "
+                      "[--kill-after DURATION] DURATION\n");
+        return -1;
+    }
+    if (parse_duration(duration, &limit.duration_ns)) {
+        output_stderr("timeout: Invalid duration '%s'.\n", duration);
+        return -1;
+    }
+
+    // Default applies to all binaries spawned from now on.
+    if (set_default) {
+        engine_default_timeout = limit;
+        return 0;
+    }
+
+    char **argv = create_null_term_array_reference(args + i, argc - i);
+    int status = exec_argv(argv, &limit);
+    free(argv);
+
+    return status;
+}
+
+int exit_code(int status)
+{
+    if (status == 0) return 0;
+    if (status < 0) return 1;  // Failed built-ins.
+    if (WIFEXITED(status)) return WEXITSTATUS(status) ? WEXITSTATUS(status) : 1;
+    if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+    return 1;
+}
+
+/**
+ * Executes a list of commands, either a whole line or the body of a group.
+ *
+ * Parameters:
+ *  -commands : An array of references to commands, to be executed.
+ *  -commandc : Size of commands array.
+ *  -tail : Non-zero if the list is the last work of the shell, so its last
+ *          command may replace the shell.
+ *  -last_rc : A reference where the return code of the last executed
+ *          command is stored, or -1 if the last one was skipped after a
+ *          failure.
+ *
+ * Returns:
+ *  The number of command chains that failed.
+ */
+int exec_list(command_t **commands, int commandc, int tail, int *last_rc)
+{
+    int previous_rc = 0;  // First command is always executed.
+    int failures = 0;     // Count the total number of chains failed.
+
+    for (int i = 0; i < commandc; i++) {
+
+        command_t *comm = commands[i];
+        int last = tail && i == commandc - 1;
+
+        // Execute commands that require previous command to have succeed, only
+        // if such is the case, and commands that require it to have failed,
+        // only if it did. Otherwise, continue to next one.
+        int policy = command_get_exec_policy(comm);
+        if (policy == COMMAND_ON_PREVIOUS_SUCCEED && previous_rc) {
+            output_stderr("Did not execute '%s', since previous command failed.\n",
+                   command_get_name(comm));
+            previous_rc = -1;  // Update return code to a failure one.
+        }
+        else if (policy == COMMAND_ON_PREVIOUS_FAIL && !previous_rc) {
+            // Chain keeps succeeding.
+        }
+
+        else if (command_get_type(comm) != COMMAND_SIMPLE) {
+            previous_rc = exec_group(comm, last);
+            engine_last_status = previous_rc;
+        }
+
+        else {
+            unsigned long long start_ns = stats_now_ns();
+            shell_stats.commands_executed++;
+
+            // Patterns match the files existing when command runs, e.g.
+            // after a 'cd' earlier in the same line.
+            command_t *expanded = NULL;
+            if (command_has_patterns(comm))
+                comm = expanded = expand_patterns(comm);
+
+            // Check if current command is a built-in and if it is execute the
+            // corresponding built-in.
+            int builtin_id = command_get_builtin(comm);
+            if (builtin_id == COMMAND_BUILTIN_UNKNOWN)
+                builtin_id = find_built_in(comm);
+            if (builtin_id > -1) {
+                shell_stats.builtins_executed++;
+                previous_rc = engine_builtins_map[builtin_id](comm);
+            }
+
+            // Check if a command refers to a local binary (starts with "./").
+            else if (is_local_bin(comm)) {
+                // Trim "./" at beggining. Commands may be shared by the
+                // parse cache, so a copy gets the trimmed name.
+                char *trimmed = str_trim(command_get_name(comm), '.');
+                char *trimmed2 = str_trim(trimmed, '/');
+                command_t local = *comm;
+                local.name = trimmed2;
+
+                if (last) previous_rc = replace_shell(&local);
+                else previous_rc = exec_binary(&local);
+
+                free(trimmed);
+                free(trimmed2);
+            }
+
+            // The last command of the shell needs no child of its own.
+            else if (last) {
+                previous_rc = replace_shell(comm);
+            }
+
+            else {
+                previous_rc = exec_binary(comm);
+            }
+
+            if (expanded) command_destroy(expanded);
+
+            stats_record_command(stats_now_ns() - start_ns);
+            engine_last_status = previous_rc;
+        }
+
+        // A chain ends where a command that is always executed follows.
+        if ((i == commandc - 1 ||
+             command_get_exec_policy(commands[i+1]) == COMMAND_ALWAYS) &&
+            previous_rc) {
+            failures++;
+        }
+    }
+
+    *last_rc = previous_rc;
+    return failures;
+}
+
+/**
+ * Executes the commands of a group. Groups in braces, and groups in
+ * parentheses that cannot change the state of the shell, run in the shell
+ * itself. Any other group runs in a forked subshell.
+ *
+ * Parameters:
+ *  -group : A group command.
+ *  -tail : Non-zero if the group is the last work of the shell.
+ *
+ * Returns:
+ *  The return code of the last executed command of the group, or its
+ *  status as returned by wait() if it run in a subshell.
+ */
+int exec_group(command_t *group, int tail)
+{
+    command_t **commands = command_get_group(group);
+    int commandc = command_get_group_size(group);
+    int rc;
+
+    // Nothing can observe the state of a shell that won't continue.
+    if (command_get_type(group) == COMMAND_GROUP_BRACES || tail ||
+        !needs_isolation(group)) {
+        exec_list(commands, commandc, tail, &rc);
+        return rc;
+    }
+
+    int stats_fd;
+    pid_t pid = worker_fork(&stats_fd);
+    if (pid == 0) {
+        exec_list(commands, commandc, 0, &rc);
+        exit(exit_code(rc));
+    }
+
+    int status = -1;
+    pid_t exited;
+    while ((exited = worker_wait(&status, 0)) != pid && exited != -1);
+    worker_reap(stats_fd);
+
+    return status;
+}
+
+/**
+ * Checks whether executing the commands of a group may change the state of
+ * the shell, as observed by the commands following it.
+ *
+ * Parameters:
+ *  -group : A group command.
+ *
+ * Returns:
+ *  1 if group has to run in a subshell, else 0.
+ */
+int needs_isolation(command_t *group)
+{
+    command_t **commands = command_get_group(group);
+    int commandc = command_get_group_size(group);
+
+    for (int i = 0; i < commandc; i++) {
+        command_t *comm = commands[i];
+
+        // Nested subshells take care of themselves.
+        int type = command_get_type(comm);
+        if (type == COMMAND_GROUP_SUBSHELL) continue;
+        if (type == COMMAND_GROUP_BRACES) {
+            if (needs_isolation(comm)) return 1;
+            continue;
+        }
+
+        // Coprocess built-ins are left out, since coprocesses are meant to
+        // be shared by the whole script, so they always run in the shell.
+        char *name = command_get_name(comm);
+        if (!strcmp(name, "cd") || !strcmp(name, "quit") ||
+            !strcmp(name, "exit") || !strcmp(name, "exec")) {
+            return 1;
+        }
+
+        // Only setting the default timeout changes it.
+        if (!strcmp(name, "timeout")) {
+            char **args = command_get_args(comm);
+            for (int j = 0; j < command_get_args_num(comm); j++)
+                if (!strcmp(args[j], "--default")) return 1;
+        }
+
+        // Only turning counting on or off changes it.
+        if (!strcmp(name, "perfstat") && command_get_args_num(comm) == 1) {
+            char *arg = command_get_args(comm)[0];
+            if (!strcmp(arg, "on") || !strcmp(arg, "off")) return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Creates a copy of a command, where each pattern among its arguments is
+ * replaced by the sorted list of paths it matches. A pattern that matches
+ * nothing is passed as is.
+ *
+ * Returns:
+ *  The expanded copy, which should be destroyed by the caller.
+ */
+command_t *expand_patterns(command_t *command)
+{
+    command_t *expanded = command_create();
+    assert(expanded);
+    command_set_name(expanded, command_get_name(command));
+    command_set_exec_policy(expanded, command_get_exec_policy(command));
+    command_set_builtin(expanded, command_get_builtin(command));
+    expanded->origin = command;
+
+    char **args = command_get_args(command);
+    for (int i = 0; i < command_get_args_num(command); i++) {
+        char **matches;
+        int matchc = 0;
+        if (command_is_pattern(command, i))
+            matchc = glob_expand(args[i], &matches);
+
+        if (!matchc) {
+            command_add_arg(expanded, args[i]);
+            continue;
+        }
+        for (int j = 0; j < matchc; j++) {
+            command_add_arg(expanded, matches[j]);
+            free(matches[j]);
+        }
+        free(matches);
+    }
+
+    return expanded;
+}
+
 char **create_null_term_array_reference(char **array, int n)
 {
     // Allocate space for given array, plus one more for NULL pointer.
@@ -204,3 +661,222 @@ char **array_push_at_beggining(char **array, char *new_obj)
 
     return array;
 }
+
+/**
+ * Executes a binary by replacing the shell with it, unless a default
+ * timeout has to be enforced, binaries are counted by perfstat or
+ * coprocesses are running, in which case it is spawned as usual.
+ *
+ * Returns:
+ *  Only if binary cannot be executed, a non-zero status, like the one
+ *  exec_binary() returns for a failed exec.
+ */
+int replace_shell(command_t *command)
+{
+    // Coprocesses still running take a shell to be waited for.
+    if (exec_needs_waiting() || coproc_count())
+        return exec_binary(command);
+
+    char **args = create_null_term_array_reference(
+        command_get_args(command), command_get_args_num(command));
+    args = array_push_at_beggining(args, command_get_name(command));
+    assert(args);
+
+    int status = exec_in_place(args);
+    free(args);
+
+    return status;
+}
+
+int exec_needs_waiting()
+{
+    // Enforcing a timeout or reading counters takes a process waiting for
+    // the binary.
+    return engine_default_timeout.duration_ns || perfstat_enabled;
+}
+
+int exec_in_place(char **argv)
+{
+    const char *path = pathcache_lookup(argv[0]);
+    output_flush();
+    if (path) execv(path, argv);
+    execvp(argv[0], argv);
+
+    int exec_errno = errno;
+    shell_stats.spawn_failures++;
+    report_exec_failure(argv[0], exec_errno);
+
+    return W_EXITCODE(exec_errno & 0xff, 0);
+}
+
+/**
+ * Prints why a binary could not be executed.
+ */
+void report_exec_failure(const char *name, int exec_errno)
+{
+    if (exec_errno == E2BIG) {
+        output_stderr("Argument list of '%s' is too long. Use 'batch' to "
+                      "split it.\n", name);
+    }
+    else output_stderr("No command '%s' found.\n", name);
+}
+
+/**
+ * Waits for a child to terminate, enforcing a timeout on it.
+ *
+ * A pidfd of the child and a timerfd are polled together, so the shell
+ * sleeps until either the child terminates or time expires. On kernels
+ * without pidfd support, the child is checked every few milliseconds.
+ *
+ * Parameters:
+ *  -pid : Process ID of the child.
+ *  -timeout : Limit on run time of child, or NULL for no limit.
+ *  -status : Where the status of the terminated child is stored.
+ *  -usage : Where the resources used by child are stored.
+ *
+ * Returns:
+ *  0 if child terminated in time, 1 if it was signaled on timeout, or 2 if
+ *  it had to be killed too.
+ */
+int wait_child(pid_t pid, const exec_timeout_t *timeout, int *status,
+               struct rusage *usage)
+{
+    int expired = 0;
+    int timer = -1;
+
+    if (timeout && timeout->duration_ns > 0) {
+        timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    }
+
+    if (timer >= 0) {
+        int pidfd = syscall(SYS_pidfd_open, pid, 0);
+        struct pollfd fds[2] = {
+            { pidfd, POLLIN, 0 },  // Negative fds are ignored by poll().
+            { timer, POLLIN, 0 }
+        };
+
+        arm_timer(timer, timeout->duration_ns);
+
+        while (1) {
+            int rc = poll(fds, 2, pidfd >= 0 ? -1 : 5);
+            if (rc < 0 && errno != EINTR) break;
+            if (child_exited(pid, pidfd, fds[0].revents)) break;
+            if (rc <= 0 || !(fds[1].revents & POLLIN)) continue;
+
+            uint64_t expirations;
+            read(timer, &expirations, sizeof(expirations));
+
+            if (!expired) {
+                kill(pid, timeout->signal);
+                // A stopped child would never handle the signal.
+                if (timeout->signal != SIGKILL) kill(pid, SIGCONT);
+                shell_stats.timeouts++;
+                expired = 1;
+                if (timeout->kill_after_ns > 0) {
+                    arm_timer(timer, timeout->kill_after_ns);
+                }
+            }
+            else {
+                kill(pid, SIGKILL);
+                expired = 2;
+            }
+        }
+
+        if (pidfd >= 0) close(pidfd);
+        close(timer);
+    }
+
+    while (wait4(pid, status, 0, usage) < 0 && errno == EINTR);
+
+    return expired;
+}
+
+/**
+ * Checks whether a child has terminated, without reaping it.
+ *
+ * Parameters:
+ *  -pid : Process ID of the child.
+ *  -pidfd : A pidfd of the child, or -1 if not available.
+ *  -revents : Events returned by poll() for the pidfd.
+ */
+int child_exited(pid_t pid, int pidfd, short revents)
+{
+    if (pidfd >= 0) return revents & POLLIN;
+
+    siginfo_t info;
+    info.si_pid = 0;
+    if (waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT)) return 1;
+    return info.si_pid != 0;
+}
+
+/**
+ * Sets a timerfd to expire once, after the given nanoseconds.
+ */
+void arm_timer(int timer, long long ns)
+{
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = ns / 1000000000LL;
+    spec.it_value.tv_nsec = ns % 1000000000LL;
+    timerfd_settime(timer, 0, &spec, NULL);
+}
+
+/**
+ * Parses a duration, i.e. a floating point number followed by an optional
+ * unit of 's' (seconds, the default), 'm' (minutes), 'h' (hours) or 'd'
+ * (days).
+ *
+ * Parameters:
+ *  -str : The duration.
+ *  -ns : Where the duration in nanoseconds is stored.
+ *
+ * Returns:
+ *  0 on success, else a non-zero value.
+ */
+int parse_duration(const char *str, long long *ns)
+{
+    char *end;
+    double value = strtod(str, &end);
+    if (end == str || value < 0) return -1;
+
+    double unit = 1;
+    if (*end) {
+        if (end[1]) return -1;
+        switch (*end) {
+            case 's': unit = 1; break;
+            case 'm': unit = 60; break;
+            case 'h': unit = 3600; break;
+            case 'd': unit = 86400; break;
+            default: return -1;
+        }
+    }
+
+    value *= unit * 1e9;
+    if (value > 9e18) return -1;
+    *ns = (long long) value;
+    // Tiny non-zero durations should not turn into no limit.
+    if (*ns == 0 && value > 0) *ns = 1;
+
+    return 0;
+}
+
+/**
+ * Parses a signal, given either by number or by name with or without the
+ * "SIG" prefix.
+ *
+ * Returns:
+ *  The number of signal, or -1 if it is invalid.
+ */
+int parse_signal(const char *str)
+{
+    char *end;
+    long number = strtol(str, &end, 10);
+    if (end != str && !*end) return number > 0 && number < NSIG ? number : -1;
+
+    if (!strncasecmp(str, "SIG", 3)) str += 3;
+    for (int i = 0; signal_names[i].name; i++) {
+        if (!strcasecmp(str, signal_names[i].name)) return signal_names[i].signal;
+    }
+
+    return -1;
+}
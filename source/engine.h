@@ -11,14 +11,26 @@
  * This header file provides a simple and straightforward way to execute
  * shell commands described by command_t objects.
  *
+ * Types defined in engine.h:
+ *  -exec_timeout_t
+ *
  * Variables declared in engine.h:
  *  -char *engine_builtins[]
+ *  -exec_timeout_t engine_default_timeout
+ *  -int engine_last_status
+ *  -struct rusage engine_last_usage
+ *  -unsigned long long engine_cwd_changes
  *
  * Routines declared in engine.h:
  *  -int exec_commands(command_t **commands, int commandc)
+ *  -int exec_commands_tail(command_t **commands, int commandc)
  *  -int find_built_in(command_t *command)
  *  -int is_local_bin(command_t *command)
  *  -int exec_binary(command_t *command)
+ *  -int exec_argv(char **argv, const exec_timeout_t *timeout)
+ *  -int exec_needs_waiting()
+ *  -int exec_in_place(char **argv)
+ *  -int exit_code(int status)
  *
  * Version: 0.1
  */
@@ -26,16 +38,55 @@
 #ifndef __engine_h__
 #define __engine_h__
 
-
+#include <sys/resource.h>
 #include "command.h"
 
 
+// Status reported for a command that timed out, like coreutils timeout does.
+#define EXEC_TIMEOUT_STATUS 124
+
+
+// Limit on the run time of a spawned binary.
+typedef struct {
+    long long duration_ns;    // Time allowed to binary. 0 means no limit.
+    int signal;               // Signal sent when time expires.
+    long long kill_after_ns;  // Time after signal, when SIGKILL is sent.
+                              // 0 means never.
+} exec_timeout_t;
+
+
 /**
  * A NULL terminated array of strings, that contains the names of all
  * built-in commands contained in current engine implementation.
  */
 extern char *engine_builtins[];
 
+/**
+ * Timeout applied to all binaries spawned by exec_binary(). Set by
+ * 'timeout --default' built-in. No limit by default.
+ */
+extern exec_timeout_t engine_default_timeout;
+
+/**
+ * Status returned by the last command executed by exec_commands(). For
+ * binaries it is the status returned by wait(), while for built-ins it is
+ * their return value, while for groups it is the status of their last
+ * command. Commands skipped due to '&&' or '||' don't change it.
+ */
+extern int engine_last_status;
+
+/**
+ * Resources used by the last binary executed by exec_argv(), as returned
+ * by wait4().
+ */
+extern struct rusage engine_last_usage;
+
+/**
+ * Number of times 'cd' changed the working directory of the shell, so
+ * that anything keeping the directory knows when to read it again.
+ */
+extern unsigned long long engine_cwd_changes;
+
 
 /**
  * Executes the given commands.
@@ -49,16 +100,46 @@ extern char *engine_builtins[];
  * in PATH environment variable and current working directory of the process
  * that invokes exec_commands().
  *
+ * Patterns among the arguments of a command are expanded right before it
+ * runs (see globbing.h), into a copy of the command that built-ins get in
+ * its place. Given commands are never modified.
+ *
+ * Groups run their commands in the shell itself. A group in parentheses
+ * runs in a forked subshell only when one of its commands could change the
+ * state of the shell (directory, exit, exec, default timeout or perfstat
+ * counting), since for any other group the outcome is the same. Coprocess
+ * built-ins never fork a subshell, so a group always acts on the
+ * coprocesses of the shell.
+ *
  * Parameters:
  *  -commands : An array of references to commands, to be executed.
  *  -commandc : Size of commands array.
  *
  * Returns:
- *  0 if execution of all commands succeeded, else the number of commands
- *  whose execution failed.
+ *  0 if execution of all commands succeeded, else the number of command
+ *  chains whose execution failed. A chain consists of the commands joined
+ *  by '&&' and '||', and fails when its last executed command fails.
  */
 int exec_commands(command_t **commands, int commandc);
 
+/**
+ * Executes the given commands like exec_commands() does, as the last work
+ * of the shell. So if the last one of them invokes a binary, the shell is
+ * replaced by it through exec(), instead of forking a child and waiting for
+ * it, like dash does. Should be called only when nothing else is left to
+ * be done, including at exit, since exit handlers don't run. Built-ins that
+ * execute commands of their own use exec_commands(), so they never replace
+ * the shell.
+ *
+ * Parameters:
+ *  -commands : An array of references to commands, to be executed.
+ *  -commandc : Size of commands array.
+ *
+ * Returns:
+ *  Only if the shell was not replaced, what exec_commands() returns.
+ */
+int exec_commands_tail(command_t **commands, int commandc);
+
 /**
  * Searches the implemented built-in commands for matching with the given
  * command.
@@ -89,7 +170,7 @@ int is_local_bin(command_t *command);
 /**
  * Executes a command that requests a binary in the file system.
  *
- * Built-in commands are ignored.
+ * Built-in commands are ignored. engine_default_timeout applies.
  *
  * Parameters:
  *  -command : Command to be executed.
@@ -100,4 +181,65 @@ int is_local_bin(command_t *command);
  */
 int exec_binary(command_t *command);
 
+/**
+ * Executes a binary in the file system, optionally limiting its run time.
+ *
+ * Binary is waited through a pidfd and a timerfd, so no helper process is
+ * needed for the limit. When time expires, binary is sent the signal of
+ * timeout and, if kill_after_ns is set and binary is still running after
+ * that long, SIGKILL.
+ *
+ * Parameters:
+ *  -argv : NULL terminated arguments of binary, starting with its name,
+ *          which is looked up in PATH.
+ *  -timeout : Limit on run time, or NULL for no limit.
+ *
+ * Returns:
+ *  The status code of the invoked binary, as returned by wait(). If time
+ *  expired, the status of an exit with EXEC_TIMEOUT_STATUS, or with 128+9
+ *  if SIGKILL had to be sent. If binary cannot be executed, a non-zero
+ *  value is guaranteed.
+ */
+int exec_argv(char **argv, const exec_timeout_t *timeout);
+
+/**
+ * Checks whether binaries have to be executed by exec_argv(), since a
+ * default timeout has to be enforced on them or perfstat counts them, which
+ * both take a process waiting for the binary.
+ *
+ * Returns:
+ *  1 if binaries have to be waited for, else 0.
+ */
+int exec_needs_waiting();
+
+/**
+ * Replaces the calling process with a binary, through execvp(), sparing the
+ * fork of exec_argv() when nothing is left for the process to do.
+ *
+ * Exit handlers don't run, since the process never exits, so shell output
+ * is flushed first.
+ *
+ * Parameters:
+ *  -argv : NULL terminated arguments of binary, starting with its name,
+ *          which is looked up in PATH.
+ *
+ * Returns:
+ *  Only if binary cannot be executed, the status of a child that exited with
+ *  the errno of execvp().
+ */
+int exec_in_place(char **argv);
+
+/**
+ * Converts the status of a command into an exit code of the shell, the way
+ * sh does.
+ *
+ * Parameters:
+ *  -status : Status of a command, as kept in engine_last_status.
+ *
+ * Returns:
+ *  The exit status of binaries, 128 + signal number for binaries killed by
+ *  a signal, or 1 for any other failure.
+ */
+int exit_code(int status);
+
 #endif
@@ -0,0 +1,373 @@
+/**
+ * globbing.c
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This file provides an implementation for routines declared in globbing.h
+ * header.
+ *
+ * Version: 0.1
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "dircache.h"
+#include "globbing.h"
+
+
+// Types of operations of a compiled pattern.
+#define GLOB_OP_LITERAL 1  // Matches exactly a sequence of characters.
+#define GLOB_OP_ANY 2      // Matches any single character.
+#define GLOB_OP_SET 3      // Matches a single character out of a set.
+#define GLOB_OP_STAR 4     // Matches any sequence of characters.
+
+
+// A growable list of paths.
+typedef struct {
+    char **paths;
+    int count;
+    int capacity;
+} path_list_t;
+
+
+size_t parse_set(const char *pattern, size_t length, size_t i, glob_op_t *op);
+void path_list_add(path_list_t *list, const char *prefix, const char *name,
+                   const char *suffix);
+void path_list_clear(path_list_t *list);
+
+
+int glob_has_magic(const char *str)
+{
+    return strpbrk(str, "*?[") != NULL;
+}
+
+glob_pattern_t *glob_compile(const char *pattern, size_t length)
+{
+    glob_pattern_t *compiled = (glob_pattern_t *) malloc(sizeof(glob_pattern_t));
+    assert(compiled);
+
+    compiled->text = strndup(pattern, length);
+    compiled->ops = (glob_op_t *) malloc(sizeof(glob_op_t) * (length + 1));
+    assert(compiled->text && compiled->ops);
+    compiled->opc = 0;
+    compiled->match_dot = length > 0 && pattern[0] == '.';
+
+    const char *text = compiled->text;
+    size_t i = 0;
+    size_t set_end;
+    while (i < length) {
+        glob_op_t *op = &compiled->ops[compiled->opc];
+
+        if (text[i] == '*') {
+            // Consecutive stars are equal to a single one.
+            if (!compiled->opc || compiled->ops[compiled->opc-1].type != GLOB_OP_STAR) {
+                op->type = GLOB_OP_STAR;
+                compiled->opc++;
+            }
+            i++;
+        }
+        else if (text[i] == '?') {
+            op->type = GLOB_OP_ANY;
+            compiled->opc++;
+            i++;
+        }
+        else if (text[i] == '[' &&
+                 (set_end = parse_set(text, length, i, op)) > i) {
+            compiled->opc++;
+            i = set_end;
+        }
+        else {
+            // Merge consecutive plain characters into a single literal. An
+            // unterminated '[' is plain too.
+            if (compiled->opc &&
+                compiled->ops[compiled->opc-1].type == GLOB_OP_LITERAL) {
+                compiled->ops[compiled->opc-1].length++;
+            }
+            else {
+                op->type = GLOB_OP_LITERAL;
+                op->literal = text + i;
+                op->length = 1;
+                compiled->opc++;
+            }
+            i++;
+        }
+    }
+
+    compiled->min_length = 0;
+    for (int o = 0; o < compiled->opc; o++) {
+        if (compiled->ops[o].type == GLOB_OP_LITERAL)
+            compiled->min_length += compiled->ops[o].length;
+        else if (compiled->ops[o].type != GLOB_OP_STAR)
+            compiled->min_length++;
+    }
+
+    int opc = compiled->opc;
+    compiled->suffix_op = -1;
+    if (opc >= 2 && compiled->ops[opc-1].type == GLOB_OP_LITERAL &&
+        compiled->ops[opc-2].type == GLOB_OP_STAR) {
+        compiled->suffix_op = opc - 1;
+    }
+
+    return compiled;
+}
+
+void glob_destroy(glob_pattern_t *pattern)
+{
+    free(pattern->text);
+    free(pattern->ops);
+    free(pattern);
+}
+
+int glob_match(glob_pattern_t *pattern, const char *name)
+{
+    if (name[0] == '.' && !pattern->match_dot) return 0;
+
+    size_t length = strlen(name);
+    glob_op_t *ops = pattern->ops;
+    int opc = pattern->opc;
+    glob_op_t *suffix = pattern->suffix_op >= 0 ? &ops[pattern->suffix_op] : NULL;
+
+    if (length < pattern->min_length) return 0;
+    if (suffix && memcmp(name + length - suffix->length,
+                         suffix->literal, suffix->length)) {
+        return 0;
+    }
+
+    int i = 0;             // Next operation to apply.
+    size_t n = 0;          // Next character of name to match.
+    int star = -1;         // Operation of last star met.
+    size_t star_n = 0;     // Position of name where last star resumes.
+
+    while (n < length || i < opc) {
+        if (i < opc) {
+            glob_op_t *op = &ops[i];
+            unsigned char c = name[n];
+
+            switch (op->type) {
+                case GLOB_OP_STAR:
+                    // A final star matches anything left, so does a star
+                    // followed only by the already checked suffix.
+                    if (i == opc - 1) return 1;
+                    if (i + 1 == pattern->suffix_op &&
+                        length - n >= suffix->length) {
+                        return 1;
+                    }
+                    star = i++;
+                    star_n = n;
+                    continue;
+                case GLOB_OP_ANY:
+                    if (n < length) {
+                        i++;
+                        n++;
+                        continue;
+                    }
+                    break;
+                case GLOB_OP_SET:
+                    if (n < length && (op->set[c >> 3] & (1 << (c & 7)))) {
+                        i++;
+                        n++;
+                        continue;
+                    }
+                    break;
+                case GLOB_OP_LITERAL:
+                    if (length - n >= op->length &&
+                        !memcmp(name + n, op->literal, op->length)) {
+                        i++;
+                        n += op->length;
+                        continue;
+                    }
+                    break;
+            }
+        }
+
+        // On mismatch, let the last star absorb one more character.
+        if (star >= 0 && star_n < length) {
+            star_n++;
+            n = star_n;
+            i = star + 1;
+            continue;
+        }
+
+        return 0;
+    }
+
+    return 1;
+}
+
+int glob_expand(const char *pattern, char ***matches)
+{
+    path_list_t current = { NULL, 0, 0 };  // Paths matched so far.
+    path_list_t next = { NULL, 0, 0 };     // Paths matching one more component.
+
+    *matches = NULL;
+
+    // Absolute patterns start from root, relative ones from cwd.
+    path_list_add(&current, pattern[0] == '/' ? "/" : "", "", "");
+
+    const char *component = pattern;
+    while (*component && current.count) {
+        // Skip repeated separators.
+        while (*component == '/') component++;
+        if (!*component) break;
+
+        const char *end = strchr(component, '/');
+        size_t length = end ? (size_t) (end - component) : strlen(component);
+        while (end && *end == '/') end++;
+        int last = !end || !*end;             // Last component of pattern.
+        const char *suffix = last ? (end ? "/" : "") : "/";
+
+        char *literal = strndup(component, length);
+        glob_pattern_t *compiled =
+            glob_has_magic(literal) ? glob_compile(component, length) : NULL;
+
+        for (int c = 0; c < current.count; c++) {
+            char *prefix = current.paths[c];
+
+            // Intermediate literal components don't need to be looked up,
+            // reading their contents on next step will fail if missing.
+            if (!compiled && !last) {
+                path_list_add(&next, prefix, literal, suffix);
+                continue;
+            }
+
+            // Listing is requested without trailing separator.
+            size_t prefix_length = strlen(prefix);
+            if (prefix_length > 1) prefix[prefix_length-1] = '\0';
+            dir_listing_t *listing = dircache_get(prefix);
+            if (prefix_length > 1) prefix[prefix_length-1] = '/';
+            if (!listing) continue;
+
+            if (!compiled) {
+                dir_entry_t *entry = dircache_find(listing, literal);
+                if (entry && (!end || dircache_entry_is_dir(listing, entry)))
+                    path_list_add(&next, prefix, literal, suffix);
+                continue;
+            }
+
+            for (size_t e = 0; e < listing->count; e++) {
+                dir_entry_t *entry = &listing->entries[e];
+                if (!glob_match(compiled, entry->name)) continue;
+                // Anything followed by a separator should be a directory.
+                if (end && !dircache_entry_is_dir(listing, entry)) continue;
+                path_list_add(&next, prefix, entry->name, suffix);
+            }
+        }
+
+        if (compiled) glob_destroy(compiled);
+        free(literal);
+
+        path_list_clear(&current);
+        current = next;
+        next.paths = NULL;
+        next.count = next.capacity = 0;
+
+        component = end ? end : component + length;
+    }
+
+    if (!current.count) {
+        path_list_clear(&current);
+        return 0;
+    }
+
+    *matches = current.paths;
+    return current.count;
+}
+
+/**
+ * Parses a set of characters starting at '[' into an operation.
+ *
+ * Parameters:
+ *  -pattern : The pattern.
+ *  -length : Length of pattern.
+ *  -i : Position of '[' in pattern.
+ *  -op : Operation where parsed set is stored.
+ *
+ * Returns:
+ *  Position after the closing ']'. If no closing ']' exists, op type is
+ *  set to GLOB_OP_LITERAL and i is returned.
+ */
+size_t parse_set(const char *pattern, size_t length, size_t i, glob_op_t *op)
+{
+    size_t start = i;
+    int negate = 0;
+
+    memset(op->set, 0, sizeof(op->set));
+    i++;
+
+    if (i < length && (pattern[i] == '!' || pattern[i] == '^')) {
+        negate = 1;
+        i++;
+    }
+
+    // A ']' right after the opening is a member of the set.
+    int first = 1;
+    while (i < length && (pattern[i] != ']' || first)) {
+        unsigned char low = pattern[i];
+        unsigned char high = low;
+
+        if (i + 2 < length && pattern[i+1] == '-' && pattern[i+2] != ']') {
+            high = pattern[i+2];
+            i += 2;
+        }
+        for (unsigned c = low; c <= high; c++) op->set[c >> 3] |= 1 << (c & 7);
+
+        i++;
+        first = 0;
+    }
+
+    if (i >= length) {
+        op->type = GLOB_OP_LITERAL;
+        return start;
+    }
+
+    if (negate) {
+        for (int b = 0; b < 32; b++) op->set[b] = ~op->set[b];
+    }
+    op->set['/' >> 3] &= ~(1 << ('/' & 7));  // Never match separator.
+    op->type = GLOB_OP_SET;
+
+    return i + 1;
+}
+
+/**
+ * Appends prefix + name + suffix as a new path to a list.
+ */
+void path_list_add(path_list_t *list, const char *prefix, const char *name,
+                   const char *suffix)
+{
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 16;
+        list->paths = (char **) realloc(list->paths,
+                                        sizeof(char *) * list->capacity);
+        assert(list->paths);
+    }
+
+    size_t prefix_length = strlen(prefix);
+    size_t name_length = strlen(name);
+    size_t suffix_length = strlen(suffix);
+    char *path = (char *) malloc(prefix_length + name_length + suffix_length + 1);
+    assert(path);
+    memcpy(path, prefix, prefix_length);
+    memcpy(path + prefix_length, name, name_length);
+    memcpy(path + prefix_length + name_length, suffix, suffix_length + 1);
+
+    list->paths[list->count++] = path;
+}
+
+/**
+ * Releases all paths of a list and the list itself.
+ */
+void path_list_clear(path_list_t *list)
+{
+    for (int i = 0; i < list->count; i++) free(list->paths[i]);
+    free(list->paths);
+    list->paths = NULL;
+    list->count = list->capacity = 0;
+}
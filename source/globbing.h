@@ -0,0 +1,126 @@
+/**
+ * globbing.h
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This header provides expansion of glob patterns into the paths they
+ * match.
+ *
+ * Supported wildcards are:
+ *  '*'   : Matches any string, including the empty one.
+ *  '?'   : Matches any single character.
+ *  [...] : Matches any character of the set. Ranges like a-z are allowed.
+ *          A leading '!' or '^' negates the set.
+ * Wildcards never match a '/' and never match a leading '.' of a name,
+ * unless the pattern starts with '.' itself.
+ *
+ * Each path component of a pattern is compiled once into a sequence of
+ * matching operations, which is then run against the entries of the cached
+ * directory listings (see dircache.h).
+ *
+ * Types defined in globbing.h:
+ *  -glob_pattern_t
+ *
+ * Functions defined in globbing.h:
+ *  -int glob_has_magic(const char *str)
+ *  -glob_pattern_t *glob_compile(const char *pattern, size_t length)
+ *  -void glob_destroy(glob_pattern_t *pattern)
+ *  -int glob_match(glob_pattern_t *pattern, const char *name)
+ *  -int glob_expand(const char *pattern, char ***matches)
+ *
+ * Version: 0.1
+ */
+
+#ifndef __globbing_h__
+#define __globbing_h__
+
+#include <stddef.h>
+
+
+// Single operation of a compiled pattern.
+typedef struct {
+    int type;                  // One of GLOB_OP_* constants in globbing.c.
+    const char *literal;       // Characters to match for literal operations.
+    size_t length;             // Number of characters in literal.
+    unsigned char set[32];     // Bitmap of characters for set operations.
+} glob_op_t;
+
+typedef struct {
+    char *text;       // Copy of the pattern, referenced by literal ops.
+    glob_op_t *ops;   // Sequence of matching operations.
+    int opc;          // Number of operations.
+    int match_dot;    // Whether names starting with '.' may match.
+    size_t min_length;  // Minimum length of a matching name.
+    int suffix_op;    // Final literal following a star, or -1. Checked first,
+                      // so most names are rejected by a single comparison.
+} glob_pattern_t;
+
+
+/**
+ * Checks whether a string contains any wildcard characters.
+ *
+ * Parameters:
+ *  -str : String to be checked.
+ *
+ * Returns:
+ *  1 if str contains '*', '?' or '[', else 0.
+ */
+int glob_has_magic(const char *str);
+
+/**
+ * Compiles a pattern for a single path component.
+ *
+ * Parameters:
+ *  -pattern : The pattern. It should not contain '/'.
+ *  -length : Number of characters of pattern.
+ *
+ * Returns:
+ *  The compiled pattern. It should be destroyed with glob_destroy().
+ */
+glob_pattern_t *glob_compile(const char *pattern, size_t length);
+
+/**
+ * Destroys a compiled pattern.
+ *
+ * Parameters:
+ *  -pattern : Pattern to be destroyed.
+ */
+void glob_destroy(glob_pattern_t *pattern);
+
+/**
+ * Matches a name against a compiled pattern.
+ *
+ * Parameters:
+ *  -pattern : Compiled pattern.
+ *  -name : Name to be matched.
+ *
+ * Returns:
+ *  1 if name matches the pattern, else 0.
+ */
+int glob_match(glob_pattern_t *pattern, const char *name);
+
+/**
+ * Expands a pattern into all existing paths it matches.
+ *
+ * Paths are returned sorted. Directories are read through the directory
+ * cache, so expanding patterns over the same unchanged directories again
+ * costs a single stat() per directory.
+ *
+ * Parameters:
+ *  -pattern : The pattern to be expanded. It may consist of many
+ *          components separated by '/', any of which may contain wildcards.
+ *  -matches : A reference where a newly allocated array with the matched
+ *          paths will be returned. Both the array and its strings should be
+ *          released with free(). Set to NULL when nothing matches.
+ *
+ * Returns:
+ *  Number of paths matched.
+ */
+int glob_expand(const char *pattern, char ***matches);
+
+#endif
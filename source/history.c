@@ -0,0 +1,391 @@
+/**
+ * history.c
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This file provides an implementation for routines declared in history.h
+ * header.
+ *
+ * Version: 0.1
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pwd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "history.h"
+
+
+#define TRIGRAM_TABLE_INITIAL 4096   // Initial buckets of trigram table.
+
+
+// List of records containing a trigram, in ascending order.
+typedef struct {
+    uint32_t trigram;   // Packed trigram, with bit 24 set. 0 when unused.
+    uint32_t *ids;
+    uint32_t count;
+    uint32_t capacity;
+} posting_t;
+
+
+int history_refresh();
+void index_records(size_t from);
+void trigram_table_grow();
+posting_t *trigram_find(uint32_t trigram, int create);
+void posting_add(posting_t *posting, uint32_t id);
+int posting_contains(posting_t *posting, uint32_t id);
+uint32_t pack_trigram(const char *text);
+int linear_search(const char *query, size_t length, int before);
+
+
+int hist_fd = -1;            // Descriptor of log, opened with O_APPEND.
+char *hist_map = NULL;       // Mapped contents of log.
+size_t hist_map_size = 0;    // Size of mapping.
+size_t hist_scanned = 0;     // Offset after the last complete record found.
+size_t *hist_starts = NULL;  // Offset of each record, plus one past the end.
+size_t hist_count = 0;       // Number of records.
+size_t hist_capacity = 0;    // Allocated entries of hist_starts.
+
+posting_t *trigram_table = NULL;  // Open addressing table of trigrams.
+size_t trigram_buckets = 0;
+size_t trigram_used = 0;
+size_t trigram_indexed = 0;       // Records already added to trigram table.
+
+
+int history_open(const char *path)
+{
+    history_close();
+
+    hist_fd = open(path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    if (hist_fd < 0) return -1;
+
+    hist_capacity = 1024;
+    hist_starts = (size_t *) malloc(sizeof(size_t) * hist_capacity);
+    assert(hist_starts);
+    hist_starts[0] = 0;
+
+    history_refresh();
+
+    return 0;
+}
+
+void history_close()
+{
+    if (hist_fd < 0) return;
+
+    if (hist_map) munmap(hist_map, hist_map_size);
+    close(hist_fd);
+    free(hist_starts);
+
+    for (size_t i = 0; i < trigram_buckets; i++) free(trigram_table[i].ids);
+    free(trigram_table);
+
+    hist_fd = -1;
+    hist_map = NULL;
+    hist_map_size = hist_scanned = hist_count = hist_capacity = 0;
+    hist_starts = NULL;
+    trigram_table = NULL;
+    trigram_buckets = trigram_used = trigram_indexed = 0;
+}
+
+void history_add(const char *line, size_t length)
+{
+    if (hist_fd < 0) return;
+
+    if (length > 0 && line[length-1] == '\n') length--;
+    if (length == 0 || memchr(line, '\n', length)) return;
+
+    history_refresh();
+    if (hist_count > 0) {
+        size_t last_length;
+        const char *last = history_get(hist_count - 1, &last_length);
+        if (last_length == length && !memcmp(last, line, length)) return;
+    }
+
+    // A single write() of the whole record, so concurrent appends by other
+    // shells never split it.
+    char *record = (char *) malloc(length + 1);
+    assert(record);
+    memcpy(record, line, length);
+    record[length] = '\n';
+
+    ssize_t rc;
+    while ((rc = write(hist_fd, record, length + 1)) < 0 && errno == EINTR);
+
+    free(record);
+}
+
+int history_count()
+{
+    if (hist_fd < 0) return 0;
+
+    history_refresh();
+    return hist_count;
+}
+
+const char *history_get(int index, size_t *length)
+{
+    // Each record ends one char before the start of the next one.
+    *length = hist_starts[index+1] - hist_starts[index] - 1;
+    return hist_map + hist_starts[index];
+}
+
+int history_search(const char *query, int before)
+{
+    if (hist_fd < 0) return -1;
+
+    history_refresh();
+
+    size_t length = strlen(query);
+    if (before > (int) hist_count) before = hist_count;
+    if (before <= 0) return -1;
+
+    // Queries shorter than a trigram cannot use the index.
+    if (length < 3) return linear_search(query, length, before);
+
+    // Bring trigram index up to date with the log.
+    if (!trigram_table) {
+        trigram_buckets = TRIGRAM_TABLE_INITIAL;
+        trigram_table = (posting_t *) calloc(trigram_buckets,
+                                             sizeof(posting_t));
+        assert(trigram_table);
+    }
+    index_records(trigram_indexed);
+
+    // Start from the least common trigram of query.
+    posting_t *rarest = NULL;
+    for (size_t i = 0; i + 3 <= length; i++) {
+        posting_t *posting = trigram_find(pack_trigram(query + i), 0);
+        if (!posting) return -1;  // No record contains this trigram.
+        if (!rarest || posting->count < rarest->count) rarest = posting;
+    }
+
+    // Find the last candidate before the requested record.
+    size_t low = 0, high = rarest->count;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (rarest->ids[mid] < (uint32_t) before) low = mid + 1;
+        else high = mid;
+    }
+
+    for (size_t c = low; c-- > 0; ) {
+        uint32_t id = rarest->ids[c];
+
+        int candidate = 1;
+        for (size_t i = 0; i + 3 <= length && candidate; i++) {
+            posting_t *posting = trigram_find(pack_trigram(query + i), 0);
+            if (posting != rarest) candidate = posting_contains(posting, id);
+        }
+        if (!candidate) continue;
+
+        // All trigrams exist, though maybe not adjacent, so verify.
+        size_t record_length;
+        const char *record = history_get(id, &record_length);
+        if (memmem(record, record_length, query, length)) return id;
+    }
+
+    return -1;
+}
+
+char *history_default_path(char *buffer, size_t size)
+{
+    const char *path = getenv("CRUSH_HISTFILE");
+    if (path && *path) {
+        if (strlen(path) + 1 > size) return NULL;
+        strcpy(buffer, path);
+        return buffer;
+    }
+
+    const char *home = getenv("HOME");
+    if (!home || !*home) {
+        struct passwd *pw = getpwuid(getuid());
+        if (!pw) return NULL;
+        home = pw->pw_dir;
+    }
+
+    int rc = snprintf(buffer, size, "%s/.crush_history", home);
+    if (rc < 0 || (size_t) rc >= size) return NULL;
+
+    return buffer;
+}
+
+/**
+ * Extends the mapping of log to its current size and records the offsets
+ * of all complete records appended since last refresh.
+ *
+ * Returns:
+ *  0 on success, else -1.
+ */
+int history_refresh()
+{
+    struct stat st;
+    if (fstat(hist_fd, &st)) return -1;
+
+    size_t size = st.st_size;
+    if (size <= hist_map_size) return 0;
+
+    char *map;
+    if (hist_map) map = mremap(hist_map, hist_map_size, size, MREMAP_MAYMOVE);
+    else map = mmap(NULL, size, PROT_READ, MAP_SHARED, hist_fd, 0);
+    if (map == MAP_FAILED) return -1;
+
+    hist_map = map;
+    hist_map_size = size;
+
+    // A record being written by another shell may be seen partially, so
+    // only records up to the last newline are taken.
+    const char *p = hist_map + hist_scanned;
+    const char *end = hist_map + hist_map_size;
+    const char *nl;
+    while ((nl = memchr(p, '\n', end - p)) != NULL) {
+        if (hist_count + 2 > hist_capacity) {
+            hist_capacity *= 2;
+            hist_starts = (size_t *) realloc(hist_starts,
+                                             sizeof(size_t) * hist_capacity);
+            assert(hist_starts);
+        }
+        p = nl + 1;
+        hist_count++;
+        hist_starts[hist_count] = p - hist_map;
+    }
+    hist_scanned = p - hist_map;
+
+    return 0;
+}
+
+/**
+ * Adds the trigrams of all records starting from given one to the trigram
+ * table.
+ */
+void index_records(size_t from)
+{
+    for (size_t id = from; id < hist_count; id++) {
+        size_t length;
+        const char *record = history_get(id, &length);
+
+        for (size_t i = 0; i + 3 <= length; i++) {
+            // Keep load factor of table under 3/4.
+            if ((trigram_used + 1) * 4 > trigram_buckets * 3) {
+                trigram_table_grow();
+            }
+            posting_add(trigram_find(pack_trigram(record + i), 1), id);
+        }
+    }
+    trigram_indexed = hist_count;
+}
+
+/**
+ * Doubles the buckets of trigram table, rehashing all postings.
+ */
+void trigram_table_grow()
+{
+    posting_t *old_table = trigram_table;
+    size_t old_buckets = trigram_buckets;
+
+    trigram_buckets *= 2;
+    trigram_table = (posting_t *) calloc(trigram_buckets, sizeof(posting_t));
+    assert(trigram_table);
+
+    for (size_t i = 0; i < old_buckets; i++) {
+        if (!old_table[i].trigram) continue;
+        posting_t *posting = trigram_find(old_table[i].trigram, 1);
+        *posting = old_table[i];
+    }
+
+    free(old_table);
+}
+
+/**
+ * Finds the posting of a trigram in trigram table.
+ *
+ * Parameters:
+ *  -trigram : Packed trigram.
+ *  -create : If non-zero, an empty posting is created for missing trigrams.
+ *
+ * Returns:
+ *  The posting of trigram, or NULL if it doesn't exist and create is 0.
+ */
+posting_t *trigram_find(uint32_t trigram, int create)
+{
+    size_t mask = trigram_buckets - 1;
+    size_t i = (trigram * 2654435761u) & mask;
+
+    while (trigram_table[i].trigram) {
+        if (trigram_table[i].trigram == trigram) return &trigram_table[i];
+        i = (i + 1) & mask;
+    }
+
+    if (!create) return NULL;
+
+    trigram_table[i].trigram = trigram;
+    trigram_used++;
+    return &trigram_table[i];
+}
+
+/**
+ * Appends a record to a posting, unless it is already the last one.
+ */
+void posting_add(posting_t *posting, uint32_t id)
+{
+    if (posting->count && posting->ids[posting->count-1] == id) return;
+
+    if (posting->count == posting->capacity) {
+        posting->capacity = posting->capacity ? posting->capacity * 2 : 4;
+        posting->ids = (uint32_t *) realloc(posting->ids,
+                                            sizeof(uint32_t) * posting->capacity);
+        assert(posting->ids);
+    }
+    posting->ids[posting->count++] = id;
+}
+
+/**
+ * Checks by binary search whether a posting contains a record.
+ */
+int posting_contains(posting_t *posting, uint32_t id)
+{
+    size_t low = 0, high = posting->count;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (posting->ids[mid] < id) low = mid + 1;
+        else if (posting->ids[mid] > id) high = mid;
+        else return 1;
+    }
+    return 0;
+}
+
+/**
+ * Packs the first three chars of text into a non-zero key.
+ */
+uint32_t pack_trigram(const char *text)
+{
+    const unsigned char *t = (const unsigned char *) text;
+    return (1u << 24) | ((uint32_t) t[0] << 16) | ((uint32_t) t[1] << 8) | t[2];
+}
+
+/**
+ * Searches records one by one, starting from the most recent one before
+ * the given record.
+ */
+int linear_search(const char *query, size_t length, int before)
+{
+    for (int id = before - 1; id >= 0; id--) {
+        size_t record_length;
+        const char *record = history_get(id, &record_length);
+        if (memmem(record, record_length, query, length)) return id;
+    }
+    return -1;
+}
@@ -0,0 +1,117 @@
+/**
+ * history.h
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This header provides the persistent history of lines typed by user.
+ *
+ * History is kept in an append-only log file, one line per record. Each
+ * record is appended by a single write() on a descriptor opened with
+ * O_APPEND, so records of many shells sharing the same file never
+ * interleave and the file is never rewritten. The log is memory mapped for
+ * reading, and records appended by other shells show up as the mapping is
+ * extended.
+ *
+ * Substring searches are served by an index of the trigrams contained in
+ * each record, built on first search and extended incrementally afterwards,
+ * so only records containing all trigrams of the query are ever compared.
+ *
+ * Functions defined in history.h:
+ *  -int history_open(const char *path)
+ *  -void history_close()
+ *  -void history_add(const char *line, size_t length)
+ *  -int history_count()
+ *  -const char *history_get(int index, size_t *length)
+ *  -int history_search(const char *query, int before)
+ *  -char *history_default_path(char *buffer, size_t size)
+ *
+ * Version: 0.1
+ */
+
+#ifndef __history_h__
+#define __history_h__
+
+#include <stddef.h>
+
+
+/**
+ * Opens the history log, creating it if it doesn't exist.
+ *
+ * Parameters:
+ *  -path : Path to the log file.
+ *
+ * Returns:
+ *  0 on success, else -1.
+ */
+int history_open(const char *path);
+
+/**
+ * Closes the history log and releases its index. Does nothing if history is
+ * not open.
+ */
+void history_close();
+
+/**
+ * Appends a line to history. Empty lines and lines identical to the most
+ * recent record are skipped. Does nothing if history is not open.
+ *
+ * Parameters:
+ *  -line : The line. A terminating newline, if any, is dropped.
+ *  -length : Length of the line.
+ */
+void history_add(const char *line, size_t length);
+
+/**
+ * Returns the number of records in history, including ones appended by
+ * other shells up to now.
+ */
+int history_count();
+
+/**
+ * Returns a record of history.
+ *
+ * WARNING: Returned text is not NULL terminated and is valid only until
+ * the next call to any history routine.
+ *
+ * Parameters:
+ *  -index : Index of record, where 0 is the oldest one.
+ *  -length : A reference where the length of record is stored.
+ *
+ * Returns:
+ *  The text of the record.
+ */
+const char *history_get(int index, size_t *length);
+
+/**
+ * Searches for the most recent record that contains a string and is older
+ * than a given record.
+ *
+ * Parameters:
+ *  -query : String to be searched for.
+ *  -before : Only records with index less than that are considered.
+ *
+ * Returns:
+ *  Index of the matching record, or -1 if none matches.
+ */
+int history_search(const char *query, int before);
+
+/**
+ * Stores the default path of history log into given buffer. That is the
+ * value of CRUSH_HISTFILE environment variable if set, else
+ * ~/.crush_history.
+ *
+ * Parameters:
+ *  -buffer : The buffer where path will be stored.
+ *  -size : Size of given buffer.
+ *
+ * Returns:
+ *  The given buffer, or NULL if path cannot be determined.
+ */
+char *history_default_path(char *buffer, size_t size);
+
+#endif
@@ -0,0 +1,215 @@
+/**
+ * jobserver.c
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This file provides an implementation for routines declared in jobserver.h
+ * header.
+ *
+ * Version: 0.1
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include "jobserver.h"
+
+
+#define JOBSERVER_TOKEN '+'  // Token written by a jobserver of the shell.
+
+
+int attach_pipe(int read_fd, int write_fd);
+void attach(int read_fd, int write_fd, int blocking);
+void return_tokens();
+
+
+int jobserver_read_fd = -1;   // Where tokens are read from.
+int jobserver_write_fd = -1;  // Where tokens are written back.
+int jobserver_blocking = 0;   // Whether reading may block.
+char *jobserver_tokens = NULL;  // Tokens held, written back as they were.
+int jobserver_held = 0;       // Number of tokens held.
+int jobserver_capacity = 0;   // Allocated size of jobserver_tokens.
+pid_t jobserver_owner = 0;    // Process holding the tokens.
+int jobserver_hooked = 0;     // Whether returning tokens at exit is registered.
+
+
+int jobserver_connect()
+{
+    const char *flags = getenv("MAKEFLAGS");
+    if (!flags) return -1;
+
+    // Last option wins, like in make. --jobserver-fds is its older name.
+    const char *auth = NULL;
+    for (const char *p = flags; (p = strstr(p, "--jobserver-")) != NULL; p++) {
+        if (!strncmp(p, "--jobserver-auth=", 17)) auth = p + 17;
+        else if (!strncmp(p, "--jobserver-fds=", 16)) auth = p + 16;
+    }
+    if (!auth) return -1;
+
+    char value[4096];
+    size_t length = strcspn(auth, " \t");
+    if (length >= sizeof(value)) return -1;
+    memcpy(value, auth, length);
+    value[length] = '\0';
+
+    // A named fifo is opened anew, so it can be read without blocking.
+    if (!strncmp(value, "fifo:", 5)) {
+        int fd = open(value + 5, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) return -1;
+        attach(fd, fd, 0);
+        return 0;
+    }
+
+    int read_fd, write_fd;
+    char extra;
+    if (sscanf(value, "%d,%d%c", &read_fd, &write_fd, &extra) != 2)
+        return -1;
+
+    // Make passes descriptors only to commands it considers recursive, so
+    // they may be closed, or even reused for something else.
+    if (fcntl(read_fd, F_GETFD) < 0 || fcntl(write_fd, F_GETFD) < 0)
+        return -1;
+
+    return attach_pipe(read_fd, write_fd);
+}
+
+int jobserver_serve(int jobs)
+{
+    // Descriptors are inherited on purpose, as make expects.
+    int fds[2];
+    if (pipe(fds)) return -1;
+
+    // One token for every job besides the first one.
+    if (jobs > 1) {
+        char *tokens = (char *) malloc(jobs - 1);
+        assert(tokens);
+        memset(tokens, JOBSERVER_TOKEN, jobs - 1);
+        ssize_t n = write(fds[1], tokens, jobs - 1);
+        free(tokens);
+        if (n != jobs - 1) {
+            close(fds[0]);
+            close(fds[1]);
+            return -1;
+        }
+    }
+
+    // Advertise the jobserver the way make does to its sub-makes.
+    const char *flags = getenv("MAKEFLAGS");
+    char *new_flags;
+    if (asprintf(&new_flags, "%s%s-j%d --jobserver-auth=%d,%d",
+                 flags ? flags : "", flags && *flags ? " " : "",
+                 jobs, fds[0], fds[1]) < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    setenv("MAKEFLAGS", new_flags, 1);
+    free(new_flags);
+
+    return attach_pipe(fds[0], fds[1]);
+}
+
+int jobserver_acquire(int running)
+{
+    if (running == 0 || jobserver_read_fd < 0) return 0;
+
+    // Only read a descriptor that may block when a token is there, though
+    // another process could still take it first.
+    if (jobserver_blocking) {
+        struct pollfd pfd = { jobserver_read_fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 0) <= 0) return -1;
+    }
+
+    char token;
+    if (read(jobserver_read_fd, &token, 1) != 1) return -1;
+
+    if (jobserver_held == jobserver_capacity) {
+        jobserver_capacity = jobserver_capacity ? jobserver_capacity * 2 : 16;
+        jobserver_tokens = (char *) realloc(jobserver_tokens,
+                                            jobserver_capacity);
+        assert(jobserver_tokens);
+    }
+    jobserver_tokens[jobserver_held++] = token;
+
+    return 0;
+}
+
+void jobserver_release(int running)
+{
+    // One of the running jobs keeps the implicit slot.
+    if (jobserver_held == 0 || jobserver_held < running) return;
+
+    char token = jobserver_tokens[--jobserver_held];
+    while (write(jobserver_write_fd, &token, 1) < 0 && errno == EINTR);
+}
+
+int jobserver_fd()
+{
+    return jobserver_read_fd;
+}
+
+/**
+ * Attaches to a jobserver pipe. Reading end is opened anew through /proc
+ * when possible, so it can be read without blocking, without affecting the
+ * other processes sharing the pipe.
+ *
+ * Returns:
+ *  0 on success.
+ */
+int attach_pipe(int read_fd, int write_fd)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", read_fd);
+
+    int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd >= 0) attach(fd, write_fd, 0);
+    else attach(read_fd, write_fd, 1);
+
+    return 0;
+}
+
+/**
+ * Sets the descriptors of the jobserver in use.
+ */
+void attach(int read_fd, int write_fd, int blocking)
+{
+    jobserver_read_fd = read_fd;
+    jobserver_write_fd = write_fd;
+    jobserver_blocking = blocking;
+    jobserver_owner = getpid();
+
+    if (!jobserver_hooked) {
+        atexit(return_tokens);
+        jobserver_hooked = 1;
+    }
+}
+
+/**
+ * Writes back all tokens still held when shell exits, so they are not lost
+ * for the rest of the process tree.
+ */
+void return_tokens()
+{
+    // Forked workers inherit the tokens of the shell, but don't own them.
+    if (getpid() != jobserver_owner) return;
+
+    while (jobserver_held > 0) {
+        if (write(jobserver_write_fd, &jobserver_tokens[jobserver_held-1], 1)
+                == 1) {
+            jobserver_held--;
+        }
+        else if (errno != EINTR) break;
+    }
+}
@@ -0,0 +1,91 @@
+/**
+ * jobserver.h
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This header provides participation in the jobserver protocol of GNU make,
+ * so that jobs run concurrently by the shell, by make and by other shells
+ * never exceed a single limit across the whole process tree.
+ *
+ * A jobserver is a pipe (or a named fifo) holding one byte, a token, for
+ * each job allowed to run besides the first one. Every process may always
+ * run one job on its own, but has to read a token before starting each
+ * additional one and write it back when that job finishes.
+ *
+ * When the shell runs under make, the jobserver is found in the
+ * --jobserver-auth option of MAKEFLAGS, either as a fifo ("fifo:PATH") or
+ * as a pair of inherited descriptors ("R,W"). When the shell is the top
+ * level process, it can serve tokens itself, advertising its pipe to make
+ * and shells it spawns through MAKEFLAGS.
+ *
+ * Tokens are read without blocking, so the shell can keep waiting for its
+ * own jobs to finish while tokens are not available.
+ *
+ * Functions defined in jobserver.h:
+ *  -int jobserver_connect()
+ *  -int jobserver_serve(int jobs)
+ *  -int jobserver_acquire(int running)
+ *  -void jobserver_release(int running)
+ *  -int jobserver_fd()
+ *
+ * Version: 0.1
+ */
+
+#ifndef __jobserver_h__
+#define __jobserver_h__
+
+
+/**
+ * Connects to the jobserver advertised in MAKEFLAGS, if any.
+ *
+ * Returns:
+ *  0 if connected, or -1 if no usable jobserver exists.
+ */
+int jobserver_connect();
+
+/**
+ * Creates a jobserver with the given number of job slots and advertises it
+ * in MAKEFLAGS, so that all processes spawned afterwards share it. The shell
+ * itself becomes a client of it.
+ *
+ * Parameters:
+ *  -jobs : Maximum number of jobs running at once across all processes.
+ *
+ * Returns:
+ *  0 on success, else -1.
+ */
+int jobserver_serve(int jobs);
+
+/**
+ * Acquires a slot for starting one more job. Never blocks.
+ *
+ * Parameters:
+ *  -running : Number of jobs of the shell already running. The first job
+ *          always runs in the implicit slot of the shell.
+ *
+ * Returns:
+ *  0 if a slot was acquired (always, when no jobserver is connected), or -1
+ *  if none is available right now.
+ */
+int jobserver_acquire(int running);
+
+/**
+ * Releases the slot of a job that finished.
+ *
+ * Parameters:
+ *  -running : Number of jobs of the shell still running.
+ */
+void jobserver_release(int running);
+
+/**
+ * Returns the descriptor that becomes readable when tokens are available,
+ * suitable for poll(), or -1 when no jobserver is connected.
+ */
+int jobserver_fd();
+
+#endif
@@ -0,0 +1,228 @@
+/**
+ * memstats.c
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This file provides an implementation for routines declared in memstats.h
+ * header.
+ *
+ * Allocation routines defined here take precedence over the ones of the C
+ * library, which glibc exports under __libc_ prefixed names too. Counters
+ * are updated atomically, since background threads allocate as well.
+ *
+ * Version: 0.1
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <malloc.h>
+#include "stats.h"
+#include "output.h"
+#include "memstats.h"
+
+
+// Original allocation routines of glibc.
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void *__libc_valloc(size_t size);
+void *__libc_pvalloc(size_t size);
+void __libc_free(void *ptr);
+
+void *count_allocation(void *ptr);
+void count_free(size_t size);
+void update_peak(unsigned long long live);
+unsigned long long resident_bytes();
+
+
+unsigned long long mem_live_bytes = 0;
+unsigned long long mem_peak_bytes = 0;
+unsigned long long mem_allocations = 0;
+unsigned long long mem_frees = 0;
+
+
+void memstats_get(memstats_t *stats)
+{
+    stats->live_bytes = __atomic_load_n(&mem_live_bytes, __ATOMIC_RELAXED);
+    stats->peak_bytes = __atomic_load_n(&mem_peak_bytes, __ATOMIC_RELAXED);
+    stats->allocations = __atomic_load_n(&mem_allocations, __ATOMIC_RELAXED);
+    stats->frees = __atomic_load_n(&mem_frees, __ATOMIC_RELAXED);
+    stats->resident_bytes = resident_bytes();
+}
+
+void memstats_print()
+{
+    memstats_t stats;
+    memstats_get(&stats);
+
+    unsigned long long lines = shell_stats.lines_parsed;
+
+    output_stdout("Live heap bytes:       %llu\n", stats.live_bytes);
+    output_stdout("Peak heap bytes:       %llu\n", stats.peak_bytes);
+    output_stdout("Allocations:           %llu\n", stats.allocations);
+    output_stdout("Frees:                 %llu\n", stats.frees);
+    output_stdout("Live blocks:           %llu\n",
+                  stats.allocations - stats.frees);
+    output_stdout("Resident bytes:        %llu\n", stats.resident_bytes);
+    output_stdout("Allocations per line:  %.1f\n",
+                  lines ? (double) stats.allocations / lines : 0.0);
+}
+
+void *malloc(size_t size)
+{
+    return count_allocation(__libc_malloc(size));
+}
+
+void *calloc(size_t count, size_t size)
+{
+    return count_allocation(__libc_calloc(count, size));
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    size_t old_size = ptr ? malloc_usable_size(ptr) : 0;
+    void *moved = __libc_realloc(ptr, size);
+
+    if (!moved) {
+        // realloc(ptr, 0) frees ptr, while a failure leaves it intact.
+        if (ptr && !size) count_free(old_size);
+        return NULL;
+    }
+    if (!ptr) return count_allocation(moved);
+
+    // Resized block is the same one, whether moved or not.
+    size_t new_size = malloc_usable_size(moved);
+    unsigned long long live;
+    if (new_size >= old_size) {
+        live = __atomic_add_fetch(&mem_live_bytes, new_size - old_size,
+                                  __ATOMIC_RELAXED);
+    }
+    else {
+        live = __atomic_sub_fetch(&mem_live_bytes, old_size - new_size,
+                                  __ATOMIC_RELAXED);
+    }
+    update_peak(live);
+
+    return moved;
+}
+
+void free(void *ptr)
+{
+    if (!ptr) return;
+    count_free(malloc_usable_size(ptr));
+    __libc_free(ptr);
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    return count_allocation(__libc_memalign(alignment, size));
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    return count_allocation(__libc_memalign(alignment, size));
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+    // Alignment should be a power of two multiple of sizeof(void *).
+    if (alignment % sizeof(void *) || (alignment & (alignment - 1)) ||
+        !alignment) {
+        return EINVAL;
+    }
+
+    void *block = count_allocation(__libc_memalign(alignment, size));
+    if (!block) return ENOMEM;
+
+    *ptr = block;
+    return 0;
+}
+
+void *valloc(size_t size)
+{
+    return count_allocation(__libc_valloc(size));
+}
+
+void *pvalloc(size_t size)
+{
+    return count_allocation(__libc_pvalloc(size));
+}
+
+/**
+ * Accounts for a newly allocated block.
+ *
+ * Parameters:
+ *  -ptr : The block, or NULL if allocation failed.
+ *
+ * Returns:
+ *  Given block.
+ */
+void *count_allocation(void *ptr)
+{
+    if (!ptr) return NULL;
+
+    unsigned long long live = __atomic_add_fetch(
+        &mem_live_bytes, malloc_usable_size(ptr), __ATOMIC_RELAXED);
+    __atomic_add_fetch(&mem_allocations, 1, __ATOMIC_RELAXED);
+    update_peak(live);
+
+    return ptr;
+}
+
+/**
+ * Accounts for a block about to be freed.
+ *
+ * Parameters:
+ *  -size : Usable size of the block.
+ */
+void count_free(size_t size)
+{
+    __atomic_sub_fetch(&mem_live_bytes, size, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&mem_frees, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Raises peak of live bytes to given value, if it is lower.
+ */
+void update_peak(unsigned long long live)
+{
+    unsigned long long peak = __atomic_load_n(&mem_peak_bytes,
+                                              __ATOMIC_RELAXED);
+    while (live > peak &&
+           !__atomic_compare_exchange_n(&mem_peak_bytes, &peak, live, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+/**
+ * Reads the resident set size of the process. Read without stdio, so that
+ * nothing gets allocated while taking a snapshot.
+ *
+ * Returns:
+ *  Resident set size in bytes, or 0 if it cannot be read.
+ */
+unsigned long long resident_bytes()
+{
+    char buffer[4096];
+    int fd = open("/proc/self/status", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    ssize_t n = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    if (n <= 0) return 0;
+    buffer[n] = '\0';
+
+    char *line = strstr(buffer, "\nVmRSS:");
+    if (!line) return 0;
+
+    return strtoull(line + strlen("\nVmRSS:"), NULL, 10) * 1024;
+}
@@ -0,0 +1,62 @@
+/**
+ * memstats.h
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This header provides accounting of the heap memory used by the shell, so
+ * that memory staying constant over any number of lines can be verified.
+ *
+ * Accounting is done by replacing malloc() and the rest of allocation
+ * routines of the C library with thin wrappers around the original ones,
+ * which count the usable size of every block allocated and freed. Every
+ * allocation of the process is covered, including the ones made inside the
+ * C library (e.g. by getline() or opendir()) and by background threads.
+ *
+ * Resident set size of the process is reported along, since memory taken
+ * outside of the heap, like mapped scripts or pages the allocator keeps
+ * after blocks are freed, does not show up in heap accounting.
+ *
+ * Types defined in memstats.h:
+ *  -memstats_t
+ *
+ * Functions defined in memstats.h:
+ *  -void memstats_get(memstats_t *stats)
+ *  -void memstats_print()
+ *
+ * Version: 0.1
+ */
+
+#ifndef __memstats_h__
+#define __memstats_h__
+
+
+// Snapshot of heap accounting.
+typedef struct {
+    unsigned long long live_bytes;   // Bytes in blocks currently allocated.
+    unsigned long long peak_bytes;   // Maximum value of live_bytes so far.
+    unsigned long long allocations;  // Blocks allocated so far.
+    unsigned long long frees;        // Blocks freed so far.
+    unsigned long long resident_bytes;  // Resident set size of process.
+} memstats_t;
+
+
+/**
+ * Takes a snapshot of heap accounting.
+ *
+ * Parameters:
+ *  -stats : A reference where the snapshot is stored.
+ */
+void memstats_get(memstats_t *stats);
+
+/**
+ * Prints heap accounting in human readable form, along with the average
+ * number of allocations made for each line parsed.
+ */
+void memstats_print();
+
+#endif
@@ -0,0 +1,126 @@
+/**
+ * output.c
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This file provides an implementation for routines declared in output.h
+ * header.
+ *
+ * Version: 0.1
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include "output.h"
+
+
+void write_vector(int fd, struct iovec *iov, int iovc);
+
+
+char output_buffer[OUTPUT_BUFFER_SIZE];
+size_t output_length = 0;  // Bytes currently buffered.
+int output_fd = -1;        // Descriptor buffered data are destined to.
+int output_hooked = 0;     // Whether flush at exit is registered.
+
+
+void output_write(int fd, const char *data, size_t length)
+{
+    if (!output_hooked) {
+        atexit(output_flush);
+        output_hooked = 1;
+    }
+
+    // Keep order across descriptors, by never buffering data of both.
+    if (output_length && fd != output_fd) output_flush();
+    output_fd = fd;
+
+    if (output_length + length <= OUTPUT_BUFFER_SIZE) {
+        memcpy(output_buffer + output_length, data, length);
+        output_length += length;
+        return;
+    }
+
+    // Too large to be buffered, so write it right after buffered data.
+    struct iovec iov[2] = {
+        { output_buffer, output_length },
+        { (void *) data, length }
+    };
+    write_vector(fd, iov, 2);
+    output_length = 0;
+}
+
+void output_printf(int fd, const char *format, ...)
+{
+    char small[1024];
+    va_list args;
+
+    va_start(args, format);
+    int length = vsnprintf(small, sizeof(small), format, args);
+    va_end(args);
+    if (length < 0) return;
+
+    if ((size_t) length < sizeof(small)) {
+        output_write(fd, small, length);
+        return;
+    }
+
+    // Rare long messages are formatted again into a large enough buffer.
+    char *large = (char *) malloc(length + 1);
+    if (!large) return;
+    va_start(args, format);
+    vsnprintf(large, length + 1, format, args);
+    va_end(args);
+    output_write(fd, large, length);
+    free(large);
+}
+
+void output_perror(const char *message)
+{
+    int error = errno;  // Could be changed by any other call.
+    output_stderr("%s: %s\n", message, strerror(error));
+}
+
+void output_flush()
+{
+    if (!output_length) return;
+
+    struct iovec iov = { output_buffer, output_length };
+    write_vector(output_fd, &iov, 1);
+    output_length = 0;
+}
+
+/**
+ * Writes a vector of buffers entirely, retrying after partial writes and
+ * interrupts. Data that cannot be written (e.g. to a closed pipe) are
+ * dropped.
+ */
+void write_vector(int fd, struct iovec *iov, int iovc)
+{
+    while (iovc > 0) {
+        ssize_t n = writev(fd, iov, iovc);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+
+        // Skip the buffers written entirely and advance the partial one.
+        while (iovc > 0 && (size_t) n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            iovc--;
+        }
+        if (iovc > 0) {
+            iov->iov_base = (char *) iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+}
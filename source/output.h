@@ -0,0 +1,103 @@
+/**
+ * output.h
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This header provides the channel through which the shell and its
+ * built-in commands print anything, instead of stdio.
+ *
+ * Output for stdout and stderr shares a single buffer, written straight to
+ * file descriptors 1 and 2. Whenever output switches to the other
+ * descriptor, what is already buffered is written first, so messages keep
+ * the order they were printed in across both descriptors. Data that don't
+ * fit in the buffer are written along with buffered data by a single
+ * writev(), without being copied.
+ *
+ * Buffered output is written:
+ *  -by output_flush(), which should be called before forking any process
+ *   (otherwise buffered data would be written by the child too) and before
+ *   blocking for input,
+ *  -when buffer gets full,
+ *  -when shell exits through exit().
+ *
+ * Output channel is not thread safe, so only the main thread prints.
+ *
+ * Constants defined in output.h:
+ *  -OUTPUT_BUFFER_SIZE
+ *
+ * Macros defined in output.h:
+ *  -output_stdout(format, ...)
+ *  -output_stderr(format, ...)
+ *
+ * Functions defined in output.h:
+ *  -void output_write(int fd, const char *data, size_t length)
+ *  -void output_printf(int fd, const char *format, ...)
+ *  -void output_perror(const char *message)
+ *  -void output_flush()
+ *
+ * Version: 0.1
+ */
+
+#ifndef __output_h__
+#define __output_h__
+
+#include <stddef.h>
+#include <unistd.h>
+
+
+// Size of output buffer.
+#define OUTPUT_BUFFER_SIZE 65536
+
+
+/**
+ * Prints formatted output to stdout, like printf().
+ */
+#define output_stdout(...) output_printf(STDOUT_FILENO, __VA_ARGS__)
+
+/**
+ * Prints formatted diagnostics to stderr, like fprintf(stderr, ...).
+ */
+#define output_stderr(...) output_printf(STDERR_FILENO, __VA_ARGS__)
+
+
+/**
+ * Appends data to the output of a file descriptor.
+ *
+ * Parameters:
+ *  -fd : Either STDOUT_FILENO or STDERR_FILENO.
+ *  -data : Data to be written.
+ *  -length : Number of bytes of data.
+ */
+void output_write(int fd, const char *data, size_t length);
+
+/**
+ * Appends formatted output, like the one of printf(), to the output of a
+ * file descriptor.
+ *
+ * Parameters:
+ *  -fd : Either STDOUT_FILENO or STDERR_FILENO.
+ *  -format : Format string, as for printf().
+ */
+void output_printf(int fd, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/**
+ * Prints a message followed by the description of errno to stderr, like
+ * perror() does.
+ *
+ * Parameters:
+ *  -message : Message to be printed.
+ */
+void output_perror(const char *message);
+
+/**
+ * Writes all buffered output to its file descriptor.
+ */
+void output_flush();
+
+#endif
@@ -0,0 +1,282 @@
+/**
+ * parsecache.c
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This file provides an implementation for routines declared in
+ * parsecache.h header.
+ *
+ * Version: 0.1
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <string.h>
+#include <assert.h>
+#include "command.h"
+#include "parser.h"
+#include "engine.h"
+#include "stats.h"
+#include "parsecache.h"
+
+
+// A cached line.
+typedef struct parsed_line {
+    char *text;                 // Text of line.
+    size_t length;              // Length of text.
+    uint64_t hash;              // Hash of text.
+    command_t **commands;       // Commands parsed out of line.
+    int commandc;               // Number of commands.
+    size_t cost;                // Heap bytes taken by line and commands.
+    struct parsed_line *prev;   // More recently used line.
+    struct parsed_line *next;   // Less recently used line.
+    struct parsed_line *chain;  // Next line in the same bucket.
+} parsed_line_t;
+
+
+parsed_line_t *parsecache_find(const char *line, size_t length,
+                                uint64_t hash);
+void parsecache_insert(parsed_line_t *entry);
+void parsecache_evict(parsed_line_t *entry);
+void parsecache_unlink(parsed_line_t *entry);
+void parsecache_push(parsed_line_t *entry);
+void parsecache_resolve(command_t **commands, int commandc);
+size_t parsecache_cost(command_t *comm);
+uint64_t parsecache_hash(const char *line, size_t length);
+
+
+parsed_line_t **parsecache_buckets = NULL;  // Hash table of cached lines.
+size_t parsecache_bucketc = 0;     // Size of hash table, a power of 2.
+size_t parsecache_linec = 0;       // Number of cached lines.
+size_t parsecache_used = 0;        // Bytes taken by cached lines.
+parsed_line_t *parsecache_mru = NULL;  // Most recently used line.
+parsed_line_t *parsecache_lru = NULL;  // Least recently used line.
+
+
+int parsecache_parse_line(char *line, size_t length,
+                          const uint32_t *structurals, size_t structc,
+                          command_t ***commands, int *commandc, int *shared)
+{
+    *shared = 0;
+
+    // Lines found in the cache are counted as parsed too.
+    shell_stats.lines_parsed++;
+    shell_stats.bytes_parsed += length;
+
+    uint64_t hash = parsecache_hash(line, length);
+    parsed_line_t *entry = parsecache_find(line, length, hash);
+    if (entry) {
+        shell_stats.parse_cache_hits++;
+        parsecache_unlink(entry);
+        parsecache_push(entry);
+        *commands = entry->commands;
+        *commandc = entry->commandc;
+        *shared = 1;
+        return 0;
+    }
+
+    shell_stats.parse_cache_misses++;
+
+    // Keep text, since parser may modify line when reporting errors.
+    char *text = (char *) malloc(length + 1);
+    assert(text);
+    memcpy(text, line, length + 1);
+
+    if (parse_line_indexed(line, length, structurals, structc,
+                           commands, commandc)) {
+        free(text);
+        return -1;
+    }
+
+    entry = (parsed_line_t *) malloc(sizeof(parsed_line_t));
+    assert(entry);
+    entry->text = text;
+    entry->length = length;
+    entry->hash = hash;
+    entry->commands = *commands;
+    entry->commandc = *commandc;
+    entry->cost = malloc_usable_size(entry) + malloc_usable_size(text) +
+                  malloc_usable_size(*commands);
+    for (int i = 0; i < *commandc; i++)
+        entry->cost += parsecache_cost((*commands)[i]);
+
+    // A line larger than the whole cache would just flush it.
+    if (entry->cost > PARSECACHE_BUDGET) {
+        free(entry->text);
+        free(entry);
+        return 0;
+    }
+
+    parsecache_resolve(*commands, *commandc);
+    parsecache_insert(entry);
+    *shared = 1;
+
+    return 0;
+}
+
+/**
+ * Finds a cached line.
+ *
+ * Returns:
+ *  The cached line, or NULL if it is not cached.
+ */
+parsed_line_t *parsecache_find(const char *line, size_t length,
+                                uint64_t hash)
+{
+    if (!parsecache_bucketc) return NULL;
+
+    parsed_line_t *entry = parsecache_buckets[hash & (parsecache_bucketc - 1)];
+    for (; entry; entry = entry->chain) {
+        if (entry->hash == hash && entry->length == length &&
+            !memcmp(entry->text, line, length)) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Adds a line to the cache as the most recently used one, evicting the
+ * least recently used lines that don't fit in the budget along with it.
+ */
+void parsecache_insert(parsed_line_t *entry)
+{
+    // Keep chains short, by having at least as many buckets as lines.
+    if (parsecache_linec + 1 > parsecache_bucketc) {
+        size_t bucketc = parsecache_bucketc ? parsecache_bucketc * 2 : 256;
+        parsed_line_t **buckets = (parsed_line_t **) calloc(
+            bucketc, sizeof(parsed_line_t *));
+        assert(buckets);
+
+        for (parsed_line_t *e = parsecache_mru; e; e = e->next) {
+            size_t bucket = e->hash & (bucketc - 1);
+            e->chain = buckets[bucket];
+            buckets[bucket] = e;
+        }
+
+        // Hash table is charged to the budget too.
+        parsecache_used -= malloc_usable_size(parsecache_buckets);
+        parsecache_used += malloc_usable_size(buckets);
+
+        free(parsecache_buckets);
+        parsecache_buckets = buckets;
+        parsecache_bucketc = bucketc;
+    }
+
+    while (parsecache_lru &&
+           parsecache_used + entry->cost > PARSECACHE_BUDGET) {
+        parsecache_evict(parsecache_lru);
+    }
+
+    size_t bucket = entry->hash & (parsecache_bucketc - 1);
+    entry->chain = parsecache_buckets[bucket];
+    parsecache_buckets[bucket] = entry;
+
+    parsecache_push(entry);
+    parsecache_linec++;
+    parsecache_used += entry->cost;
+}
+
+/**
+ * Drops a line from the cache, destroying its commands.
+ */
+void parsecache_evict(parsed_line_t *entry)
+{
+    parsed_line_t **link = &parsecache_buckets[entry->hash &
+                                               (parsecache_bucketc - 1)];
+    while (*link != entry) link = &(*link)->chain;
+    *link = entry->chain;
+
+    parsecache_unlink(entry);
+    parsecache_linec--;
+    parsecache_used -= entry->cost;
+
+    for (int i = 0; i < entry->commandc; i++)
+        command_destroy(entry->commands[i]);
+    free(entry->commands);
+    free(entry->text);
+    free(entry);
+}
+
+/**
+ * Removes a line from the list of lines in order of use.
+ */
+void parsecache_unlink(parsed_line_t *entry)
+{
+    if (entry->prev) entry->prev->next = entry->next;
+    else parsecache_mru = entry->next;
+    if (entry->next) entry->next->prev = entry->prev;
+    else parsecache_lru = entry->prev;
+}
+
+/**
+ * Inserts a line at the head of the list of lines in order of use.
+ */
+void parsecache_push(parsed_line_t *entry)
+{
+    entry->prev = NULL;
+    entry->next = parsecache_mru;
+    if (parsecache_mru) parsecache_mru->prev = entry;
+    else parsecache_lru = entry;
+    parsecache_mru = entry;
+}
+
+/**
+ * Records in commands, and in commands of their groups, the built-in each
+ * one invokes, so it is not looked up on every execution.
+ */
+void parsecache_resolve(command_t **commands, int commandc)
+{
+    for (int i = 0; i < commandc; i++) {
+        command_t *comm = commands[i];
+        if (command_get_type(comm) != COMMAND_SIMPLE) {
+            parsecache_resolve(command_get_group(comm),
+                             command_get_group_size(comm));
+        }
+        else command_set_builtin(comm, find_built_in(comm));
+    }
+}
+
+/**
+ * Returns the number of heap bytes taken by a command, including the
+ * commands of a group, as reserved by the allocator for each block.
+ */
+size_t parsecache_cost(command_t *comm)
+{
+    size_t cost = malloc_usable_size(comm) +
+                  malloc_usable_size(command_get_name(comm)) +
+                  malloc_usable_size(command_get_args(comm)) +
+                  malloc_usable_size(comm->patterns) +
+                  malloc_usable_size(command_get_group(comm));
+
+    for (int i = 0; i < command_get_args_num(comm); i++)
+        cost += malloc_usable_size(command_get_args(comm)[i]);
+
+    for (int i = 0; i < command_get_group_size(comm); i++)
+        cost += parsecache_cost(command_get_group(comm)[i]);
+
+    return cost;
+}
+
+/**
+ * Computes the FNV-1a hash of a line.
+ */
+uint64_t parsecache_hash(const char *line, size_t length)
+{
+    const unsigned char *bytes = (const unsigned char *) line;
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
@@ -0,0 +1,76 @@
+/**
+ * parsecache.h
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This header provides a cache of parsed lines, so lines repeated by
+ * generated scripts or typed again and again are tokenized only the first
+ * time they are met.
+ *
+ * Lines are looked up by the hash of their text and compared in full. The
+ * commands of a cached line are kept as parsed, along with the index of
+ * the built-in each one invokes, and are executed right from the cache,
+ * since the engine never modifies them. Least recently used lines are
+ * dropped when the memory taken by cached lines exceeds
+ * PARSECACHE_BUDGET bytes.
+ *
+ * Lines that fail to parse are not cached. Patterns are kept in commands
+ * as they are and expanded only when executed (see engine.h), so lines
+ * that contain them are cached like any other.
+ *
+ * Constants defined in parsecache.h:
+ *  -PARSECACHE_BUDGET
+ *
+ * Functions defined in parsecache.h:
+ *  -int parsecache_parse_line(char *line, size_t length,
+ *                             const uint32_t *structurals, size_t structc,
+ *                             command_t ***commands, int *commandc,
+ *                             int *shared)
+ *
+ * Version: 0.1
+ */
+
+#ifndef __parsecache_h__
+#define __parsecache_h__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "command.h"
+
+
+// Maximum number of bytes taken by cached lines and their commands.
+#define PARSECACHE_BUDGET (1024 * 1024)
+
+
+/**
+ * Parses a line like parse_line_indexed() does, unless the same line has
+ * been parsed before, in which case its cached commands are returned.
+ * Hits and misses are counted in shell_stats.
+ *
+ * Parameters:
+ *  -line : The line to be parsed.
+ *  -length : Length of line.
+ *  -structurals : Offsets of structural characters of line.
+ *  -structc : Number of structural characters.
+ *  -commands : A reference where the array of parsed commands is stored.
+ *  -commandc : A reference where the number of commands is stored.
+ *  -shared : A reference where 1 is stored if commands are owned by the
+ *          cache, or 0 if they are owned by the caller, who should destroy
+ *          them like the ones of parse_line_indexed().
+ *
+ * WARNING: Commands owned by the cache are valid only until the next call,
+ * and should never be modified.
+ *
+ * Returns:
+ *  0 on success, else -1, as parse_line_indexed() does.
+ */
+int parsecache_parse_line(char *line, size_t length,
+                          const uint32_t *structurals, size_t structc,
+                          command_t ***commands, int *commandc, int *shared);
+
+#endif
@@ -10,6 +10,10 @@
  *
  * This file provides an implementation for routines defined in parser.h
  *
+ * Tokenizing is done by jumping between the structural characters of the
+ * line, as located by scanner. Bytes between two structurals are never
+ * examined.
+ *
  * Version: 0.1
  */
 
@@ -19,151 +23,460 @@
 #include <assert.h>
 #include "command.h"
 #include "string_utils.h"
+#include "scanner.h"
+#include "globbing.h"
+#include "stats.h"
+#include "output.h"
 #include "parser.h"
 
 
-char *exclude_comment(char *line, const char *delim, const char *solid_delim);
-char *contains_unexpected_token(char *cmd_block);
+// A list of commands under construction, either the line itself or the
+// body of a group.
+typedef struct {
+    command_t **comms;     // Commands found so far.
+    int comms_c;           // Number of found commands.
+    int avail_space;       // Size of comms array.
+    int next_policy;       // Execution policy of the next command found.
+    int type;              // Type of group the list belongs to, or
+                           // COMMAND_SIMPLE for the line itself.
+} parse_list_t;
+
+// State of parse_line_indexed() while building commands out of words.
+typedef struct {
+    char *line;            // Line being parsed.
+    parse_list_t list;     // Innermost list under construction.
+    parse_list_t *outer;   // Lists enclosing it, outermost first.
+    int depth;             // Number of enclosing lists.
+    int outer_capacity;    // Size of outer array.
+    command_t *comm;       // Command under construction.
+    size_t word_start;     // Offset where the word under construction starts.
+    size_t segment_start;  // Offset where current command's text starts.
+    char *syntax_error;    // Unexpected token found, if any.
+} parse_state_t;
+
+
+void add_word(parse_state_t *state, size_t end);
+void add_command(parse_state_t *state, size_t end);
+void open_group(parse_state_t *state, int type);
+void close_group(parse_state_t *state, int type, char *token);
+void discard_lists(parse_state_t *state);
+int is_operator(const char *line, const uint32_t *structurals, size_t structc,
+                size_t i, const char *op);
+char *unexpected_token(const char *line, const uint32_t *structurals,
+                       size_t structc, size_t i, size_t offset, int allow_main,
+                       int allow_close);
+int is_blank(char c);
 
 
 char *main_delim = ";";    // Delimiter for independent command sequences.
 char *sub_delim = "&&";    // Delimiter for chained command sequences.
+char *or_delim = "||";     // Delimiter for commands run on failure.
 char *solid_delim = "\"";  // Delimiter that defines a solid block.
 char *comment_delim = "#"; // Delimiter that defines a comment.
+char *subshell_open = "("; // Delimiters of a group run in isolation.
+char *subshell_close = ")";
+char *braces_open = "{";   // Words enclosing a group run by the shell.
+char *braces_close = "}";
+
+char unexpected_word[64];  // Copy of a word found where none is allowed.
 
 
 int parse_line(char *line, command_t ***commands, int *commandc)
 {
-    command_t **comms = NULL;  // Pointer to the array containing found commands.
-    int comms_c = 0;           // Number of found commands.
-    int avail_space = 0;
+    static struct_index_t index;  // Reused among calls, to avoid allocations.
 
-    // Blocks defined as solid, should have both a starting and ending delim.
-    if (str_str_occurencies(line, solid_delim) % 2 != 0) {
-        printf("Syntax Error: starting %s expects an ending one.\n", solid_delim);
-        return -1;
-    }
+    size_t length = strlen(line);
+    unsigned long long start_ns = stats_now_ns();
 
-    // Init array space for 1 command.
-    comms = (command_t **) malloc(sizeof(command_t *) * 1);
-    assert(comms);
-    avail_space = 1;
+    shell_stats.lines_parsed++;
+    shell_stats.bytes_parsed += length;
 
-    // Replace all newlines by spaces.
-    str_char_replace(line, '\n', ' ');
-    str_char_replace(line, '\r', ' ');
+    scan_structurals(line, length, &index);
+    shell_stats.parse_ns += stats_now_ns() - start_ns;
 
-    // Create a copy of given line to work with.
-    char *linecp = (char *) malloc(sizeof(char) * (strlen(line)+1));
-    strcpy(linecp, line);
+    return parse_line_indexed(line, length, index.pos, index.count,
+                              commands, commandc);
+}
 
-    // Clean comment part.
-    exclude_comment(linecp, comment_delim, solid_delim);
+int parse_line_indexed(char *line, size_t length, const uint32_t *structurals,
+                       size_t structc, command_t ***commands, int *commandc)
+{
+    unsigned long long start_ns = stats_now_ns();
 
-    char *syntax_error = NULL;  // Unexpected token that caused a syntax error.
+    *commands = NULL;
+    *commandc = 0;
 
-    // Start searching for blocks delimited by main_delim from the beggining.
-    char *cur_main = NULL;     // Pointer to current token found.
-    char *next_main = linecp;  // Pointer after the end of cur_main token.
+    // Blocks defined as solid, should have both a starting and ending delim.
+    size_t quotes = 0;
+    for (size_t i = 0; i < structc; i++) {
+        if (line[structurals[i]] == *solid_delim) quotes++;
+    }
+    if (quotes % 2 != 0) {
+        output_stderr("Syntax Error: starting %s expects an ending one.\n", solid_delim);
+        str_char_replace(line, '\n', ' ');
+        str_char_replace(line, '\r', ' ');
+        shell_stats.parse_ns += stats_now_ns() - start_ns;
+        return -1;
+    }
 
-    syntax_error = contains_unexpected_token(linecp);
+    parse_state_t state;
+    state.line = line;
+    state.list.comms = (command_t **) malloc(sizeof(command_t *) * 1);
+    assert(state.list.comms);
+    state.list.comms_c = 0;
+    state.list.avail_space = 1;
+    state.list.next_policy = COMMAND_ALWAYS;
+    state.list.type = COMMAND_SIMPLE;
+    state.outer = NULL;
+    state.depth = 0;
+    state.outer_capacity = 0;
+    state.comm = NULL;
+    state.word_start = 0;
+    state.segment_start = 0;
+
+    size_t end = length;  // Where the parsed part of the line ends.
+
+    // A delimiter placed before any command is invalid.
+    state.syntax_error =
+        unexpected_token(line, structurals, structc, 0, 0, 0, 0);
+
+    size_t i = 0;
+    while (i < structc && !state.syntax_error) {
+        size_t pos = structurals[i];
+        char c = line[pos];
+
+        if (c == *comment_delim) {
+            // Everything after a comment delimiter is ignored.
+            end = pos;
+            break;
+        }
+        else if (is_blank(c)) {
+            add_word(&state, pos);
+            state.word_start = pos + 1;
+            i++;
+        }
+        else if (c == *main_delim) {
+            add_word(&state, pos);
+            add_command(&state, pos);
+            // A new independent sequence starts.
+            state.list.next_policy = COMMAND_ALWAYS;
+            state.word_start = state.segment_start = pos + 1;
+            if (!state.syntax_error) {
+                state.syntax_error = unexpected_token(
+                    line, structurals, structc, i+1, pos+1, 0, 1);
+            }
+            i++;
+        }
+        else if (is_operator(line, structurals, structc, i, sub_delim) ||
+                 is_operator(line, structurals, structc, i, or_delim)) {
+            add_word(&state, pos);
+            add_command(&state, pos);
+            state.list.next_policy = c == *sub_delim ?
+                COMMAND_ON_PREVIOUS_SUCCEED : COMMAND_ON_PREVIOUS_FAIL;
+            state.word_start = state.segment_start = pos + 2;
+            // Main delimiter just ends the chain, any other is invalid.
+            if (!state.syntax_error) {
+                state.syntax_error = unexpected_token(
+                    line, structurals, structc, i+2, pos+2, 1, 0);
+            }
+            i += 2;
+        }
+        else if (c == *subshell_open) {
+            // A group can only start where a command starts.
+            if (state.comm || pos > state.word_start) {
+                state.syntax_error = subshell_open;
+                break;
+            }
+            open_group(&state, COMMAND_GROUP_SUBSHELL);
+            state.word_start = state.segment_start = pos + 1;
+            state.syntax_error = unexpected_token(
+                line, structurals, structc, i+1, pos+1, 0, 0);
+            i++;
+        }
+        else if (c == *subshell_close) {
+            add_word(&state, pos);
+            add_command(&state, pos);
+            if (!state.syntax_error)
+                close_group(&state, COMMAND_GROUP_SUBSHELL, subshell_close);
+            state.word_start = state.segment_start = pos + 1;
+            i++;
+        }
+        else {
+            // Quotes, single '&' and single '|' are part of words.
+            i++;
+        }
+    }
 
-    // Separate the given line into blocks delimited by main_delim.
-    while((cur_main = strtok_multi_solid(
-                &next_main, main_delim, solid_delim)) != NULL &&
-          !syntax_error) {
+    // Complete the last command of the line.
+    if (!state.syntax_error) {
+        add_word(&state, end);
+        add_command(&state, end);
+    }
 
-        // Start searching for commands delimited by sub_delim, into the token
-        // returned by splitting based on main_delim.
-        char *cur_sub = NULL;       // Pointer to the current subtoken found.
-        char *next_sub = cur_main;  // Pointer after the end of cur_sub token.
+    if (!state.syntax_error && state.depth > 0) {
+        output_stderr("Syntax Error: starting %s expects an ending one.\n",
+                      state.list.type == COMMAND_GROUP_BRACES ?
+                      braces_open : subshell_open);
+        state.syntax_error = "";
+    }
+    else if (state.syntax_error) {
+        output_stderr("Syntax error near unexpected token '%s'\n",
+                      state.syntax_error);
+    }
 
-        int sub_comms = 0;  // Counter for commands found in current block.
+    if (state.syntax_error) {
+        discard_lists(&state);
+        str_char_replace(line, '\n', ' ');
+        str_char_replace(line, '\r', ' ');
+        shell_stats.parse_ns += stats_now_ns() - start_ns;
+        return -1;
+    }
 
-        syntax_error = contains_unexpected_token(next_main);
+    // Write results to given arguments.
+    *commands = state.list.comms;
+    *commandc = state.list.comms_c;
+    free(state.outer);
 
-        // Separate each sub block, into commands separated by sub_delim.
-        while((cur_sub = strtok_multi_solid(
-                    &next_sub, sub_delim, solid_delim)) != NULL &&
-               !syntax_error) {
+    shell_stats.parse_ns += stats_now_ns() - start_ns;
 
-            if ((syntax_error = contains_unexpected_token(next_sub))) break;
+    return 0;
+}
 
-            // If no available space left, double the size of array.
-            if (avail_space == comms_c) {
-                avail_space *= 2;
-                comms = (command_t **) realloc(
-                            comms, sizeof(command_t *) * avail_space);
-                assert(comms);
-            }
+/**
+ * Adds the word that starts at state->word_start and ends at given offset
+ * to the command under construction. The first word of a command is its
+ * name, the following ones its arguments.
+ *
+ * Parameters:
+ *  -state : Current state of parsing.
+ *  -end : Offset after the last character of the word.
+ */
+void add_word(parse_state_t *state, size_t end)
+{
+    size_t start = state->word_start;
+    if (end <= start) return;  // No characters since last separator.
 
-            // Create a new command object for each command found.
-            comms[comms_c] = command_create_from_str(cur_sub);
-            // Commands separated by sub_delim form a chain where each
-            // subsequent one is executed only if the previous one succeeds.
-            if (sub_comms != 0) {
-                command_set_exec_policy(comms[comms_c],
-                                        COMMAND_ON_PREVIOUS_SUCCEED);
-            }
-            comms_c++;
-            sub_comms++;
+    char *line = state->line;
+
+    if (!state->comm) {
+        // Braces are recognized only as whole words where a command starts.
+        if (end - start == 1 && line[start] == *braces_open) {
+            open_group(state, COMMAND_GROUP_BRACES);
+            state->segment_start = end;
+            return;
+        }
+        if (end - start == 1 && line[start] == *braces_close) {
+            close_group(state, COMMAND_GROUP_BRACES, braces_close);
+            state->segment_start = end;
+            return;
         }
+
+        state->comm = command_create();
+        assert(state->comm);
+    }
+    else if (command_get_type(state->comm) != COMMAND_SIMPLE) {
+        // Nothing but a delimiter may follow a group.
+        snprintf(unexpected_word, sizeof(unexpected_word), "%.*s",
+                 (int) (end - start), line + start);
+        state->syntax_error = unexpected_word;
+        return;
     }
 
-    // Write results to given arguments.
-    *commands = comms;
-    *commandc = comms_c;
+    // Temporarily terminate the word in place, so it can be copied.
+    char saved;
 
-    if (syntax_error) {
-        printf("Syntax error near unexpected token '%s'\n", syntax_error);
-        return -1;
+    if (!command_get_name(state->comm)) {
+        saved = line[end];
+        line[end] = '\0';
+        command_set_name(state->comm, line + start);
+        line[end] = saved;
+    }
+    else {
+        // Only arguments without any solid delimiter are subject to
+        // pathname expansion.
+        int quoted = memchr(line + start, *solid_delim, end - start) != NULL;
+
+        // Arguments are stripped of enclosing solid delimiters.
+        while (start < end && line[start] == *solid_delim) start++;
+        while (end > start && line[end-1] == *solid_delim) end--;
+        saved = line[end];
+        line[end] = '\0';
+
+        // Patterns are expanded right before the command gets executed,
+        // against the directory it runs in.
+        if (!quoted && glob_has_magic(line + start))
+            command_add_pattern(state->comm, line + start);
+        else command_add_arg(state->comm, line + start);
+
+        line[end] = saved;
     }
+}
 
-    free(linecp);
+/**
+ * Completes the command under construction and appends it to the list under
+ * construction. A command is added for every non-empty text between
+ * delimiters, even if it contains only blanks, in which case it gets an
+ * empty name.
+ *
+ * Parameters:
+ *  -state : Current state of parsing.
+ *  -end : Offset where the text of current command ends.
+ */
+void add_command(parse_state_t *state, size_t end)
+{
+    // A group just closed is complete, even without text after it.
+    if (end <= state->segment_start && !state->comm) return;
+    if (state->syntax_error) return;
+
+    command_t *comm = state->comm;
+    if (!comm) {
+        comm = command_create();
+        assert(comm);
+    }
+    if (!command_get_name(comm)) command_set_name(comm, "");
+
+    // Policy follows the delimiter found before the command.
+    command_set_exec_policy(comm, state->list.next_policy);
+
+    // If no available space left, double the size of array.
+    parse_list_t *list = &state->list;
+    if (list->avail_space == list->comms_c) {
+        list->avail_space *= 2;
+        list->comms = (command_t **) realloc(
+                    list->comms, sizeof(command_t *) * list->avail_space);
+        assert(list->comms);
+    }
 
-    return 0;
+    list->comms[list->comms_c++] = comm;
+    state->comm = NULL;
 }
 
 /**
- * Terminate a line at comment position by placing a NUL char.
+ * Starts the list of commands of a group, nested in the current list.
  *
  * Parameters:
- *  -line : The line to search for comment occurence.
- *  -delim : The delimiter that defines the beggining of a comment.
- *  -solid_delim : The delimiter that defines a solid block.
+ *  -state : Current state of parsing.
+ *  -type : Type of the group.
+ */
+void open_group(parse_state_t *state, int type)
+{
+    if (state->depth == state->outer_capacity) {
+        state->outer_capacity = state->outer_capacity ?
+                                state->outer_capacity * 2 : 4;
+        state->outer = (parse_list_t *) realloc(
+            state->outer, sizeof(parse_list_t) * state->outer_capacity);
+        assert(state->outer);
+    }
+    state->outer[state->depth++] = state->list;
+
+    state->list.comms = (command_t **) malloc(sizeof(command_t *) * 1);
+    assert(state->list.comms);
+    state->list.comms_c = 0;
+    state->list.avail_space = 1;
+    state->list.next_policy = COMMAND_ALWAYS;
+    state->list.type = type;
+}
+
+/**
+ * Completes the list of commands of a group, which becomes the command under
+ * construction of the enclosing list.
  *
- * Returns:
- *  The position of the beggining of a comment if it was found, else NULL.
+ * Parameters:
+ *  -state : Current state of parsing.
+ *  -type : Type of group closed.
+ *  -token : Closing delimiter, reported if no such group is open or if the
+ *          group is empty.
  */
-char *exclude_comment(char *line, const char *delim, const char *solid_delim)
+void close_group(parse_state_t *state, int type, char *token)
 {
-    strtok_multi_solid(&line, delim, solid_delim);
+    if (state->depth == 0 || state->list.type != type ||
+        state->list.comms_c == 0) {
+        state->syntax_error = token;
+        return;
+    }
 
-    return line;
+    command_t *group = command_create_group(type, state->list.comms,
+                                            state->list.comms_c);
+    state->list = state->outer[--state->depth];
+    state->comm = group;
 }
 
 /**
- * Checks the given string for the occurence of occupied tokens on its
- * beggining, as defined by main_delim and sub_delim globals.
+ * Destroys all commands found so far, after a syntax error.
+ */
+void discard_lists(parse_state_t *state)
+{
+    while (1) {
+        for (int j = 0; j < state->list.comms_c; j++)
+            command_destroy(state->list.comms[j]);
+        free(state->list.comms);
+        if (state->depth == 0) break;
+        state->list = state->outer[--state->depth];
+    }
+
+    if (state->comm) command_destroy(state->comm);
+    free(state->outer);
+}
+
+/**
+ * Checks whether a two character operator starts at a structural.
+ *
+ * Parameters:
+ *  -line : The line being parsed.
+ *  -structurals : Offsets of structural characters of line.
+ *  -structc : Number of structural characters.
+ *  -i : Entry of structurals to check.
+ *  -op : The operator.
+ */
+int is_operator(const char *line, const uint32_t *structurals, size_t structc,
+                size_t i, const char *op)
+{
+    size_t pos = structurals[i];
+    return line[pos] == op[0] && i+1 < structc &&
+           structurals[i+1] == pos+1 && line[pos+1] == op[1];
+}
+
+/**
+ * Checks whether a delimiter is the first non-blank token at given offset
+ * of a line.
  *
  * Parameters:
- *  -cmd_block : The command block to be expected. It can be a NULL value,
- *          leading to an equal return.
+ *  -line : The line to be checked.
+ *  -structurals : Offsets of structural characters of line.
+ *  -structc : Number of structural characters.
+ *  -i : First entry of structurals not before offset.
+ *  -offset : Offset of line where the check starts.
+ *  -allow_main : If non-zero, main_delim is not considered unexpected.
+ *  -allow_close : If non-zero, subshell_close is not considered unexpected.
  *
  * Returns:
  *  If an unexpected token is found returns a pointer to the global containing
- *  that token. 
+ *  that token, else NULL.
  */
-char *contains_unexpected_token(char *cmd_block)
+char *unexpected_token(const char *line, const uint32_t *structurals,
+                       size_t structc, size_t i, size_t offset, int allow_main,
+                       int allow_close)
 {
-    if (!cmd_block) return NULL;
+    // Skip all initial blank chars, which are consecutive structurals.
+    while (i < structc && structurals[i] == offset && is_blank(line[offset])) {
+        i++;
+        offset++;
+    }
 
-    // Skip all initial whitespace chars.
-    while (*cmd_block == ' ') cmd_block++;
+    if (i >= structc || structurals[i] != offset) return NULL;
 
-    // If a delimiter token is placed before any command, it is invalid.
-    if (!strncmp(cmd_block, main_delim, strlen(main_delim))) return main_delim;
-    if (!strncmp(cmd_block, sub_delim, strlen(sub_delim))) return sub_delim;
+    if (line[offset] == *main_delim && !allow_main) return main_delim;
+    if (line[offset] == *subshell_close && !allow_close) return subshell_close;
+    if (is_operator(line, structurals, structc, i, sub_delim)) return sub_delim;
+    if (is_operator(line, structurals, structc, i, or_delim)) return or_delim;
 
     return NULL;
 }
+
+/**
+ * Checks whether a character separates words.
+ */
+int is_blank(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r';
+}
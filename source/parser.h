@@ -13,6 +13,9 @@
  *
  * Functions defined in parser.h:
  *  -int parse_line(char *line, command_t ***commands, int *commandc)
+ *  -int parse_line_indexed(char *line, size_t length,
+ *                          const uint32_t *structurals, size_t structc,
+ *                          command_t ***commands, int *commandc)
  *
  * Version: 0.1
  */
@@ -20,6 +23,9 @@
 #ifndef __parser_h__
 #define __parser_h__
 
+#include <stddef.h>
+#include <stdint.h>
+
 /**
  * Parses the given text line into a sequence of commands.
  *
@@ -36,7 +42,32 @@
  *  commandc arguments, the array of commands found in given line and its size
  *  are returned respectively. Upon failure, returns a non-zero value and
  *  commands and commandc arguments are set to NULL and 0 respectively.
+ *  Returned commands should be released by command_destroy() and the array
+ *  itself by free().
  */
 int parse_line(char *line, command_t ***commands, int *commandc);
 
+/**
+ * Parses the given text line into a sequence of commands, using an already
+ * built structural index of the line (see scanner.h).
+ *
+ * parse_line() builds the index and calls this routine. Callers that index
+ * text in bulk, like script readers, call this one directly, and count the
+ * line in shell_stats themselves.
+ *
+ * Parameters:
+ *  -line : A null terminated string to parse.
+ *  -length : Length of line.
+ *  -structurals : Offsets of all structural characters of line, relative
+ *          to its beginning, in ascending order.
+ *  -structc : Number of entries in structurals.
+ *  -commands : Same as in parse_line().
+ *  -commandc : Same as in parse_line().
+ *
+ * Returns:
+ *  Same as parse_line().
+ */
+int parse_line_indexed(char *line, size_t length, const uint32_t *structurals,
+                       size_t structc, command_t ***commands, int *commandc);
+
 #endif
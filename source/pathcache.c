@@ -0,0 +1,213 @@
+/**
+ * pathcache.c
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This file provides an implementation for routines declared in pathcache.h
+ * header.
+ *
+ * Version: 0.1
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "pathcache.h"
+
+
+int pathcache_sync_env();
+int pathcache_find(const char *name, uint64_t hash);
+void pathcache_insert(const char *name, const char *path, int64_t mtime_ns);
+void pathcache_clear();
+uint64_t pathcache_hash(const char *name);
+
+
+path_entry_t *pathcache_entries = NULL;  // Cached entries.
+int pathcache_entryc = 0;                // Number of cached entries.
+int pathcache_capacity = 0;              // Allocated size of entries.
+int *pathcache_slots = NULL;  // Hash table of entry indices, -1 if empty.
+size_t pathcache_slotc = 0;   // Size of hash table, a power of 2.
+char *pathcache_env = NULL;   // PATH that cached entries were resolved with.
+int pathcache_usable = 0;     // Whether that PATH can be cached.
+
+
+const char *pathcache_lookup(const char *name)
+{
+    if (!*name || strchr(name, '/') || !pathcache_sync_env()) return NULL;
+
+    int i = pathcache_find(name, pathcache_hash(name));
+    if (i >= 0) return pathcache_entries[i].path;
+
+    // Resolve it the way execvp() does.
+    size_t name_length = strlen(name);
+    const char *dir = pathcache_env;
+    while (1) {
+        size_t dir_length = strcspn(dir, ":");
+        char *path = (char *) malloc(dir_length + name_length + 2);
+        assert(path);
+        memcpy(path, dir, dir_length);
+        path[dir_length] = '/';
+        memcpy(path + dir_length + 1, name, name_length + 1);
+
+        struct stat st;
+        if (!stat(path, &st) && S_ISREG(st.st_mode) && !access(path, X_OK)) {
+            pathcache_insert(name, path, st.st_mtim.tv_sec * 1000000000LL +
+                                         st.st_mtim.tv_nsec);
+            free(path);
+            return pathcache_entries[pathcache_entryc-1].path;
+        }
+        free(path);
+
+        if (!dir[dir_length]) break;
+        dir += dir_length + 1;
+    }
+
+    return NULL;
+}
+
+void pathcache_add(const char *name, const char *path, int64_t mtime_ns)
+{
+    if (!*name || strchr(name, '/') || !pathcache_sync_env()) return;
+    if (pathcache_find(name, pathcache_hash(name)) >= 0) return;
+
+    pathcache_insert(name, path, mtime_ns);
+}
+
+int pathcache_get_entries(const path_entry_t **entries)
+{
+    pathcache_sync_env();
+    *entries = pathcache_entries;
+    return pathcache_entryc;
+}
+
+/**
+ * Drops all cached entries if PATH changed since they were resolved.
+ *
+ * Returns:
+ *  1 if current PATH can be cached, else 0.
+ */
+int pathcache_sync_env()
+{
+    const char *env = getenv("PATH");
+
+    if (pathcache_env && env && !strcmp(env, pathcache_env))
+        return pathcache_usable;
+
+    pathcache_clear();
+    free(pathcache_env);
+    pathcache_env = NULL;
+    pathcache_usable = 0;
+
+    // Without PATH, execvp() searches a default one.
+    if (!env) return 0;
+
+    pathcache_env = strdup(env);
+    assert(pathcache_env);
+
+    // Empty and relative directories depend on the working directory.
+    pathcache_usable = 1;
+    for (const char *dir = env; ; dir += strcspn(dir, ":") + 1) {
+        if (*dir != '/') pathcache_usable = 0;
+        if (!dir[strcspn(dir, ":")]) break;
+    }
+
+    return pathcache_usable;
+}
+
+/**
+ * Returns the index of the entry of a name in entries, or -1 if missing.
+ */
+int pathcache_find(const char *name, uint64_t hash)
+{
+    if (!pathcache_slotc) return -1;
+
+    for (size_t slot = hash & (pathcache_slotc - 1); ;
+         slot = (slot + 1) & (pathcache_slotc - 1)) {
+        int i = pathcache_slots[slot];
+        if (i < 0) return -1;
+        if (!strcmp(pathcache_entries[i].name, name)) return i;
+    }
+}
+
+/**
+ * Appends an entry, for a name not cached yet, growing the hash table so
+ * that it never gets more than half full.
+ */
+void pathcache_insert(const char *name, const char *path, int64_t mtime_ns)
+{
+    if (pathcache_entryc == pathcache_capacity) {
+        pathcache_capacity = pathcache_capacity ? pathcache_capacity * 2 : 64;
+        pathcache_entries = (path_entry_t *) realloc(
+            pathcache_entries, sizeof(path_entry_t) * pathcache_capacity);
+        assert(pathcache_entries);
+    }
+
+    path_entry_t *entry = &pathcache_entries[pathcache_entryc++];
+    entry->name = strdup(name);
+    entry->path = strdup(path);
+    entry->mtime_ns = mtime_ns;
+    assert(entry->name && entry->path);
+
+    if ((size_t) pathcache_entryc * 2 > pathcache_slotc) {
+        // Rehash all entries into a table twice as large.
+        free(pathcache_slots);
+        pathcache_slotc = pathcache_slotc ? pathcache_slotc * 2 : 128;
+        pathcache_slots = (int *) malloc(sizeof(int) * pathcache_slotc);
+        assert(pathcache_slots);
+        memset(pathcache_slots, -1, sizeof(int) * pathcache_slotc);
+
+        for (int i = 0; i < pathcache_entryc; i++) {
+            size_t slot = pathcache_hash(pathcache_entries[i].name) &
+                          (pathcache_slotc - 1);
+            while (pathcache_slots[slot] >= 0)
+                slot = (slot + 1) & (pathcache_slotc - 1);
+            pathcache_slots[slot] = i;
+        }
+        return;
+    }
+
+    size_t slot = pathcache_hash(name) & (pathcache_slotc - 1);
+    while (pathcache_slots[slot] >= 0)
+        slot = (slot + 1) & (pathcache_slotc - 1);
+    pathcache_slots[slot] = pathcache_entryc - 1;
+}
+
+/**
+ * Drops all cached entries.
+ */
+void pathcache_clear()
+{
+    for (int i = 0; i < pathcache_entryc; i++) {
+        free(pathcache_entries[i].name);
+        free(pathcache_entries[i].path);
+    }
+    pathcache_entryc = 0;
+
+    if (pathcache_slotc)
+        memset(pathcache_slots, -1, sizeof(int) * pathcache_slotc);
+}
+
+/**
+ * Computes the FNV-1a hash of a name.
+ */
+uint64_t pathcache_hash(const char *name)
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (const unsigned char *c = (const unsigned char *) name; *c; c++) {
+        hash ^= *c;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
@@ -0,0 +1,83 @@
+/**
+ * pathcache.h
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This header provides a cache of the paths that command names resolve to
+ * through PATH, like the hash table of bash, so binaries run many times are
+ * executed straight from their path, instead of trying every directory of
+ * PATH in turn on each exec.
+ *
+ * Names are resolved once, by the shell itself, and remembered until PATH
+ * changes. A binary removed since then is still found by the fallback to
+ * a full PATH search when executing it. Names containing a '/' are never
+ * cached, and neither is anything while PATH contains relative
+ * directories, since what they resolve to depends on the working
+ * directory.
+ *
+ * Types defined in pathcache.h:
+ *  -path_entry_t
+ *
+ * Functions defined in pathcache.h:
+ *  -const char *pathcache_lookup(const char *name)
+ *  -void pathcache_add(const char *name, const char *path, int64_t mtime_ns)
+ *  -int pathcache_get_entries(const path_entry_t **entries)
+ *
+ * Version: 0.1
+ */
+
+#ifndef __pathcache_h__
+#define __pathcache_h__
+
+#include <stdint.h>
+
+
+typedef struct {
+    char *name;        // Name of command.
+    char *path;        // Path of binary it resolves to.
+    int64_t mtime_ns;  // Modification time of binary when resolved.
+} path_entry_t;
+
+
+/**
+ * Returns the path a command name resolves to through PATH, resolving it
+ * if it is not cached.
+ *
+ * Parameters:
+ *  -name : Name of command.
+ *
+ * Returns:
+ *  The path of the binary, owned by the cache, or NULL if it cannot be
+ *  cached or no executable file is found.
+ */
+const char *pathcache_lookup(const char *name);
+
+/**
+ * Adds to cache a path resolved earlier, e.g. by a previous run of the
+ * shell. It should have been resolved through the current PATH.
+ *
+ * Parameters:
+ *  -name : Name of command.
+ *  -path : Path of binary it resolves to.
+ *  -mtime_ns : Modification time of binary.
+ */
+void pathcache_add(const char *name, const char *path, int64_t mtime_ns);
+
+/**
+ * Returns all cached entries, resolved through the current PATH.
+ *
+ * Parameters:
+ *  -entries : A reference where the array of entries, owned by the cache,
+ *          is stored.
+ *
+ * Returns:
+ *  The number of entries.
+ */
+int pathcache_get_entries(const path_entry_t **entries);
+
+#endif
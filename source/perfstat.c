@@ -0,0 +1,283 @@
+/**
+ * perfstat.c
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This file provides an implementation for routines declared in perfstat.h
+ * header.
+ *
+ * Version: 0.1
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "engine.h"
+#include "stats.h"
+#include "output.h"
+#include "perfstat.h"
+
+
+// Indices of events reported in relation to others.
+#define PERFSTAT_TASK_CLOCK 0
+#define PERFSTAT_CYCLES 4
+#define PERFSTAT_INSTRUCTIONS 5
+
+
+int perfstat_open_event(int event);
+void perfstat_print_totals();
+
+
+// Events counted, in the order of perfstat_event_names.
+struct {
+    uint32_t type;
+    uint64_t config;
+} perfstat_events[PERFSTAT_EVENTS] = {
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES}
+};
+
+const char *perfstat_event_names[] = {
+    "task-clock",
+    "context-switches",
+    "cpu-migrations",
+    "page-faults",
+    "cycles",
+    "instructions",
+    "cache-misses",
+    NULL
+};
+
+int perfstat_enabled = 0;
+int perfstat_unsupported[PERFSTAT_EVENTS];  // Events kernel refused to open.
+int perfstat_user_only = 0;  // Whether kernel-level counting is refused.
+int perfstat_warned = 0;     // Whether unavailable counters were reported.
+pid_t perfstat_owner = 0;    // Process printing totals at exit.
+
+
+int perfstat_open(perfstat_t *counters)
+{
+    int opened = 0;
+
+    for (int i = 0; i < PERFSTAT_EVENTS; i++) {
+        counters->fds[i] = -1;
+        if (perfstat_unsupported[i]) continue;
+
+        int fd = perfstat_open_event(i);
+
+        // Unprivileged processes may be allowed to count only user-level
+        // events, so all of them are opened again that way.
+        if (fd < 0 && (errno == EACCES || errno == EPERM) &&
+            !perfstat_user_only) {
+            perfstat_user_only = 1;
+            for (int j = 0; j < i; j++)
+                if (counters->fds[j] >= 0) close(counters->fds[j]);
+            opened = 0;
+            i = -1;
+            continue;
+        }
+
+        if (fd < 0) {
+            // Events the kernel cannot count are not tried for every binary.
+            if (errno != EMFILE && errno != ENFILE && errno != ENOMEM &&
+                errno != EINTR) {
+                perfstat_unsupported[i] = errno;
+            }
+            continue;
+        }
+
+        counters->fds[i] = fd;
+        opened++;
+    }
+
+    if (!opened) {
+        if (!perfstat_warned) {
+            output_stderr("perfstat: Performance counters are not "
+                          "available: %s\n",
+                          strerror(perfstat_unsupported[PERFSTAT_TASK_CLOCK] ?
+                                   perfstat_unsupported[PERFSTAT_TASK_CLOCK] :
+                                   errno));
+            perfstat_warned = 1;
+        }
+        return -1;
+    }
+
+    return 0;
+}
+
+void perfstat_close(perfstat_t *counters, const char *name)
+{
+    unsigned long long values[PERFSTAT_EVENTS] = {0};
+    unsigned long long counted[PERFSTAT_EVENTS] = {0};
+
+    for (int i = 0; i < PERFSTAT_EVENTS; i++) {
+        if (counters->fds[i] < 0) continue;
+
+        // Count, followed by the time it was enabled and actually running.
+        uint64_t data[3];
+        if (read(counters->fds[i], data, sizeof(data)) == sizeof(data) &&
+            data[2]) {
+            values[i] = data[0];
+            // Events multiplexed on a busy PMU are scaled to the whole run.
+            if (data[2] < data[1])
+                values[i] = (double) data[0] * data[1] / data[2];
+            counted[i] = 1;
+        }
+        close(counters->fds[i]);
+    }
+
+    if (!name) return;
+
+    shell_stats.perf_commands++;
+    for (int i = 0; i < PERFSTAT_EVENTS; i++) {
+        shell_stats.perf_values[i] += values[i];
+        shell_stats.perf_counted[i] += counted[i];
+    }
+
+    output_stderr("Performance counters of '%s':\n", name);
+    perfstat_print(STDERR_FILENO, values, counted, 1);
+}
+
+void perfstat_print(int fd, const unsigned long long *values,
+                    const unsigned long long *counted,
+                    unsigned long long commands)
+{
+    for (int i = 0; i < PERFSTAT_EVENTS; i++) {
+        char value[32];
+        if (!counted[i]) {
+            snprintf(value, sizeof(value), perfstat_unsupported[i] ?
+                     "<not supported>" : "<not counted>");
+        }
+        else if (i == PERFSTAT_TASK_CLOCK)
+            snprintf(value, sizeof(value), "%.3f ms", values[i] / 1e6);
+        else
+            snprintf(value, sizeof(value), "%llu", values[i]);
+
+        output_printf(fd, "  %18s  %s", value, perfstat_event_names[i]);
+
+        if (i == PERFSTAT_INSTRUCTIONS && counted[i] &&
+            counted[PERFSTAT_CYCLES] && values[PERFSTAT_CYCLES]) {
+            output_printf(fd, "  # %.2f per cycle",
+                          (double) values[i] / values[PERFSTAT_CYCLES]);
+        }
+        if (counted[i] && counted[i] < commands) {
+            output_printf(fd, "  (%llu of %llu commands)",
+                          counted[i], commands);
+        }
+        output_printf(fd, "\n");
+    }
+}
+
+void perfstat_report_at_exit()
+{
+    int hook = !perfstat_owner;
+
+    perfstat_enabled = 1;
+    perfstat_owner = getpid();
+
+    if (hook) atexit(perfstat_print_totals);
+}
+
+int run_perfstat(command_t *command)
+{
+    char **args = command_get_args(command);
+    int argc = command_get_args_num(command);
+
+    if (argc == 0) {
+        output_stderr("Usage: perfstat command [args...]\n"
+                      "       perfstat on|off\n");
+        return -1;
+    }
+
+    if (argc == 1 && !strcmp(args[0], "on")) {
+        perfstat_enabled = 1;
+        return 0;
+    }
+    if (argc == 1 && !strcmp(args[0], "off")) {
+        perfstat_enabled = 0;
+        output_stderr("Performance counters of %llu commands:\n",
+                      shell_stats.perf_commands);
+        perfstat_print(STDERR_FILENO, shell_stats.perf_values,
+                       shell_stats.perf_counted, shell_stats.perf_commands);
+        return 0;
+    }
+
+    // Count just this binary.
+    int enabled = perfstat_enabled;
+    perfstat_enabled = 1;
+
+    char **argv = (char **) malloc(sizeof(char *) * (argc + 1));
+    assert(argv);
+    memcpy(argv, args, sizeof(char *) * argc);
+    argv[argc] = NULL;
+    int status = exec_argv(argv, &engine_default_timeout);
+    free(argv);
+
+    perfstat_enabled = enabled;
+
+    return status;
+}
+
+/**
+ * Opens the counter of an event for the children the shell forks next.
+ * Counter stays disabled in the shell and gets enabled in a child when it
+ * execs.
+ *
+ * Returns:
+ *  The descriptor of the counter, or -1 with errno set on failure.
+ */
+int perfstat_open_event(int event)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+
+    attr.size = sizeof(attr);
+    attr.type = perfstat_events[event].type;
+    attr.config = perfstat_events[event].config;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.enable_on_exec = 1;
+    attr.exclude_kernel = perfstat_user_only;
+    attr.exclude_hv = perfstat_user_only;
+
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1,
+                   PERF_FLAG_FD_CLOEXEC);
+}
+
+/**
+ * Prints the totals of all binaries counted, when shell exits.
+ */
+void perfstat_print_totals()
+{
+    // Forked workers inherit the exit handlers of the shell, but their
+    // counts are added to the ones of the shell.
+    if (getpid() != perfstat_owner) return;
+
+    output_stderr("Performance counters of %llu commands:\n",
+                  shell_stats.perf_commands);
+    perfstat_print(STDERR_FILENO, shell_stats.perf_values,
+                   shell_stats.perf_counted, shell_stats.perf_commands);
+
+    // Flush handler of output may have run already.
+    output_flush();
+}
@@ -0,0 +1,141 @@
+/**
+ * perfstat.h
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This header provides 'perfstat' built-in command, which counts what the
+ * binaries spawned by the shell do on the CPU, like 'perf stat' does, so
+ * it is told why a command is slow and not only that it is.
+ *
+ * Counters are opened through perf_event_open() right before a binary is
+ * forked, inherited by it and by every process it spawns, and enabled only
+ * once it execs, so the shell itself is never counted. They are read after
+ * the binary has been waited for, when the counts of all its processes have
+ * been added up, and reported for it on stderr. Counts are also added to
+ * shell_stats, where they add up to totals of the whole script.
+ *
+ * Software events (task-clock, context switches, CPU migrations and page
+ * faults) are counted by the kernel, and any process may count them for
+ * the processes it spawns. Hardware events (cycles, instructions and cache
+ * misses) need a PMU, which virtual machines often lack, so any of them that
+ * cannot be opened is reported as not supported and the rest are counted
+ * anyway. When kernel-level events are not permitted, only user-level ones
+ * are counted.
+ *
+ * Constants defined in perfstat.h:
+ *  -PERFSTAT_EVENTS
+ *
+ * Types defined in perfstat.h:
+ *  -perfstat_t
+ *
+ * Variables declared in perfstat.h:
+ *  -int perfstat_enabled
+ *  -const char *perfstat_event_names[]
+ *
+ * Functions defined in perfstat.h:
+ *  -int perfstat_open(perfstat_t *counters)
+ *  -void perfstat_close(perfstat_t *counters, const char *name)
+ *  -void perfstat_print(int fd, const unsigned long long *values,
+ *                       const unsigned long long *counted,
+ *                       unsigned long long commands)
+ *  -void perfstat_report_at_exit()
+ *  -int run_perfstat(command_t *command)
+ *
+ * Version: 0.1
+ */
+
+#ifndef __perfstat_h__
+#define __perfstat_h__
+
+#include "command.h"
+
+
+// Number of events counted, named by perfstat_event_names.
+#define PERFSTAT_EVENTS 7
+
+
+// Counters of a binary being run.
+typedef struct {
+    int fds[PERFSTAT_EVENTS];  // Counter of each event, -1 if not counted.
+} perfstat_t;
+
+
+/**
+ * Whether every binary spawned by the shell is counted.
+ */
+extern int perfstat_enabled;
+
+/**
+ * Names of the counted events, as named by 'perf stat'. Task-clock is
+ * counted in nanoseconds.
+ */
+extern const char *perfstat_event_names[];
+
+
+/**
+ * Opens counters that will count the next process forked by the shell,
+ * from the moment it execs a binary.
+ *
+ * Parameters:
+ *  -counters : Where the counters are stored.
+ *
+ * Returns:
+ *  0 if any event can be counted, else -1, after describing why on stderr
+ *  (only the first time).
+ */
+int perfstat_open(perfstat_t *counters);
+
+/**
+ * Reads the counters of a binary that has been waited for, reports them on
+ * stderr and adds them to shell_stats. Counters are then closed.
+ *
+ * Parameters:
+ *  -counters : Counters opened by perfstat_open().
+ *  -name : Name of the binary, or NULL to discard the counts, e.g. of a
+ *          binary that could not be executed.
+ */
+void perfstat_close(perfstat_t *counters, const char *name);
+
+/**
+ * Prints counted events, either of a single binary or totals of many, one
+ * per line.
+ *
+ * Parameters:
+ *  -fd : Either STDOUT_FILENO or STDERR_FILENO.
+ *  -values : Count of each event.
+ *  -counted : Number of binaries each event was counted for.
+ *  -commands : Number of binaries counted.
+ */
+void perfstat_print(int fd, const unsigned long long *values,
+                    const unsigned long long *counted,
+                    unsigned long long commands);
+
+/**
+ * Makes the shell count every binary it spawns, and print the totals of
+ * all of them on stderr when it exits.
+ */
+void perfstat_report_at_exit();
+
+/**
+ * Implements 'perfstat' built-in command, invoked as:
+ *  perfstat <command> [args...]
+ *  perfstat on|off
+ *
+ * The first form runs a binary with its counters. 'on' counts every binary
+ * spawned afterwards, until 'off', which prints the totals counted so far.
+ *
+ * Parameters:
+ *  -command : The 'perfstat' command.
+ *
+ * Returns:
+ *  The status of the binary, as exec_binary() returns it, 0 for 'on' and
+ *  'off', or -1 on wrong usage.
+ */
+int run_perfstat(command_t *command);
+
+#endif
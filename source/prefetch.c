@@ -0,0 +1,697 @@
+/**
+ * prefetch.c
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This file provides an implementation for routines declared in prefetch.h
+ * header.
+ *
+ * Version: 0.1
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <limits.h>
+#include <link.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "engine.h"
+#include "output.h"
+#include "prefetch.h"
+
+
+// Maximum depth of interpreters and libraries followed from a binary.
+#define PREFETCH_MAX_DEPTH 8
+
+// Dynamic loader searches these after the directories of ld.so.conf.
+#define DEFAULT_LIBRARY_PATH "/lib64:/usr/lib64:/lib:/usr/lib"
+
+
+// A set of strings, kept in an open addressing hash table.
+typedef struct {
+    char **slots;
+    size_t capacity;  // Always a power of 2.
+    size_t count;
+} string_set_t;
+
+
+void scan_line(const char *line, size_t length);
+void queue_name(const char *name, size_t length);
+void *prefetch_worker(void *arg);
+char *resolve_command(const char *name);
+void prefetch_file(const char *path, int depth);
+void follow_elf(int fd, const char *path, int depth);
+char *read_string_at(int fd, off_t offset, size_t max_length);
+char *resolve_library(const char *name, const char *search_path,
+                      const char *origin, int machine);
+char *search_library(const char *dirs, const char *name, const char *origin,
+                     int machine);
+int library_matches(const char *path, int machine);
+void load_library_path();
+void parse_ld_conf(const char *path, int depth);
+void append_library_dir(const char *dir);
+int string_set_add(string_set_t *set, const char *str);
+void prefetch_before_fork();
+void prefetch_after_fork_parent();
+void prefetch_after_fork_child();
+
+
+const char *prefetch_text = NULL;  // Script whose lines are scanned.
+size_t prefetch_size = 0;
+size_t prefetch_end = 0;   // Offset where the first line not scanned starts.
+string_set_t prefetch_names = { NULL, 0, 0 };  // Names ever queued.
+
+pthread_mutex_t prefetch_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t prefetch_queued = PTHREAD_COND_INITIALIZER;
+char **prefetch_queue = NULL;  // Names waiting for the worker thread.
+int prefetch_queue_head = 0;
+int prefetch_queue_count = 0;
+int prefetch_queue_capacity = 0;
+int prefetch_started = 0;      // Whether worker thread is running.
+int prefetch_hooked = 0;       // Whether fork handlers are registered.
+
+// Used only by the worker thread.
+string_set_t prefetched_files = { NULL, 0, 0 };
+char *system_library_path = NULL;  // Directories searched for libraries.
+size_t system_library_path_length = 0;
+
+
+void prefetch_ahead(const char *text, size_t size, size_t offset)
+{
+    if (text != prefetch_text || size != prefetch_size ||
+        prefetch_end < offset) {
+        prefetch_text = text;
+        prefetch_size = size;
+        prefetch_end = offset;
+    }
+
+    // Count lines already scanned ahead of the executing one.
+    int lines = 0;
+    const char *p = text + offset;
+    const char *scanned = text + prefetch_end;
+    while (p < scanned && (p = memchr(p, '\n', scanned - p)) != NULL) {
+        p++;
+        lines++;
+    }
+
+    while (lines < PREFETCH_LOOKAHEAD && prefetch_end < size) {
+        const char *line = text + prefetch_end;
+        const char *newline = memchr(line, '\n', size - prefetch_end);
+        size_t length = newline ? (size_t) (newline - line) :
+                                  size - prefetch_end;
+
+        scan_line(line, length);
+        prefetch_end += length + (newline ? 1 : 0);
+        lines++;
+    }
+}
+
+/**
+ * Queues the names of binaries invoked by a line, i.e. the first word of
+ * each command in it.
+ */
+void scan_line(const char *line, size_t length)
+{
+    const char *separators = " \t\r;&|(){}<>";
+    int command_start = 1;
+    size_t i = 0;
+
+    while (i < length) {
+        char c = line[i];
+        if (c == ' ' || c == '\t' || c == '\r') {
+            i++;
+            continue;
+        }
+        if (c && strchr(separators + 3, c)) {
+            command_start = 1;
+            i++;
+            continue;
+        }
+
+        size_t start = i;
+        while (i < length && line[i] && !strchr(separators, line[i])) i++;
+        if (command_start) queue_name(line + start, i - start);
+        command_start = 0;
+
+        if (i < length && !line[i]) i++;
+    }
+}
+
+/**
+ * Queues a name for the worker thread, unless it has been queued before or
+ * is not the name of a binary.
+ */
+void queue_name(const char *name, size_t length)
+{
+    char buffer[PATH_MAX];
+    if (length == 0 || length >= sizeof(buffer)) return;
+    memcpy(buffer, name, length);
+    buffer[length] = '\0';
+
+    // Words that are expanded, quoted or assignments are left alone.
+    if (strpbrk(buffer, "\"'$=*?[")) return;
+    for (int i = 0; engine_builtins[i]; i++) {
+        if (!strcmp(engine_builtins[i], buffer)) return;
+    }
+    if (!string_set_add(&prefetch_names, buffer)) return;
+
+    char *queued = strdup(buffer);
+    assert(queued);
+
+    if (!prefetch_hooked) {
+        pthread_atfork(prefetch_before_fork, prefetch_after_fork_parent,
+                       prefetch_after_fork_child);
+        prefetch_hooked = 1;
+    }
+
+    pthread_mutex_lock(&prefetch_lock);
+
+    if (prefetch_queue_count == prefetch_queue_capacity) {
+        if (prefetch_queue_head > 0) {
+            memmove(prefetch_queue, prefetch_queue + prefetch_queue_head,
+                    sizeof(char *) *
+                    (prefetch_queue_count - prefetch_queue_head));
+            prefetch_queue_count -= prefetch_queue_head;
+            prefetch_queue_head = 0;
+        }
+        else {
+            prefetch_queue_capacity = prefetch_queue_capacity ?
+                                      prefetch_queue_capacity * 2 : 64;
+            prefetch_queue = (char **) realloc(
+                prefetch_queue, sizeof(char *) * prefetch_queue_capacity);
+            assert(prefetch_queue);
+        }
+    }
+    prefetch_queue[prefetch_queue_count++] = queued;
+
+    if (!prefetch_started) {
+        pthread_t thread;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (!pthread_create(&thread, &attr, prefetch_worker, NULL))
+            prefetch_started = 1;
+        pthread_attr_destroy(&attr);
+    }
+
+    pthread_cond_signal(&prefetch_queued);
+    pthread_mutex_unlock(&prefetch_lock);
+}
+
+/**
+ * Body of the worker thread, which resolves queued names in the order they
+ * were queued and prefetches their files.
+ */
+void *prefetch_worker(void *arg)
+{
+    (void) arg;
+
+    while (1) {
+        pthread_mutex_lock(&prefetch_lock);
+        while (prefetch_queue_head == prefetch_queue_count)
+            pthread_cond_wait(&prefetch_queued, &prefetch_lock);
+        char *name = prefetch_queue[prefetch_queue_head++];
+        if (prefetch_queue_head == prefetch_queue_count)
+            prefetch_queue_head = prefetch_queue_count = 0;
+        pthread_mutex_unlock(&prefetch_lock);
+
+        char *path = resolve_command(name);
+        if (path) {
+            prefetch_file(path, 0);
+            free(path);
+        }
+        free(name);
+    }
+
+    return NULL;
+}
+
+/**
+ * Finds the file a command name refers to, the way execvp() does.
+ *
+ * Returns:
+ *  A newly allocated path, or NULL if not found.
+ */
+char *resolve_command(const char *name)
+{
+    if (strchr(name, '/')) {
+        char *path = strdup(name);
+        assert(path);
+        return path;
+    }
+
+    const char *path_env = getenv("PATH");
+    if (!path_env) return NULL;
+
+    for (const char *dir = path_env; ; ) {
+        size_t length = strcspn(dir, ":");
+        char *path;
+        if (asprintf(&path, "%.*s/%s", length ? (int) length : 1,
+                     length ? dir : ".", name) >= 0) {
+            struct stat st;
+            if (!stat(path, &st) && S_ISREG(st.st_mode) && !access(path, X_OK))
+                return path;
+            free(path);
+        }
+        if (!dir[length]) break;
+        dir += length + 1;
+    }
+
+    return NULL;
+}
+
+/**
+ * Asks kernel to read a file ahead and follows it to the interpreter and
+ * the libraries it needs.
+ */
+void prefetch_file(const char *path, int depth)
+{
+    if (depth > PREFETCH_MAX_DEPTH) return;
+    if (!string_set_add(&prefetched_files, path)) return;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+
+    struct stat st;
+    if (fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return;
+    }
+
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+
+    char header[256];
+    ssize_t n = pread(fd, header, sizeof(header) - 1, 0);
+    if (n >= 2 && header[0] == '#' && header[1] == '!') {
+        header[n] = '\0';
+        char *interpreter = header + 2;
+        interpreter += strspn(interpreter, " \t");
+        interpreter[strcspn(interpreter, " \t\r\n")] = '\0';
+        if (interpreter[0]) prefetch_file(interpreter, depth + 1);
+    }
+    else if (n >= SELFMAG && !memcmp(header, ELFMAG, SELFMAG)) {
+        follow_elf(fd, path, depth);
+    }
+
+    close(fd);
+}
+
+/**
+ * Prefetches the interpreter and the needed libraries of an ELF file of
+ * the native class.
+ */
+void follow_elf(int fd, const char *path, int depth)
+{
+    ElfW(Ehdr) ehdr;
+    if (pread(fd, &ehdr, sizeof(ehdr), 0) != sizeof(ehdr) ||
+        ehdr.e_ident[EI_CLASS] != (__ELF_NATIVE_CLASS == 64 ? ELFCLASS64 :
+                                                              ELFCLASS32) ||
+        ehdr.e_phentsize != sizeof(ElfW(Phdr)) ||
+        ehdr.e_phnum == 0 || ehdr.e_phnum > 256) {
+        return;
+    }
+
+    size_t phdrs_size = sizeof(ElfW(Phdr)) * ehdr.e_phnum;
+    ElfW(Phdr) *phdrs = (ElfW(Phdr) *) malloc(phdrs_size);
+    assert(phdrs);
+    if (pread(fd, phdrs, phdrs_size, ehdr.e_phoff) != (ssize_t) phdrs_size) {
+        free(phdrs);
+        return;
+    }
+
+    ElfW(Phdr) *dynamic = NULL;
+    for (int i = 0; i < ehdr.e_phnum; i++) {
+        if (phdrs[i].p_type == PT_INTERP) {
+            char *interpreter = read_string_at(fd, phdrs[i].p_offset,
+                                               phdrs[i].p_filesz);
+            if (interpreter) {
+                prefetch_file(interpreter, depth + 1);
+                free(interpreter);
+            }
+        }
+        else if (phdrs[i].p_type == PT_DYNAMIC) dynamic = &phdrs[i];
+    }
+
+    size_t dync = dynamic ? dynamic->p_filesz / sizeof(ElfW(Dyn)) : 0;
+    if (dync == 0 || dync > 4096) {
+        free(phdrs);
+        return;
+    }
+
+    ElfW(Dyn) *dyns = (ElfW(Dyn) *) malloc(sizeof(ElfW(Dyn)) * dync);
+    assert(dyns);
+    if (pread(fd, dyns, sizeof(ElfW(Dyn)) * dync, dynamic->p_offset) !=
+        (ssize_t) (sizeof(ElfW(Dyn)) * dync)) {
+        dync = 0;
+    }
+
+    // String table is given by its address, found in a loaded segment.
+    ElfW(Addr) strtab = 0;
+    size_t strsz = 0;
+    for (size_t i = 0; i < dync && dyns[i].d_tag != DT_NULL; i++) {
+        if (dyns[i].d_tag == DT_STRTAB) strtab = dyns[i].d_un.d_ptr;
+        else if (dyns[i].d_tag == DT_STRSZ) strsz = dyns[i].d_un.d_val;
+    }
+    off_t strtab_offset = -1;
+    for (int i = 0; i < ehdr.e_phnum && strtab; i++) {
+        if (phdrs[i].p_type == PT_LOAD && phdrs[i].p_vaddr <= strtab &&
+            strtab < phdrs[i].p_vaddr + phdrs[i].p_filesz) {
+            strtab_offset = strtab - phdrs[i].p_vaddr + phdrs[i].p_offset;
+            break;
+        }
+    }
+
+    char *strings = NULL;
+    if (strtab_offset >= 0 && strsz > 0 && strsz <= (1 << 20)) {
+        strings = (char *) malloc(strsz + 1);
+        assert(strings);
+        if (pread(fd, strings, strsz, strtab_offset) != (ssize_t) strsz) {
+            free(strings);
+            strings = NULL;
+        }
+        else strings[strsz] = '\0';
+    }
+
+    if (strings) {
+        // RUNPATH overrides RPATH, and $ORIGIN is the directory of file.
+        const char *search_path = NULL;
+        for (size_t i = 0; i < dync && dyns[i].d_tag != DT_NULL; i++) {
+            if ((dyns[i].d_tag == DT_RUNPATH ||
+                 (dyns[i].d_tag == DT_RPATH && !search_path)) &&
+                dyns[i].d_un.d_val < strsz) {
+                search_path = strings + dyns[i].d_un.d_val;
+            }
+        }
+        char *origin = strdup(path);
+        assert(origin);
+        char *slash = strrchr(origin, '/');
+        if (slash) *slash = '\0';
+        else strcpy(origin, ".");
+
+        for (size_t i = 0; i < dync && dyns[i].d_tag != DT_NULL; i++) {
+            if (dyns[i].d_tag != DT_NEEDED || dyns[i].d_un.d_val >= strsz)
+                continue;
+            char *library = resolve_library(strings + dyns[i].d_un.d_val,
+                                            search_path, origin,
+                                            ehdr.e_machine);
+            if (library) {
+                prefetch_file(library, depth + 1);
+                free(library);
+            }
+        }
+
+        free(origin);
+        free(strings);
+    }
+
+    free(dyns);
+    free(phdrs);
+}
+
+/**
+ * Reads a NULL terminated string out of a file.
+ *
+ * Returns:
+ *  A newly allocated string, or NULL on failure.
+ */
+char *read_string_at(int fd, off_t offset, size_t max_length)
+{
+    if (max_length == 0 || max_length > PATH_MAX) return NULL;
+
+    char *str = (char *) malloc(max_length + 1);
+    assert(str);
+    ssize_t n = pread(fd, str, max_length, offset);
+    if (n <= 0) {
+        free(str);
+        return NULL;
+    }
+    str[n] = '\0';
+
+    return str;
+}
+
+/**
+ * Finds a shared library the way the dynamic loader does.
+ *
+ * Parameters:
+ *  -name : Name of library, as found in DT_NEEDED.
+ *  -search_path : RUNPATH or RPATH of the binary needing it, or NULL.
+ *  -origin : Directory of the binary needing it.
+ *  -machine : Architecture of the binary needing it.
+ *
+ * Returns:
+ *  A newly allocated path, or NULL if not found.
+ */
+char *resolve_library(const char *name, const char *search_path,
+                      const char *origin, int machine)
+{
+    if (strchr(name, '/')) {
+        char *path = strdup(name);
+        assert(path);
+        return path;
+    }
+
+    char *path = NULL;
+    if (search_path)
+        path = search_library(search_path, name, origin, machine);
+    if (!path && getenv("LD_LIBRARY_PATH"))
+        path = search_library(getenv("LD_LIBRARY_PATH"), name, origin, machine);
+    if (!path) {
+        if (!system_library_path) load_library_path();
+        path = search_library(system_library_path, name, origin, machine);
+    }
+
+    return path;
+}
+
+/**
+ * Searches a colon separated list of directories for a library of the
+ * given architecture.
+ *
+ * Returns:
+ *  A newly allocated path, or NULL if not found.
+ */
+char *search_library(const char *dirs, const char *name, const char *origin,
+                     int machine)
+{
+    for (const char *dir = dirs; ; ) {
+        size_t length = strcspn(dir, ":");
+        char *path = NULL;
+        int rc;
+
+        if (length >= 7 && !strncmp(dir, "$ORIGIN", 7)) {
+            rc = asprintf(&path, "%s%.*s/%s", origin, (int) length - 7,
+                          dir + 7, name);
+        }
+        else if (length >= 9 && !strncmp(dir, "${ORIGIN}", 9)) {
+            rc = asprintf(&path, "%s%.*s/%s", origin, (int) length - 9,
+                          dir + 9, name);
+        }
+        else {
+            rc = asprintf(&path, "%.*s/%s", length ? (int) length : 1,
+                          length ? dir : ".", name);
+        }
+        if (rc >= 0) {
+            if (library_matches(path, machine)) return path;
+            free(path);
+        }
+
+        if (!dir[length]) break;
+        dir += length + 1;
+    }
+
+    return NULL;
+}
+
+/**
+ * Checks whether a file is an ELF object for the given architecture, so
+ * that libraries of other architectures in the same search path are
+ * skipped, like the dynamic loader does.
+ */
+int library_matches(const char *path, int machine)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+
+    ElfW(Ehdr) ehdr;
+    int matches = pread(fd, &ehdr, sizeof(ehdr), 0) == sizeof(ehdr) &&
+                  !memcmp(ehdr.e_ident, ELFMAG, SELFMAG) &&
+                  ehdr.e_ident[EI_CLASS] == (__ELF_NATIVE_CLASS == 64 ?
+                                             ELFCLASS64 : ELFCLASS32) &&
+                  ehdr.e_machine == machine;
+    close(fd);
+
+    return matches;
+}
+
+/**
+ * Builds the list of directories searched for libraries, out of
+ * /etc/ld.so.conf and the default directories.
+ */
+void load_library_path()
+{
+    system_library_path = strdup("");
+    assert(system_library_path);
+    system_library_path_length = 0;
+
+    parse_ld_conf("/etc/ld.so.conf", 0);
+
+    char *defaults = strdup(DEFAULT_LIBRARY_PATH);
+    assert(defaults);
+    char *saveptr;
+    for (char *dir = strtok_r(defaults, ":", &saveptr); dir;
+         dir = strtok_r(NULL, ":", &saveptr)) {
+        append_library_dir(dir);
+    }
+    free(defaults);
+}
+
+/**
+ * Adds the directories listed in a configuration file of the dynamic
+ * loader, following its include directives.
+ */
+void parse_ld_conf(const char *path, int depth)
+{
+    if (depth > 8) return;
+
+    FILE *file = fopen(path, "re");
+    if (!file) return;
+
+    char *line = NULL;
+    size_t capacity = 0;
+    while (getline(&line, &capacity, file) > 0) {
+        line[strcspn(line, "#\n")] = '\0';
+        char *start = line + strspn(line, " \t");
+        char *end = start + strlen(start);
+        while (end > start && (end[-1] == ' ' || end[-1] == '\t'))
+            *--end = '\0';
+        if (!*start) continue;
+
+        if (!strncmp(start, "include", 7) &&
+            (start[7] == ' ' || start[7] == '\t')) {
+            char *pattern = start + 8 + strspn(start + 8, " \t");
+            char *absolute = NULL;
+            if (pattern[0] != '/' &&
+                asprintf(&absolute, "/etc/%s", pattern) < 0) {
+                continue;
+            }
+
+            glob_t matches;
+            if (!glob(absolute ? absolute : pattern, 0, NULL, &matches)) {
+                for (size_t i = 0; i < matches.gl_pathc; i++)
+                    parse_ld_conf(matches.gl_pathv[i], depth + 1);
+            }
+            globfree(&matches);
+            free(absolute);
+        }
+        else if (start[0] == '/') append_library_dir(start);
+    }
+
+    free(line);
+    fclose(file);
+}
+
+/**
+ * Appends a directory to the list of directories searched for libraries.
+ */
+void append_library_dir(const char *dir)
+{
+    size_t length = strlen(dir);
+    system_library_path = (char *) realloc(
+        system_library_path, system_library_path_length + length + 2);
+    assert(system_library_path);
+
+    if (system_library_path_length)
+        system_library_path[system_library_path_length++] = ':';
+    memcpy(system_library_path + system_library_path_length, dir, length + 1);
+    system_library_path_length += length;
+}
+
+/**
+ * Adds a copy of a string to a set.
+ *
+ * Returns:
+ *  1 if string was added, or 0 if it was already in the set.
+ */
+int string_set_add(string_set_t *set, const char *str)
+{
+    if ((set->count + 1) * 2 > set->capacity) {
+        size_t capacity = set->capacity ? set->capacity * 2 : 64;
+        char **slots = (char **) calloc(capacity, sizeof(char *));
+        assert(slots);
+
+        for (size_t i = 0; i < set->capacity; i++) {
+            if (!set->slots[i]) continue;
+            uint64_t hash = 14695981039346656037ULL;
+            for (const char *c = set->slots[i]; *c; c++)
+                hash = (hash ^ (unsigned char) *c) * 1099511628211ULL;
+            size_t j = hash & (capacity - 1);
+            while (slots[j]) j = (j + 1) & (capacity - 1);
+            slots[j] = set->slots[i];
+        }
+
+        free(set->slots);
+        set->slots = slots;
+        set->capacity = capacity;
+    }
+
+    uint64_t hash = 14695981039346656037ULL;  // FNV-1a.
+    for (const char *c = str; *c; c++)
+        hash = (hash ^ (unsigned char) *c) * 1099511628211ULL;
+
+    size_t i = hash & (set->capacity - 1);
+    while (set->slots[i]) {
+        if (!strcmp(set->slots[i], str)) return 0;
+        i = (i + 1) & (set->capacity - 1);
+    }
+
+    set->slots[i] = strdup(str);
+    assert(set->slots[i]);
+    set->count++;
+
+    return 1;
+}
+
+/**
+ * Keeps the queue consistent across fork(), by holding its lock.
+ */
+void prefetch_before_fork()
+{
+    pthread_mutex_lock(&prefetch_lock);
+}
+
+void prefetch_after_fork_parent()
+{
+    pthread_mutex_unlock(&prefetch_lock);
+}
+
+/**
+ * Worker thread does not exist in a child, so it is started again if
+ * needed. Files it was working on may be left half added, so they are
+ * forgotten.
+ */
+void prefetch_after_fork_child()
+{
+    pthread_mutex_init(&prefetch_lock, NULL);
+    pthread_cond_init(&prefetch_queued, NULL);
+    prefetch_started = 0;
+
+    prefetched_files.slots = NULL;
+    prefetched_files.capacity = 0;
+    prefetched_files.count = 0;
+    system_library_path = NULL;
+    system_library_path_length = 0;
+}
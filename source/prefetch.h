@@ -0,0 +1,58 @@
+/**
+ * prefetch.h
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This header provides prefetching of the binaries a script is about to
+ * execute, so that on a cold host their pages are read from disk while
+ * earlier lines are still running, instead of when they get exec()ed.
+ *
+ * Lines ahead of the one executing are scanned for the names of the
+ * binaries they invoke, which are resolved through PATH by a background
+ * thread. For each resolved file, kernel is asked to read it ahead with
+ * posix_fadvise(POSIX_FADV_WILLNEED). ELF binaries are followed to their
+ * interpreter and to the shared libraries they need (DT_NEEDED), which are
+ * searched like the dynamic loader does: in their RPATH or RUNPATH, in
+ * LD_LIBRARY_PATH, in directories of /etc/ld.so.conf and in default ones.
+ * Scripts are followed to the interpreter of their "#!" line.
+ *
+ * Every name and every file is prefetched once per session.
+ *
+ * Constants defined in prefetch.h:
+ *  -PREFETCH_LOOKAHEAD
+ *
+ * Functions defined in prefetch.h:
+ *  -void prefetch_ahead(const char *text, size_t size, size_t offset)
+ *
+ * Version: 0.1
+ */
+
+#ifndef __prefetch_h__
+#define __prefetch_h__
+
+#include <stddef.h>
+
+
+// Number of lines ahead of the executing one, whose binaries are prefetched.
+#define PREFETCH_LOOKAHEAD 32
+
+
+/**
+ * Prefetches the binaries invoked by the lines that follow an offset of a
+ * script, up to PREFETCH_LOOKAHEAD lines. Lines already scanned by a
+ * previous call are skipped, so it is meant to be called before executing
+ * each line. Never blocks on disk.
+ *
+ * Parameters:
+ *  -text : Contents of the script.
+ *  -size : Size of contents.
+ *  -offset : Offset where the line after the executing one starts.
+ */
+void prefetch_ahead(const char *text, size_t size, size_t offset);
+
+#endif
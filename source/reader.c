@@ -0,0 +1,389 @@
+/**
+ * reader.c
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This file provides an implementation for routines declared in reader.h
+ * header.
+ *
+ * Version: 0.1
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "editor.h"
+#include "output.h"
+#include "stats.h"
+#include "reader.h"
+
+
+#define READER_WINDOW (256 * 1024)  // Bytes of a script indexed at once.
+#define READER_CHUNK (256 * 1024)   // Bytes requested by each read of a
+                                    // buffered descriptor.
+#define READER_PROMPT_SIZE 1024     // Don't allocate for prompts larger than
+                                    // that. They are useless anyway.
+
+
+reader_t *reader_create();
+char *next_mapped_line(reader_t *reader);
+char *next_stream_line(reader_t *reader);
+char *next_buffered_line(reader_t *reader);
+void index_window(reader_t *reader, size_t start, size_t length);
+void store_line(reader_t *reader, const char *text, size_t length);
+
+
+reader_t *reader_create_from_file(const char *path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st)) {
+        close(fd);
+        return NULL;
+    }
+
+    reader_t *reader = reader_create();
+
+    if (S_ISREG(st.st_mode)) {
+        if (st.st_size > 0) {
+            reader->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (reader->map == MAP_FAILED) {
+                close(fd);
+                reader_destroy(reader);
+                return NULL;
+            }
+            madvise(reader->map, st.st_size, MADV_SEQUENTIAL);
+            reader->owns_map = 1;
+        }
+        reader->map_size = st.st_size;
+        close(fd);
+    }
+    else {
+        // Pipes and devices cannot be mapped, so read them in chunks.
+        reader_destroy(reader);
+        reader = reader_create_from_fd(fd);
+        reader->owns_fd = 1;
+    }
+
+    return reader;
+}
+
+reader_t *reader_create_from_stream(FILE *stream)
+{
+    reader_t *reader = reader_create();
+    reader->stream = stream;
+    return reader;
+}
+
+reader_t *reader_create_from_fd(int fd)
+{
+    reader_t *reader = reader_create();
+    reader->fd = fd;
+    reader->buffer_capacity = READER_CHUNK;
+    reader->buffer = (char *) malloc(reader->buffer_capacity);
+    assert(reader->buffer);
+    return reader;
+}
+
+reader_t *reader_create_from_string(const char *text)
+{
+    reader_t *reader = reader_create();
+    // Never written, since map is only read and copied into line buffer.
+    reader->map = (char *) text;
+    reader->map_size = strlen(text);
+    return reader;
+}
+
+reader_t *reader_create_from_terminal()
+{
+    reader_t *reader = reader_create_from_stream(stdin);
+    reader->edit = 1;
+    return reader;
+}
+
+void reader_set_prompt(reader_t *reader,
+                       char *(*prompt)(char *buffer, size_t size))
+{
+    reader->prompt = prompt;
+}
+
+void reader_destroy(reader_t *reader)
+{
+    if (reader->owns_map) munmap(reader->map, reader->map_size);
+    if (reader->owns_stream) fclose(reader->stream);
+    if (reader->owns_fd) close(reader->fd);
+
+    struct_index_release(&reader->window_index);
+    struct_index_release(&reader->line_index);
+    free(reader->buffer);
+    free(reader->line);
+    free(reader);
+}
+
+char *reader_next_line(reader_t *reader)
+{
+    char *line;
+
+    if (reader->stream) line = next_stream_line(reader);
+    else if (reader->buffer) line = next_buffered_line(reader);
+    else line = next_mapped_line(reader);
+
+    if (line) reader->line_number++;
+
+    return line;
+}
+
+int reader_seek(reader_t *reader, size_t offset, int line_number)
+{
+    if (reader->stream || reader->buffer || offset > reader->map_size)
+        return -1;
+
+    reader->cursor = offset;
+    reader->line_number = line_number;
+    reader->window_end = 0;  // Index a new window, starting at that line.
+
+    return 0;
+}
+
+/**
+ * Creates a reader with no source attached.
+ */
+reader_t *reader_create()
+{
+    reader_t *reader = (reader_t *) calloc(1, sizeof(reader_t));
+    assert(reader);
+    reader->fd = -1;
+
+    struct_index_init(&reader->window_index);
+    struct_index_init(&reader->line_index);
+
+    return reader;
+}
+
+/**
+ * Reads the next line out of a mapped script, using the structural index
+ * of the current window to find where the line ends.
+ */
+char *next_mapped_line(reader_t *reader)
+{
+    if (reader->cursor >= reader->map_size) return NULL;
+
+    size_t end = 0;       // Offset after the end of the line.
+    size_t first = 0;     // First structural of the line in window index.
+    size_t last = 0;      // Entry of window index after the line.
+    int found = 0;
+
+    while (!found) {
+        // Index a new window, starting at this line, when the line is not
+        // covered by the current one.
+        if (reader->cursor < reader->window_start ||
+            reader->cursor >= reader->window_end) {
+            index_window(reader, reader->cursor, READER_WINDOW);
+        }
+
+        uint32_t *pos = reader->window_index.pos;
+        size_t count = reader->window_index.count;
+
+        first = reader->window_next;
+        for (last = first; last < count; last++) {
+            if (reader->map[reader->window_start + pos[last]] == '\n') {
+                end = reader->window_start + pos[last] + 1;
+                last++;
+                found = 1;
+                break;
+            }
+        }
+
+        if (found) break;
+
+        if (reader->window_end == reader->map_size) {
+            // Final line, without a terminating newline.
+            end = reader->map_size;
+            found = 1;
+        }
+        else if (reader->window_start == reader->cursor) {
+            // Line is longer than the window, so double it.
+            index_window(reader, reader->cursor,
+                         2 * (reader->window_end - reader->window_start));
+        }
+        else {
+            // Line crosses the end of window, so index from its beginning.
+            index_window(reader, reader->cursor, READER_WINDOW);
+        }
+    }
+
+    size_t length = end - reader->cursor;
+    store_line(reader, reader->map + reader->cursor, length);
+
+    // Rebase structurals of the line, so they are relative to its start.
+    size_t delta = reader->cursor - reader->window_start;
+    size_t quotes = 0;
+    struct_index_reserve(&reader->line_index, last - first);
+    for (size_t i = first; i < last; i++) {
+        uint32_t p = reader->window_index.pos[i] - delta;
+        reader->line_index.pos[i-first] = p;
+        if (reader->line[p] == '"') quotes++;
+    }
+    reader->line_index.count = last - first;
+
+    reader->cursor = end;
+    reader->window_next = last;
+
+    // An unmatched quote flips the quoted regions of everything after it
+    // in the window, so the window has to be indexed again after this line.
+    if (quotes % 2) reader->window_end = 0;
+
+    return reader->line;
+}
+
+/**
+ * Reads the next line out of a stream and indexes it.
+ */
+char *next_stream_line(reader_t *reader)
+{
+    char buffer[READER_PROMPT_SIZE];
+    const char *prompt = "";
+    ssize_t length;
+
+    if (reader->prompt) prompt = reader->prompt(buffer, sizeof(buffer));
+
+    if (reader->edit) {
+        length = editor_read_line(prompt, &reader->line,
+                                  &reader->line_capacity);
+    }
+    else {
+        if (reader->prompt) output_stdout("%s ", prompt);
+        output_flush();  // Output should be visible before blocking.
+        length = getline(&reader->line, &reader->line_capacity,
+                         reader->stream);
+    }
+    if (length < 0) return NULL;
+
+    reader->line_length = length;
+    scan_structurals(reader->line, length, &reader->line_index);
+
+    return reader->line;
+}
+
+/**
+ * Reads the next line out of a buffered descriptor and indexes it. More
+ * data is read only when buffer holds no complete line.
+ */
+char *next_buffered_line(reader_t *reader)
+{
+    size_t scanned = reader->buffer_start;  // Searched for newline so far.
+    char *newline;
+
+    while (!(newline = memchr(reader->buffer + scanned, '\n',
+                              reader->buffer_end - scanned))) {
+        scanned = reader->buffer_end;
+        if (reader->eof) break;
+
+        // Reclaim the space of lines already consumed.
+        if (reader->buffer_start > 0) {
+            size_t pending = reader->buffer_end - reader->buffer_start;
+            memmove(reader->buffer, reader->buffer + reader->buffer_start,
+                    pending);
+            reader->buffer_start = 0;
+            reader->buffer_end = scanned = pending;
+        }
+
+        // A line longer than the buffer doubles it.
+        if (reader->buffer_capacity - reader->buffer_end < READER_CHUNK / 2) {
+            reader->buffer_capacity *= 2;
+            reader->buffer = (char *) realloc(reader->buffer,
+                                              reader->buffer_capacity);
+            assert(reader->buffer);
+        }
+
+        // Output should be visible before blocking, but flushing it while
+        // lines keep arriving is a waste.
+        struct pollfd pfd = { reader->fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 0) == 0) output_flush();
+
+        ssize_t n = read(reader->fd, reader->buffer + reader->buffer_end,
+                         reader->buffer_capacity - reader->buffer_end);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) reader->eof = 1;
+        else reader->buffer_end += n;
+    }
+
+    if (reader->buffer_start == reader->buffer_end) return NULL;
+
+    // Final line may lack a terminating newline.
+    char *start = reader->buffer + reader->buffer_start;
+    size_t length = newline ? (size_t) (newline + 1 - start) :
+                              reader->buffer_end - reader->buffer_start;
+
+    store_line(reader, start, length);
+    scan_structurals(reader->line, length, &reader->line_index);
+    reader->buffer_start += length;
+
+    return reader->line;
+}
+
+/**
+ * Builds the structural index of a window of the mapped script.
+ *
+ * Parameters:
+ *  -reader : Reader whose window will be indexed.
+ *  -start : Offset in map where window starts. Should be the beginning of
+ *          a line.
+ *  -length : Maximum length of the window.
+ */
+void index_window(reader_t *reader, size_t start, size_t length)
+{
+    if (length > reader->map_size - start) length = reader->map_size - start;
+
+    unsigned long long start_ns = stats_now_ns();
+    scan_structurals(reader->map + start, length, &reader->window_index);
+    shell_stats.scan_ns += stats_now_ns() - start_ns;
+    shell_stats.scan_bytes += length;
+
+    // Pages before the window hold lines already read. If reader seeks
+    // back to them, they are read again from the file.
+    if (reader->owns_map) {
+        size_t released = start & ~((size_t) sysconf(_SC_PAGESIZE) - 1);
+        if (released > reader->map_released) {
+            madvise(reader->map + reader->map_released,
+                    released - reader->map_released, MADV_DONTNEED);
+        }
+        reader->map_released = released;
+    }
+
+    reader->window_start = start;
+    reader->window_end = start + length;
+    reader->window_next = 0;
+}
+
+/**
+ * Copies the given text to the line buffer of reader and NULL terminates it.
+ */
+void store_line(reader_t *reader, const char *text, size_t length)
+{
+    if (length + 1 > reader->line_capacity) {
+        reader->line_capacity = length + 1;
+        reader->line = (char *) realloc(reader->line, reader->line_capacity);
+        assert(reader->line);
+    }
+
+    memcpy(reader->line, text, length);
+    reader->line[length] = '\0';
+    reader->line_length = length;
+}
@@ -0,0 +1,267 @@
+/**
+ * reader.h
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This header provides an interface for reading the lines of commands given
+ * to the shell, along with the structural index of each line (see
+ * scanner.h), ready to be handed to parse_line_indexed().
+ *
+ * Scripts are memory mapped and indexed in large windows at once, so
+ * the structural scanner runs over bulk data instead of line by line.
+ * Pages of lines already read are given back to the kernel, whenever a new
+ * window is indexed, so memory doesn't grow with the size of the script.
+ * Pipes, and stdin when it is not a terminal, are read in large chunks into
+ * a buffer, out of which lines are handed as soon as they are complete.
+ * When stdin is a terminal, lines are read through the line editor (see
+ * editor.h), or line by line when stdout is not a terminal.
+ *
+ * Types defined in reader.h:
+ *  -reader_t
+ *
+ * Macros defined in reader.h:
+ *  -reader_get_line(reader)
+ *  -reader_get_line_length(reader)
+ *  -reader_get_structurals(reader)
+ *  -reader_get_structc(reader)
+ *  -reader_get_line_number(reader)
+ *  -reader_get_offset(reader)
+ *  -reader_get_lookahead(reader)
+ *  -reader_get_lookahead_size(reader)
+ *  -reader_at_end(reader)
+ *
+ * Functions defined in reader.h:
+ *  -reader_t *reader_create_from_file(const char *path)
+ *  -reader_t *reader_create_from_stream(FILE *stream)
+ *  -reader_t *reader_create_from_fd(int fd)
+ *  -reader_t *reader_create_from_string(const char *text)
+ *  -reader_t *reader_create_from_terminal()
+ *  -void reader_set_prompt(reader_t *reader,
+ *                          char *(*prompt)(char *buffer, size_t size))
+ *  -void reader_destroy(reader_t *reader)
+ *  -char *reader_next_line(reader_t *reader)
+ *  -int reader_seek(reader_t *reader, size_t offset, int line_number)
+ *
+ * Version: 0.1
+ */
+
+#ifndef __reader_h__
+#define __reader_h__
+
+#include <stdio.h>
+#include "scanner.h"
+
+
+typedef struct {
+    FILE *stream;           // Stream read line by line, when not mapped.
+    int owns_stream;        // Whether stream was opened by the reader.
+    int fd;                 // Descriptor read in chunks, when buffered.
+    int owns_fd;            // Whether fd was opened by the reader.
+    char *buffer;           // Chunks read from fd, or NULL if not buffered.
+    size_t buffer_start;    // Offset in buffer where the next line starts.
+    size_t buffer_end;      // Offset in buffer where read data ends.
+    size_t buffer_capacity; // Allocated size of buffer.
+    int eof;                // Whether end of fd has been reached.
+    char *map;              // Contents of a memory mapped script, or of a
+                            // string given as script.
+    size_t map_size;        // Size of mapped contents.
+    int owns_map;           // Whether map was mapped by the reader.
+    size_t map_released;    // Offset in map, before which pages of a mapped
+                            // script have been given back to the kernel.
+    size_t cursor;          // Offset in map where the next line starts.
+    size_t window_start;    // Offset in map where indexed window starts.
+    size_t window_end;      // Offset in map where indexed window ends.
+    size_t window_next;     // First entry of window_index not yet consumed.
+    struct_index_t window_index;  // Structurals of the window.
+    char *line;             // Current line, NULL terminated.
+    size_t line_length;     // Length of current line.
+    size_t line_capacity;   // Allocated size of line buffer.
+    struct_index_t line_index;  // Structurals of current line.
+    int line_number;        // Number of lines read so far.
+    int edit;               // Whether lines are read through line editor.
+    char *(*prompt)(char *, size_t);  // Builds prompt displayed before each
+                                      // line of a stream, or NULL.
+} reader_t;
+
+
+/**
+ * Returns the current line, i.e. the one returned by last call to
+ * reader_next_line().
+ */
+#define reader_get_line(reader) (reader)->line
+
+/**
+ * Returns the length of the current line.
+ */
+#define reader_get_line_length(reader) (reader)->line_length
+
+/**
+ * Returns the offsets of structural characters of the current line.
+ */
+#define reader_get_structurals(reader) (reader)->line_index.pos
+
+/**
+ * Returns the number of structural characters of the current line.
+ */
+#define reader_get_structc(reader) (reader)->line_index.count
+
+/**
+ * Returns the number of the current line, starting from 1.
+ */
+#define reader_get_line_number(reader) (reader)->line_number
+
+/**
+ * Returns the offset in a mapped script where the line after the current
+ * one starts.
+ */
+#define reader_get_offset(reader) (reader)->cursor
+
+/**
+ * Returns the whole text of a mapped script or string, so the lines after
+ * the current one can be looked at before they are read, or NULL if lines
+ * come from a stream or descriptor. Text should never be modified.
+ */
+#define reader_get_lookahead(reader) ((const char *) (reader)->map)
+
+/**
+ * Returns the size of the text returned by reader_get_lookahead().
+ */
+#define reader_get_lookahead_size(reader) (reader)->map_size
+
+/**
+ * Returns non-zero if a mapped script or string has no lines left after the
+ * current one. Always zero for streams and descriptors, whose end is not
+ * known in advance.
+ */
+#define reader_at_end(reader) \
+    (!(reader)->stream && !(reader)->buffer && \
+     (reader)->cursor >= (reader)->map_size)
+
+/**
+ * Creates a reader for the lines of a file.
+ *
+ * Regular files are memory mapped. Any other kind of file is read in
+ * chunks, like reader_create_from_fd() does.
+ *
+ * Parameters:
+ *  -path : Path to the file to be read.
+ *
+ * Returns:
+ *  The newly created reader, or NULL if file cannot be opened.
+ */
+reader_t *reader_create_from_file(const char *path);
+
+/**
+ * Creates a reader for the lines of an already open stream.
+ *
+ * Stream is not closed when reader is destroyed.
+ *
+ * Parameters:
+ *  -stream : Stream to be read.
+ *
+ * Returns:
+ *  The newly created reader.
+ */
+reader_t *reader_create_from_stream(FILE *stream);
+
+/**
+ * Creates a reader for the lines fed through a descriptor, e.g. stdin when
+ * it is a pipe. Data is read in large chunks, as much as available at once,
+ * so a producer writing many lines is kept up with by few reads. Every line
+ * is returned as soon as its newline arrives.
+ *
+ * Descriptor is not closed when reader is destroyed. Data read ahead of the
+ * current line is not available to commands reading the same descriptor.
+ *
+ * Parameters:
+ *  -fd : Descriptor to be read.
+ *
+ * Returns:
+ *  The newly created reader.
+ */
+reader_t *reader_create_from_fd(int fd);
+
+/**
+ * Creates a reader for the lines of a string, e.g. the one given to -c
+ * option. The string is neither copied nor released, so it should outlive
+ * the reader.
+ *
+ * Parameters:
+ *  -text : NULL terminated text to be read.
+ *
+ * Returns:
+ *  The newly created reader.
+ */
+reader_t *reader_create_from_string(const char *text);
+
+/**
+ * Creates a reader for the lines typed by user on the terminal attached to
+ * stdin, which are edited through the line editor.
+ *
+ * Returns:
+ *  The newly created reader.
+ */
+reader_t *reader_create_from_terminal();
+
+/**
+ * Sets the function that builds the prompt to be displayed before reading
+ * each line. Has no effect on memory mapped scripts.
+ *
+ * Parameters:
+ *  -reader : Reader whose prompt will be set.
+ *  -prompt : Function storing the prompt into given buffer of given size
+ *          and returning it, like get_prompt() of crush.c does. NULL
+ *          disables prompt.
+ */
+void reader_set_prompt(reader_t *reader,
+                       char *(*prompt)(char *buffer, size_t size));
+
+/**
+ * Destroys a reader, releasing all resources it holds.
+ *
+ * Parameters:
+ *  -reader : Reader to be destroyed.
+ */
+void reader_destroy(reader_t *reader);
+
+/**
+ * Reads the next line.
+ *
+ * Returned line includes its terminating newline character, if any. Its
+ * structural index is made available through reader_get_structurals() and
+ * reader_get_structc().
+ *
+ * WARNING: Returned buffer is owned by the reader and gets overwritten by
+ * the next call.
+ *
+ * Parameters:
+ *  -reader : Reader to read from.
+ *
+ * Returns:
+ *  The next line, or NULL when no more lines exist.
+ */
+char *reader_next_line(reader_t *reader);
+
+/**
+ * Moves a reader of a mapped script to the beginning of a line, so that the
+ * next call to reader_next_line() returns that line. Lines before it are
+ * neither read nor indexed.
+ *
+ * Parameters:
+ *  -reader : Reader to be moved.
+ *  -offset : Offset in script where the line starts, as returned by
+ *          reader_get_offset() after reading the previous line.
+ *  -line_number : Number of the line before it, 0 for the first line.
+ *
+ * Returns:
+ *  0 on success, or -1 if reader doesn't read a mapped script or offset is
+ *  beyond its end.
+ */
+int reader_seek(reader_t *reader, size_t offset, int line_number);
+
+#endif
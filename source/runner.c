@@ -0,0 +1,280 @@
+/**
+ * runner.c
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This file provides an implementation for routines declared in runner.h
+ * header.
+ *
+ * Version: 0.1
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include "stats.h"
+#include "output.h"
+#include "jobserver.h"
+#include "runner.h"
+
+
+// State of a script run by a worker.
+typedef struct {
+    const char *path;                // Path to the script.
+    pid_t pid;                       // Worker running it, or 0 if not started.
+    int stats_fd;                    // Where worker reports its counters.
+    int status;                      // Status of worker, as returned by wait().
+    unsigned long long start_ns;     // When worker started.
+    unsigned long long end_ns;       // When worker finished.
+} script_run_t;
+
+
+// A worker not yet waited for.
+typedef struct {
+    pid_t pid;
+    int pidfd;  // Readable when worker exits, or -1 if not supported.
+} live_worker_t;
+
+
+void start_worker(script_run_t *run, int (*run_script)(const char *path));
+void report_worker_stats();
+void print_summary(script_run_t *runs, int count);
+void forget_worker(pid_t pid);
+
+
+int worker_stats_fd = -1;  // In a worker, where its counters are reported.
+live_worker_t *live_workers = NULL;  // Workers not yet waited for.
+int live_workerc = 0;
+int live_workers_capacity = 0;
+
+
+int run_scripts(char **paths, int count, int jobs,
+                int (*run_script)(const char *path))
+{
+    script_run_t *runs = (script_run_t *) calloc(count, sizeof(script_run_t));
+    assert(runs);
+
+    int next = 0;     // Next script to be started.
+    int running = 0;  // Workers currently running.
+    int failures = 0;
+
+    while (next < count || running > 0) {
+        while (next < count && running < jobs && !jobserver_acquire(running)) {
+            runs[next].path = paths[next];
+            start_worker(&runs[next], run_script);
+            next++;
+            running++;
+        }
+
+        int status;
+        pid_t pid = worker_wait(&status, next < count && running < jobs);
+        if (pid < 0) break;
+        if (pid == 0) continue;  // A job slot may have been freed.
+
+        for (int i = 0; i < next; i++) {
+            if (runs[i].pid != pid) continue;
+
+            runs[i].status = status;
+            runs[i].end_ns = stats_now_ns();
+            running--;
+            jobserver_release(running);
+            if (!WIFEXITED(status) || WEXITSTATUS(status)) failures++;
+
+            worker_reap(runs[i].stats_fd);
+            break;
+        }
+    }
+
+    print_summary(runs, count);
+    free(runs);
+
+    return failures;
+}
+
+pid_t worker_fork(int *stats_fd)
+{
+    int stats_pipe[2];
+    if (pipe2(stats_pipe, O_CLOEXEC)) {
+        output_perror("Internal error: Cthulhu came up and your lovely CRUSH, crashed...!");
+        exit(-1);
+    }
+
+    output_flush();  // Otherwise, buffered output is written by both.
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        output_perror("Internal error: Cthulhu came up and your lovely CRUSH, crashed...!");
+        exit(-1);
+    }
+    else if (pid == 0) {  // Worker code.
+        close(stats_pipe[0]);
+
+        // Worker counts only its own work, which is merged by the shell,
+        // that is also the only one writing metrics file.
+        memset(&shell_stats, 0, sizeof(shell_stats));
+        stats_set_metrics_file(NULL);
+        worker_stats_fd = stats_pipe[1];
+        atexit(report_worker_stats);  // Also reached by 'exit' built-in.
+
+        // Workers of the shell are not children of the worker.
+        for (int i = 0; i < live_workerc; i++)
+            if (live_workers[i].pidfd >= 0) close(live_workers[i].pidfd);
+        live_workerc = 0;
+
+        return 0;
+    }
+
+    close(stats_pipe[1]);
+    *stats_fd = stats_pipe[0];
+
+    if (live_workerc == live_workers_capacity) {
+        live_workers_capacity = live_workers_capacity ?
+                                live_workers_capacity * 2 : 16;
+        live_workers = (live_worker_t *) realloc(
+            live_workers, sizeof(live_worker_t) * live_workers_capacity);
+        assert(live_workers);
+    }
+    live_workers[live_workerc].pid = pid;
+    live_workers[live_workerc].pidfd = syscall(SYS_pidfd_open, pid, 0);
+    live_workerc++;
+
+    return pid;
+}
+
+pid_t worker_wait(int *status, int want_slot)
+{
+    if (live_workerc == 0) return -1;
+
+    struct pollfd *fds = (struct pollfd *) malloc(
+        sizeof(struct pollfd) * (live_workerc + 1));
+    assert(fds);
+    pid_t pid = -1;
+
+    // Workers are waited for by pid, so other children of the shell (e.g.
+    // coprocesses) are never reaped here.
+    while (pid < 0) {
+        for (int i = 0; i < live_workerc; i++) {
+            pid_t exited = waitpid(live_workers[i].pid, status, WNOHANG);
+            if (exited > 0) {
+                pid = exited;
+                forget_worker(pid);
+                break;
+            }
+        }
+        if (pid > 0) break;
+
+        // Sleep until either a worker exits or a token shows up.
+        int timeout = -1;
+        fds[0].fd = want_slot ? jobserver_fd() : -1;
+        fds[0].events = POLLIN;
+        for (int i = 0; i < live_workerc; i++) {
+            fds[i+1].fd = live_workers[i].pidfd;  // Ignored if negative.
+            fds[i+1].events = POLLIN;
+            if (live_workers[i].pidfd < 0) timeout = 5;
+        }
+        int rc = poll(fds, live_workerc + 1, timeout);
+        if (rc > 0 && (fds[0].revents & POLLIN)) {
+            pid = 0;
+            break;
+        }
+    }
+
+    free(fds);
+
+    return pid;
+}
+
+pid_t worker_wait_pid(pid_t pid, int *status)
+{
+    pid_t exited;
+    while ((exited = waitpid(pid, status, 0)) < 0 && errno == EINTR);
+
+    if (exited > 0) forget_worker(pid);
+
+    return exited;
+}
+
+void worker_reap(int stats_fd)
+{
+    // Worker has exited, so its counters are already in the pipe.
+    shell_stats_t worker_stats;
+    if (read(stats_fd, &worker_stats, sizeof(worker_stats)) ==
+        sizeof(worker_stats)) {
+        stats_merge(&worker_stats);
+    }
+    close(stats_fd);
+    stats_tick();
+}
+
+/**
+ * Removes a worker that has been waited for from live workers.
+ */
+void forget_worker(pid_t pid)
+{
+    for (int i = 0; i < live_workerc; i++) {
+        if (live_workers[i].pid != pid) continue;
+        if (live_workers[i].pidfd >= 0) close(live_workers[i].pidfd);
+        live_workers[i] = live_workers[--live_workerc];
+        return;
+    }
+}
+
+/**
+ * Forks a worker that runs a script.
+ */
+void start_worker(script_run_t *run, int (*run_script)(const char *path))
+{
+    run->start_ns = stats_now_ns();
+    run->pid = worker_fork(&run->stats_fd);
+    if (run->pid == 0) exit(run_script(run->path));
+}
+
+/**
+ * Sends the counters of a worker to the shell, when worker exits.
+ */
+void report_worker_stats()
+{
+    // Counters are smaller than PIPE_BUF, so they are written atomically.
+    write(worker_stats_fd, &shell_stats, sizeof(shell_stats));
+}
+
+/**
+ * Prints exit status and runtime of every script.
+ */
+void print_summary(script_run_t *runs, int count)
+{
+    char status[32];
+
+    output_stdout("\n%-10s %12s  %s\n", "STATUS", "TIME", "SCRIPT");
+    for (int i = 0; i < count; i++) {
+        if (!runs[i].pid) {
+            snprintf(status, sizeof(status), "not run");
+        }
+        else if (WIFEXITED(runs[i].status)) {
+            snprintf(status, sizeof(status), "%d", WEXITSTATUS(runs[i].status));
+        }
+        else {
+            snprintf(status, sizeof(status), "signal %d",
+                     WTERMSIG(runs[i].status));
+        }
+
+        double seconds = runs[i].pid ?
+                         (runs[i].end_ns - runs[i].start_ns) / 1e9 : 0;
+        output_stdout("%-10s %10.3f s  %s\n", status, seconds, runs[i].path);
+    }
+}
@@ -0,0 +1,115 @@
+/**
+ * runner.h
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This header provides concurrent execution of many scripts by a single
+ * shell invocation.
+ *
+ * Each script runs in a worker process forked off the shell, so it gets its
+ * own working directory and 'exit' or 'cd' of one script never affects the
+ * others. Workers inherit everything the shell has already cached (e.g.
+ * directory listings) and report their runtime counters back to the shell
+ * when they finish, so stats and metrics file cover all scripts.
+ *
+ * Each worker besides the first one takes a slot from the jobserver, if
+ * any is in use (see jobserver.h), so that workers, make and other shells
+ * never run more jobs at once than the jobserver allows.
+ *
+ * Functions defined in runner.h:
+ *  -int run_scripts(char **paths, int count, int jobs,
+ *                   int (*run_script)(const char *path))
+ *  -pid_t worker_fork(int *stats_fd)
+ *  -pid_t worker_wait(int *status, int want_slot)
+ *  -pid_t worker_wait_pid(pid_t pid, int *status)
+ *  -void worker_reap(int stats_fd)
+ *
+ * Version: 0.1
+ */
+
+#ifndef __runner_h__
+#define __runner_h__
+
+#include <sys/types.h>
+
+
+/**
+ * Runs scripts concurrently, keeping at most the given number of them
+ * running at any time. Scripts are started in the given order.
+ *
+ * When all scripts finish, a summary with the exit status and runtime of
+ * each one is printed.
+ *
+ * Parameters:
+ *  -paths : Paths to the scripts.
+ *  -count : Number of scripts.
+ *  -jobs : Maximum number of scripts running at once.
+ *  -run_script : Function that runs a script inside a worker and returns
+ *          the exit status of the worker.
+ *
+ * Returns:
+ *  Number of scripts that didn't exit with status 0.
+ */
+int run_scripts(char **paths, int count, int jobs,
+                int (*run_script)(const char *path));
+
+/**
+ * Forks a worker process, like fork() does.
+ *
+ * Shell output is flushed before forking. In the worker, counters start
+ * from zero and are sent to the shell when worker exits through exit(). A
+ * worker should never return to the caller of worker_fork() of the shell.
+ *
+ * Parameters:
+ *  -stats_fd : A reference where the descriptor from which counters of
+ *          worker are read is stored. Set only in the shell.
+ *
+ * Returns:
+ *  Process ID of worker in the shell, or 0 in the worker.
+ */
+pid_t worker_fork(int *stats_fd);
+
+/**
+ * Waits for a worker to exit. While waiting, it also watches the jobserver,
+ * if any is in use, returning as soon as a slot may be free.
+ *
+ * Parameters:
+ *  -status : A reference where the status of exited worker is stored, as
+ *          returned by wait().
+ *  -want_slot : Non-zero if caller waits for a jobserver slot too.
+ *
+ * Returns:
+ *  Process ID of the exited worker, 0 if a jobserver slot may be free, or
+ *  -1 if no worker is running.
+ */
+pid_t worker_wait(int *status, int want_slot);
+
+/**
+ * Waits for a specific worker to exit, leaving any other worker that exits
+ * meanwhile to be waited for by worker_wait().
+ *
+ * Parameters:
+ *  -pid : Process ID of the worker, as returned by worker_fork().
+ *  -status : A reference where the status of worker is stored, as returned
+ *          by wait().
+ *
+ * Returns:
+ *  pid, or -1 if it could not be waited for.
+ */
+pid_t worker_wait_pid(pid_t pid, int *status);
+
+/**
+ * Merges the counters of a worker that has been waited for into the
+ * counters of the shell.
+ *
+ * Parameters:
+ *  -stats_fd : Descriptor returned by worker_fork(). It is closed.
+ */
+void worker_reap(int stats_fd);
+
+#endif
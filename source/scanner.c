@@ -0,0 +1,273 @@
+/**
+ * scanner.c
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This file provides an implementation for routines declared in scanner.h
+ * header.
+ *
+ * Each 64 bytes block of input is classified into three bitmasks, one bit
+ * per byte: quotes, newlines and remaining structural characters. Bits of
+ * structural characters that lie inside quoted regions are then cleared,
+ * using the prefix-XOR of quotes bitmask, and the remaining set bits are
+ * flattened into offsets.
+ *
+ * Version: 0.1
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "scanner.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCANNER_X86
+#endif
+
+
+#define BLOCK_SIZE 64  // Bytes classified at once.
+
+
+typedef struct {
+    uint64_t quote;    // Bits of '"' characters.
+    uint64_t newline;  // Bits of '\n' characters.
+    uint64_t other;    // Bits of all remaining structural characters.
+} block_masks_t;
+
+typedef void (*classify_fn)(const unsigned char *block, block_masks_t *masks);
+
+
+void classify_scalar(const unsigned char *block, block_masks_t *masks);
+#ifdef SCANNER_X86
+void classify_sse2(const unsigned char *block, block_masks_t *masks);
+void classify_avx2(const unsigned char *block, block_masks_t *masks);
+#endif
+classify_fn select_classifier();
+uint64_t prefix_xor(uint64_t bits);
+
+
+// Structural characters other than quote and newline. Marked with 1 in
+// scalar classification table.
+static const unsigned char other_class[256] = {
+    [' '] = 1, ['\r'] = 1, [';'] = 1, ['&'] = 1, ['#'] = 1,
+    ['|'] = 1, ['('] = 1, [')'] = 1
+};
+
+classify_fn classifier = NULL;    // Implementation selected for this CPU.
+const char *classifier_name = NULL;
+
+
+void struct_index_init(struct_index_t *index)
+{
+    index->pos = NULL;
+    index->count = 0;
+    index->capacity = 0;
+}
+
+void struct_index_release(struct_index_t *index)
+{
+    free(index->pos);
+    struct_index_init(index);
+}
+
+size_t scan_structurals(const char *buf, size_t len, struct_index_t *index)
+{
+    if (!classifier) classifier = select_classifier();
+
+    const unsigned char *in = (const unsigned char *) buf;
+    uint64_t quote_carry = 0;  // All ones when previous block ended in quote.
+    block_masks_t masks;
+    size_t base = 0;
+
+    index->count = 0;
+
+    while (base < len) {
+        size_t remaining = len - base;
+
+        if (remaining >= BLOCK_SIZE) {
+            classifier(in + base, &masks);
+        }
+        else {
+            // Pad last partial block with zeros, which are never structural.
+            unsigned char last[BLOCK_SIZE];
+            memset(last, 0, BLOCK_SIZE);
+            memcpy(last, in + base, remaining);
+            classifier(last, &masks);
+        }
+
+        // Bits of quoted region, including opening quote, excluding closing.
+        uint64_t in_quote = prefix_xor(masks.quote) ^ quote_carry;
+        quote_carry = (uint64_t) ((int64_t) in_quote >> 63);
+
+        uint64_t structurals =
+            (masks.other & ~in_quote) | masks.quote | masks.newline;
+
+        // Flatten set bits into offsets.
+        struct_index_reserve(index, index->count + BLOCK_SIZE);
+        uint32_t *out = index->pos + index->count;
+        while (structurals) {
+            *out++ = (uint32_t) (base + __builtin_ctzll(structurals));
+            structurals &= structurals - 1;
+        }
+        index->count = out - index->pos;
+
+        base += BLOCK_SIZE;
+    }
+
+    return index->count;
+}
+
+const char *scanner_get_impl_name()
+{
+    if (!classifier) classifier = select_classifier();
+    return classifier_name;
+}
+
+/**
+ * Classifies a block one byte at a time. Used on CPUs without SIMD support.
+ */
+void classify_scalar(const unsigned char *block, block_masks_t *masks)
+{
+    uint64_t quote = 0, newline = 0, other = 0;
+
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+        uint64_t bit = 1ULL << i;
+        if (block[i] == '"') quote |= bit;
+        else if (block[i] == '\n') newline |= bit;
+        else if (other_class[block[i]]) other |= bit;
+    }
+
+    masks->quote = quote;
+    masks->newline = newline;
+    masks->other = other;
+}
+
+#ifdef SCANNER_X86
+
+__attribute__((target("sse2")))
+void classify_sse2(const unsigned char *block, block_masks_t *masks)
+{
+    uint64_t quote = 0, newline = 0, other = 0;
+
+    for (int i = 0; i < BLOCK_SIZE / 16; i++) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (block + 16 * i));
+
+        __m128i q = _mm_cmpeq_epi8(v, _mm_set1_epi8('"'));
+        __m128i n = _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'));
+        __m128i o = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                         _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))),
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(';')),
+                         _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('&')),
+                                      _mm_cmpeq_epi8(v, _mm_set1_epi8('#')))));
+        o = _mm_or_si128(o,
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('|')),
+                         _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('(')),
+                                      _mm_cmpeq_epi8(v, _mm_set1_epi8(')')))));
+
+        quote |= (uint64_t) (uint16_t) _mm_movemask_epi8(q) << (16 * i);
+        newline |= (uint64_t) (uint16_t) _mm_movemask_epi8(n) << (16 * i);
+        other |= (uint64_t) (uint16_t) _mm_movemask_epi8(o) << (16 * i);
+    }
+
+    masks->quote = quote;
+    masks->newline = newline;
+    masks->other = other;
+}
+
+__attribute__((target("avx2")))
+void classify_avx2(const unsigned char *block, block_masks_t *masks)
+{
+    uint64_t quote = 0, newline = 0, other = 0;
+
+    for (int i = 0; i < BLOCK_SIZE / 32; i++) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (block + 32 * i));
+
+        __m256i q = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'));
+        __m256i n = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'));
+        __m256i o = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))),
+            _mm256_or_si256(
+                _mm256_cmpeq_epi8(v, _mm256_set1_epi8(';')),
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('&')),
+                                _mm256_cmpeq_epi8(v, _mm256_set1_epi8('#')))));
+        o = _mm256_or_si256(o,
+            _mm256_or_si256(
+                _mm256_cmpeq_epi8(v, _mm256_set1_epi8('|')),
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('(')),
+                                _mm256_cmpeq_epi8(v, _mm256_set1_epi8(')')))));
+
+        quote |= (uint64_t) (uint32_t) _mm256_movemask_epi8(q) << (32 * i);
+        newline |= (uint64_t) (uint32_t) _mm256_movemask_epi8(n) << (32 * i);
+        other |= (uint64_t) (uint32_t) _mm256_movemask_epi8(o) << (32 * i);
+    }
+
+    masks->quote = quote;
+    masks->newline = newline;
+    masks->other = other;
+}
+
+#endif
+
+/**
+ * Selects the fastest classifier supported by the running CPU.
+ *
+ * Returns:
+ *  A reference to the selected classifier.
+ */
+classify_fn select_classifier()
+{
+#ifdef SCANNER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        classifier_name = "avx2";
+        return classify_avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        classifier_name = "sse2";
+        return classify_sse2;
+    }
+#endif
+    classifier_name = "scalar";
+    return classify_scalar;
+}
+
+/**
+ * Computes the prefix-XOR of a bitmask, i.e. each bit of the result is the
+ * XOR of all bits of the input at the same or lower positions.
+ *
+ * Parameters:
+ *  -bits : The input bitmask.
+ *
+ * Returns:
+ *  The prefix-XOR of bits.
+ */
+uint64_t prefix_xor(uint64_t bits)
+{
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+void struct_index_reserve(struct_index_t *index, size_t needed)
+{
+    if (needed <= index->capacity) return;
+
+    size_t capacity = index->capacity ? index->capacity : 256;
+    while (capacity < needed) capacity *= 2;
+
+    index->pos = (uint32_t *) realloc(index->pos, capacity * sizeof(uint32_t));
+    assert(index->pos);
+    index->capacity = capacity;
+}
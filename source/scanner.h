@@ -0,0 +1,115 @@
+/**
+ * scanner.h
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This header provides a vectorized pre-lexing stage, that locates all
+ * structural characters of a text buffer and stores their positions into a
+ * structural index. Tokenizers can then jump directly between structural
+ * positions, instead of examining text byte by byte.
+ *
+ * Structural characters are: newline, carriage return, '"', ';', '&', '|',
+ * '(', ')', '#' and space. Characters enclosed in double quotes are not structural, with
+ * the exception of newlines that are always indexed, so line boundaries are
+ * never lost. Double quotes themselves are always indexed.
+ *
+ * Classification of bytes is done 64 bytes at a time using AVX2 or SSE2,
+ * selected at runtime according to CPUID, with a scalar fallback. Quoted
+ * regions are resolved with a prefix-XOR of the quote bitmask.
+ *
+ * Types defined in scanner.h:
+ *  -struct_index_t
+ *
+ * Macros defined in scanner.h:
+ *  -struct_index_get_positions(index)
+ *  -struct_index_get_count(index)
+ *
+ * Functions defined in scanner.h:
+ *  -void struct_index_init(struct_index_t *index)
+ *  -void struct_index_release(struct_index_t *index)
+ *  -void struct_index_reserve(struct_index_t *index, size_t needed)
+ *  -size_t scan_structurals(const char *buf, size_t len, struct_index_t *index)
+ *  -const char *scanner_get_impl_name()
+ *
+ * Version: 0.1
+ */
+
+#ifndef __scanner_h__
+#define __scanner_h__
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+typedef struct {
+    uint32_t *pos;    // Offsets of structural characters, in ascending order.
+    size_t count;     // Number of offsets stored in pos.
+    size_t capacity;  // Number of offsets pos can hold.
+} struct_index_t;
+
+
+/**
+ * Returns the array of offsets of structural characters.
+ */
+#define struct_index_get_positions(index) (index)->pos
+
+/**
+ * Returns the number of offsets stored in a structural index.
+ */
+#define struct_index_get_count(index) (index)->count
+
+/**
+ * Initializes an empty structural index.
+ *
+ * Parameters:
+ *  -index : Index to be initialized.
+ */
+void struct_index_init(struct_index_t *index);
+
+/**
+ * Releases the memory held by a structural index.
+ *
+ * Parameters:
+ *  -index : Index to be released. It can be initialized again afterwards.
+ */
+void struct_index_release(struct_index_t *index);
+
+/**
+ * Grows the capacity of an index, so it can hold at least the given number
+ * of offsets.
+ *
+ * Parameters:
+ *  -index : Index to be grown.
+ *  -needed : Number of offsets that index should be able to hold.
+ */
+void struct_index_reserve(struct_index_t *index, size_t needed);
+
+/**
+ * Scans a buffer and stores into index the offsets of all its structural
+ * characters.
+ *
+ * Any previous contents of index are discarded. Scanning starts outside of
+ * any quoted region.
+ *
+ * Parameters:
+ *  -buf : The buffer to be scanned. It doesn't need to be NULL terminated.
+ *  -len : Number of bytes of buf to be scanned. Should be less than 4GB.
+ *  -index : Index where offsets, relative to buf, will be stored.
+ *
+ * Returns:
+ *  The number of structural characters found.
+ */
+size_t scan_structurals(const char *buf, size_t len, struct_index_t *index);
+
+/**
+ * Returns the name of the implementation selected for the running CPU
+ * ("avx2", "sse2" or "scalar").
+ */
+const char *scanner_get_impl_name();
+
+#endif
@@ -0,0 +1,321 @@
+/**
+ * snapshot.c
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This file provides an implementation for routines declared in snapshot.h
+ * header.
+ *
+ * Version: 0.1
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "engine.h"
+#include "pathcache.h"
+#include "output.h"
+#include "snapshot.h"
+
+
+#define SNAPSHOT_MAGIC "CRUSHSNP"
+
+
+// Header of a snapshot file. Fields have fixed sizes, so the file layout
+// doesn't depend on the platform.
+typedef struct {
+    char magic[8];              // SNAPSHOT_MAGIC, without terminator.
+    uint32_t version;           // SNAPSHOT_VERSION.
+    uint32_t entry_count;       // Number of resolved paths.
+    uint64_t size;              // Size of whole file.
+    uint64_t builtins_hash;     // Fingerprint of engine_builtins.
+    uint64_t path_env_hash;     // Hash of PATH that paths were resolved with.
+    int64_t timeout_ns;         // engine_default_timeout.duration_ns
+    int64_t kill_after_ns;      // engine_default_timeout.kill_after_ns
+    int32_t signal;             // engine_default_timeout.signal
+    uint32_t reserved;          // Zero.
+    uint64_t checksum;          // Checksum of everything after header.
+} snapshot_header_t;
+
+// A resolved path. Offsets are relative to the strings following entries.
+typedef struct {
+    uint32_t name_offset;       // Name of command.
+    uint32_t path_offset;       // Path of its binary.
+    int64_t mtime_ns;           // Modification time of binary.
+} snapshot_entry_t;
+
+
+void save_snapshot();
+int restore_snapshot(const char *data, size_t size);
+const char *snapshot_string(const char *strings, size_t size,
+                            uint32_t offset);
+uint64_t snapshot_builtins_hash();
+uint64_t snapshot_hash(uint64_t hash, const void *data, size_t length);
+
+
+char *snapshot_path = NULL;  // Where snapshot is saved at exit.
+pid_t snapshot_owner = 0;    // Process saving it.
+
+
+int snapshot_load(const char *path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOENT) return 0;
+        output_stderr("Failed to open snapshot %s: %s\n", path,
+                      strerror(errno));
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st)) {
+        output_stderr("Failed to open snapshot %s: %s\n", path,
+                      strerror(errno));
+        close(fd);
+        return -1;
+    }
+    if ((size_t) st.st_size < sizeof(snapshot_header_t)) {
+        output_stderr("Snapshot %s is not valid.\n", path);
+        close(fd);
+        return -1;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        output_stderr("Failed to map snapshot %s: %s\n", path,
+                      strerror(errno));
+        return -1;
+    }
+
+    int rc = restore_snapshot((const char *) data, st.st_size);
+    munmap(data, st.st_size);
+
+    if (rc == -1) output_stderr("Snapshot %s is not valid.\n", path);
+    else if (rc == -2) {
+        output_stderr("Snapshot %s was saved by another version of the "
+                      "shell.\n", path);
+    }
+
+    return rc ? -1 : 0;
+}
+
+void snapshot_save_at_exit(const char *path)
+{
+    int hook = !snapshot_path;
+
+    free(snapshot_path);
+    snapshot_path = strdup(path);
+    assert(snapshot_path);
+    snapshot_owner = getpid();
+
+    if (hook) atexit(save_snapshot);
+}
+
+/**
+ * Restores the state held in the contents of a snapshot file.
+ *
+ * Returns:
+ *  0 on success, -1 if snapshot is damaged, or -2 if it comes from another
+ *  version of the shell.
+ */
+int restore_snapshot(const char *data, size_t size)
+{
+    const snapshot_header_t *header = (const snapshot_header_t *) data;
+
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, 8) || header->size != size)
+        return -1;
+    if (header->version != SNAPSHOT_VERSION ||
+        header->builtins_hash != snapshot_builtins_hash()) {
+        return -2;
+    }
+
+    size_t entries_size = (size_t) header->entry_count *
+                          sizeof(snapshot_entry_t);
+    if (entries_size > size - sizeof(snapshot_header_t)) return -1;
+    if (header->checksum != snapshot_hash(14695981039346656037ULL,
+                                          header + 1,
+                                          size - sizeof(*header))) {
+        return -1;
+    }
+
+    engine_default_timeout.duration_ns = header->timeout_ns;
+    engine_default_timeout.kill_after_ns = header->kill_after_ns;
+    engine_default_timeout.signal = header->signal;
+
+    // Paths resolved through another PATH may resolve differently now.
+    const char *env = getenv("PATH");
+    if (!env || header->path_env_hash !=
+            snapshot_hash(14695981039346656037ULL, env, strlen(env))) {
+        return 0;
+    }
+
+    const snapshot_entry_t *entries = (const snapshot_entry_t *) (header + 1);
+    const char *strings = (const char *) (entries + header->entry_count);
+    size_t strings_size = size - sizeof(*header) - entries_size;
+
+    for (uint32_t i = 0; i < header->entry_count; i++) {
+        const char *name = snapshot_string(strings, strings_size,
+                                           entries[i].name_offset);
+        const char *path = snapshot_string(strings, strings_size,
+                                           entries[i].path_offset);
+        if (!name || !path) return -1;
+
+        // A binary replaced since it was resolved might be another one.
+        struct stat st;
+        if (stat(path, &st) ||
+            st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec !=
+                entries[i].mtime_ns) {
+            continue;
+        }
+        pathcache_add(name, path, entries[i].mtime_ns);
+    }
+
+    return 0;
+}
+
+/**
+ * Returns the string at given offset of the strings of a snapshot, or NULL
+ * if it doesn't lie entirely within them.
+ */
+const char *snapshot_string(const char *strings, size_t size,
+                            uint32_t offset)
+{
+    if (offset >= size) return NULL;
+    if (!memchr(strings + offset, '\0', size - offset)) return NULL;
+    return strings + offset;
+}
+
+/**
+ * Writes the state of the shell to the snapshot file. Registered to run at
+ * exit.
+ */
+void save_snapshot()
+{
+    // Forked workers inherit the exit handlers of the shell.
+    if (getpid() != snapshot_owner) return;
+
+    const path_entry_t *paths;
+    int pathc = pathcache_get_entries(&paths);
+
+    size_t strings_size = 0;
+    for (int i = 0; i < pathc; i++)
+        strings_size += strlen(paths[i].name) + strlen(paths[i].path) + 2;
+    if (strings_size > UINT32_MAX) pathc = strings_size = 0;
+
+    size_t size = sizeof(snapshot_header_t) +
+                  pathc * sizeof(snapshot_entry_t) + strings_size;
+    char *data = (char *) calloc(1, size);
+    assert(data);
+
+    snapshot_header_t *header = (snapshot_header_t *) data;
+    snapshot_entry_t *entries = (snapshot_entry_t *) (header + 1);
+    char *strings = (char *) (entries + pathc);
+
+    uint32_t offset = 0;
+    for (int i = 0; i < pathc; i++) {
+        size_t name_length = strlen(paths[i].name) + 1;
+        size_t path_length = strlen(paths[i].path) + 1;
+
+        entries[i].name_offset = offset;
+        memcpy(strings + offset, paths[i].name, name_length);
+        offset += name_length;
+
+        entries[i].path_offset = offset;
+        memcpy(strings + offset, paths[i].path, path_length);
+        offset += path_length;
+
+        entries[i].mtime_ns = paths[i].mtime_ns;
+    }
+
+    const char *env = getenv("PATH");
+    memcpy(header->magic, SNAPSHOT_MAGIC, 8);
+    header->version = SNAPSHOT_VERSION;
+    header->entry_count = pathc;
+    header->size = size;
+    header->builtins_hash = snapshot_builtins_hash();
+    header->path_env_hash = env ?
+        snapshot_hash(14695981039346656037ULL, env, strlen(env)) : 0;
+    header->timeout_ns = engine_default_timeout.duration_ns;
+    header->kill_after_ns = engine_default_timeout.kill_after_ns;
+    header->signal = engine_default_timeout.signal;
+    header->checksum = snapshot_hash(14695981039346656037ULL, header + 1,
+                                     size - sizeof(*header));
+
+    // Replace the previous snapshot at once, so it is never seen partial.
+    char *temp_path;
+    if (asprintf(&temp_path, "%s.%d.tmp", snapshot_path, (int) getpid()) < 0) {
+        free(data);
+        return;
+    }
+
+    int fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    int failed = fd < 0;
+    for (size_t written = 0; !failed && written < size; ) {
+        ssize_t n = write(fd, data + written, size - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) failed = 1;
+        else written += n;
+    }
+    if (fd >= 0 && close(fd)) failed = 1;
+    if (!failed && rename(temp_path, snapshot_path)) failed = 1;
+
+    if (failed) {
+        output_stderr("Failed to save snapshot %s: %s\n", snapshot_path,
+                      strerror(errno));
+        unlink(temp_path);
+    }
+
+    free(temp_path);
+    free(data);
+}
+
+/**
+ * Computes a fingerprint of the table of built-in commands, which changes
+ * whenever built-ins are added, removed or reordered.
+ */
+uint64_t snapshot_builtins_hash()
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    // Terminators are included, so names are not just concatenated.
+    for (int i = 0; engine_builtins[i]; i++)
+        hash = snapshot_hash(hash, engine_builtins[i],
+                             strlen(engine_builtins[i]) + 1);
+
+    return hash;
+}
+
+/**
+ * Continues the FNV-1a hash of some bytes.
+ *
+ * Parameters:
+ *  -hash : Hash of previous bytes, or the FNV offset basis to start anew.
+ *  -data : Bytes to be hashed.
+ *  -length : Number of bytes.
+ */
+uint64_t snapshot_hash(uint64_t hash, const void *data, size_t length)
+{
+    const unsigned char *bytes = (const unsigned char *) data;
+
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
@@ -0,0 +1,68 @@
+/**
+ * snapshot.h
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This header provides snapshots of the state a shell builds up while it
+ * runs, so that a new shell can start warm, out of the state of a previous
+ * one, instead of building it up again.
+ *
+ * A snapshot holds the paths resolved for command names (see pathcache.h)
+ * and the default timeout of binaries. Paths are kept only if resolved
+ * through the same PATH and only if their binaries still have the
+ * modification time they had when resolved.
+ *
+ * A snapshot file consists of a header, an array of fixed size entries and
+ * the strings they refer to by offset, so it is used right out of a single
+ * memory mapping, without parsing. Header carries a format version,
+ * a fingerprint of the table of built-in commands of the shell that wrote
+ * it and a checksum, so a snapshot of another build or a damaged one is
+ * rejected as a whole. Snapshots are written to a temporary file that is
+ * renamed over the previous one, so readers never see a partial one.
+ *
+ * Constants defined in snapshot.h:
+ *  -SNAPSHOT_VERSION
+ *
+ * Functions defined in snapshot.h:
+ *  -int snapshot_load(const char *path)
+ *  -void snapshot_save_at_exit(const char *path)
+ *
+ * Version: 0.1
+ */
+
+#ifndef __snapshot_h__
+#define __snapshot_h__
+
+
+// Version of snapshot format, changed on any change to its layout.
+#define SNAPSHOT_VERSION 1
+
+
+/**
+ * Restores the state of the shell out of a snapshot file. A missing file
+ * is not an error, so a shell can load the snapshot it saves on every run.
+ *
+ * Parameters:
+ *  -path : Path to the snapshot file.
+ *
+ * Returns:
+ *  0 if state was restored or file doesn't exist, else -1, after
+ *  describing the error on stderr.
+ */
+int snapshot_load(const char *path);
+
+/**
+ * Makes the shell save its state to a snapshot file when it exits. Only
+ * the shell itself saves it, not the workers it forks.
+ *
+ * Parameters:
+ *  -path : Path to the snapshot file.
+ */
+void snapshot_save_at_exit(const char *path);
+
+#endif
@@ -0,0 +1,233 @@
+/**
+ * stats.c
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This file provides an implementation for routines and variables declared
+ * in stats.h header.
+ *
+ * Version: 0.1
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "output.h"
+#include "scanner.h"
+#include "stats.h"
+
+
+void write_metrics_at_exit();
+
+
+shell_stats_t shell_stats;
+
+char *metrics_path = NULL;                // File where metrics are exported.
+unsigned long long metrics_last_write = 0;  // Timestamp of last export.
+int metrics_hooked = 0;                   // Whether exit hook is registered.
+
+
+unsigned long long stats_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void stats_record_command(unsigned long long wall_ns)
+{
+    unsigned long long us = wall_ns / 1000;
+    int bucket = 0;
+
+    // Find the smallest power of two (in us) that is larger than wall time.
+    while (bucket < STATS_HIST_BUCKETS - 1 && us >= (1ULL << bucket)) bucket++;
+
+    shell_stats.wall_hist[bucket]++;
+    shell_stats.wall_ns += wall_ns;
+}
+
+void stats_print()
+{
+    shell_stats_t *s = &shell_stats;
+
+    output_stdout("lines parsed:        %llu\n", s->lines_parsed);
+    output_stdout("bytes parsed:        %llu\n", s->bytes_parsed);
+    output_stdout("parse time:          %.6f s\n", s->parse_ns / 1e9);
+    output_stdout("  cache hits:        %llu\n", s->parse_cache_hits);
+    output_stdout("  cache misses:      %llu\n", s->parse_cache_misses);
+    output_stdout("scanner:             %s\n", scanner_get_impl_name());
+    output_stdout("  bytes scanned:     %llu\n", s->scan_bytes);
+    output_stdout("  scan time:         %.6f s\n", s->scan_ns / 1e9);
+    output_stdout("commands executed:   %llu\n", s->commands_executed);
+    output_stdout("  builtins:          %llu\n", s->builtins_executed);
+    output_stdout("  spawns:            %llu\n", s->spawns);
+    output_stdout("  spawn failures:    %llu\n", s->spawn_failures);
+    output_stdout("  timeouts:          %llu\n", s->timeouts);
+    output_stdout("fork/exec time:      %.6f s\n", s->spawn_ns / 1e9);
+    output_stdout("child user time:     %.6f s\n", s->child_user_us / 1e6);
+    output_stdout("child system time:   %.6f s\n", s->child_sys_us / 1e6);
+    output_stdout("command wall time:   %.6f s\n", s->wall_ns / 1e9);
+
+    // Print only the populated part of the histogram.
+    int first = 0;
+    int last = STATS_HIST_BUCKETS - 1;
+    while (first < STATS_HIST_BUCKETS && !s->wall_hist[first]) first++;
+    while (last >= first && !s->wall_hist[last]) last--;
+    if (first <= last) output_stdout("wall time histogram:\n");
+    for (int i = first; i <= last; i++) {
+        if (i == STATS_HIST_BUCKETS - 1)
+            output_stdout("  %10s+ us : %llu\n", "", s->wall_hist[i]);
+        else
+            output_stdout("  < %10llu us : %llu\n",
+                          1ULL << i, s->wall_hist[i]);
+    }
+
+    if (s->perf_commands) {
+        output_stdout("perfstat commands:   %llu\n", s->perf_commands);
+        perfstat_print(STDOUT_FILENO, s->perf_values, s->perf_counted,
+                       s->perf_commands);
+    }
+}
+
+int stats_write_prometheus(const char *path)
+{
+    shell_stats_t *s = &shell_stats;
+
+    // Write to a temporary file, so collector never sees partial contents.
+    size_t tmp_size = strlen(path) + 32;
+    char *tmp_path = (char *) malloc(tmp_size);
+    snprintf(tmp_path, tmp_size, "%s.%d.tmp", path, (int) getpid());
+
+    FILE *f = fopen(tmp_path, "w");
+    if (!f) {
+        free(tmp_path);
+        return -1;
+    }
+
+    fprintf(f, "# HELP crush_lines_parsed_total Lines parsed by the shell.\n");
+    fprintf(f, "# TYPE crush_lines_parsed_total counter\n");
+    fprintf(f, "crush_lines_parsed_total %llu\n", s->lines_parsed);
+    fprintf(f, "# HELP crush_bytes_parsed_total Bytes parsed by the shell.\n");
+    fprintf(f, "# TYPE crush_bytes_parsed_total counter\n");
+    fprintf(f, "crush_bytes_parsed_total %llu\n", s->bytes_parsed);
+    fprintf(f, "# HELP crush_parse_seconds_total Time spent parsing lines.\n");
+    fprintf(f, "# TYPE crush_parse_seconds_total counter\n");
+    fprintf(f, "crush_parse_seconds_total %.9f\n", s->parse_ns / 1e9);
+    fprintf(f, "# HELP crush_parse_cache_total Lookups of parsed lines.\n");
+    fprintf(f, "# TYPE crush_parse_cache_total counter\n");
+    fprintf(f, "crush_parse_cache_total{result=\"hit\"} %llu\n",
+            s->parse_cache_hits);
+    fprintf(f, "crush_parse_cache_total{result=\"miss\"} %llu\n",
+            s->parse_cache_misses);
+    fprintf(f, "# HELP crush_commands_executed_total Commands executed.\n");
+    fprintf(f, "# TYPE crush_commands_executed_total counter\n");
+    fprintf(f, "crush_commands_executed_total{kind=\"builtin\"} %llu\n",
+            s->builtins_executed);
+    fprintf(f, "crush_commands_executed_total{kind=\"spawn\"} %llu\n",
+            s->commands_executed - s->builtins_executed);
+    fprintf(f, "# HELP crush_spawn_failures_total Failed fork or exec.\n");
+    fprintf(f, "# TYPE crush_spawn_failures_total counter\n");
+    fprintf(f, "crush_spawn_failures_total %llu\n", s->spawn_failures);
+    fprintf(f, "# HELP crush_timeouts_total Children signaled on timeout.\n");
+    fprintf(f, "# TYPE crush_timeouts_total counter\n");
+    fprintf(f, "crush_timeouts_total %llu\n", s->timeouts);
+    fprintf(f, "# HELP crush_spawn_seconds_total Time from fork to exec.\n");
+    fprintf(f, "# TYPE crush_spawn_seconds_total counter\n");
+    fprintf(f, "crush_spawn_seconds_total %.9f\n", s->spawn_ns / 1e9);
+    fprintf(f, "# HELP crush_child_cpu_seconds_total CPU time of children.\n");
+    fprintf(f, "# TYPE crush_child_cpu_seconds_total counter\n");
+    fprintf(f, "crush_child_cpu_seconds_total{mode=\"user\"} %.6f\n",
+            s->child_user_us / 1e6);
+    fprintf(f, "crush_child_cpu_seconds_total{mode=\"system\"} %.6f\n",
+            s->child_sys_us / 1e6);
+
+    // Prometheus histograms are cumulative, with bounds in seconds.
+    fprintf(f, "# HELP crush_command_duration_seconds Command wall time.\n");
+    fprintf(f, "# TYPE crush_command_duration_seconds histogram\n");
+    unsigned long long cumulative = 0;
+    for (int i = 0; i < STATS_HIST_BUCKETS - 1; i++) {
+        cumulative += s->wall_hist[i];
+        fprintf(f, "crush_command_duration_seconds_bucket{le=\"%g\"} %llu\n",
+                (double) (1ULL << i) / 1e6, cumulative);
+    }
+    cumulative += s->wall_hist[STATS_HIST_BUCKETS-1];
+    fprintf(f, "crush_command_duration_seconds_bucket{le=\"+Inf\"} %llu\n",
+            cumulative);
+    fprintf(f, "crush_command_duration_seconds_sum %.9f\n", s->wall_ns / 1e9);
+    fprintf(f, "crush_command_duration_seconds_count %llu\n", cumulative);
+    fprintf(f, "# HELP crush_perf_commands_total Binaries counted by "
+            "perfstat.\n");
+    fprintf(f, "# TYPE crush_perf_commands_total counter\n");
+    fprintf(f, "crush_perf_commands_total %llu\n", s->perf_commands);
+    fprintf(f, "# HELP crush_perf_events_total Events counted by perfstat "
+            "(task-clock in ns).\n");
+    fprintf(f, "# TYPE crush_perf_events_total counter\n");
+    for (int i = 0; i < PERFSTAT_EVENTS; i++) {
+        if (!s->perf_counted[i]) continue;
+        fprintf(f, "crush_perf_events_total{event=\"%s\"} %llu\n",
+                perfstat_event_names[i], s->perf_values[i]);
+    }
+
+    int rc = ferror(f);
+    rc |= fclose(f);
+    if (!rc) rc = rename(tmp_path, path);
+    if (rc) unlink(tmp_path);
+
+    free(tmp_path);
+
+    return rc;
+}
+
+void stats_set_metrics_file(const char *path)
+{
+    // Register exit hook only the first time a metrics file is set.
+    if (path && !metrics_hooked) {
+        atexit(write_metrics_at_exit);
+        metrics_hooked = 1;
+    }
+
+    free(metrics_path);
+    metrics_path = path ? strdup(path) : NULL;
+    metrics_last_write = 0;
+}
+
+void stats_merge(const shell_stats_t *other)
+{
+    unsigned long long *dst = (unsigned long long *) &shell_stats;
+    const unsigned long long *src = (const unsigned long long *) other;
+
+    // All counters are unsigned long long, so they are added one by one.
+    for (size_t i = 0; i < sizeof(shell_stats_t) / sizeof(*dst); i++) {
+        dst[i] += src[i];
+    }
+}
+
+void stats_tick()
+{
+    if (!metrics_path) return;
+
+    unsigned long long now = stats_now_ns();
+    if (now - metrics_last_write < STATS_METRICS_INTERVAL * 1000000000ULL &&
+        metrics_last_write) {
+        return;
+    }
+
+    if (stats_write_prometheus(metrics_path))
+        output_stderr("Failed to write metrics to %s.\n", metrics_path);
+    metrics_last_write = now;
+}
+
+/**
+ * Writes a final snapshot of metrics when shell exits.
+ */
+void write_metrics_at_exit()
+{
+    if (metrics_path) stats_write_prometheus(metrics_path);
+}
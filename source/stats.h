@@ -0,0 +1,143 @@
+/**
+ * stats.h
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This header provides always-on runtime counters of the shell, updated by
+ * the parser and the engine, along with routines for reporting them either
+ * in human readable form or in Prometheus textfile exposition format.
+ *
+ * Types defined in stats.h:
+ *  -shell_stats_t
+ *
+ * Constants defined in stats.h:
+ *  -STATS_HIST_BUCKETS
+ *  -STATS_METRICS_INTERVAL
+ *
+ * Variables declared in stats.h:
+ *  -shell_stats_t shell_stats
+ *
+ * Functions defined in stats.h:
+ *  -unsigned long long stats_now_ns()
+ *  -void stats_record_command(unsigned long long wall_ns)
+ *  -void stats_print()
+ *  -int stats_write_prometheus(const char *path)
+ *  -void stats_set_metrics_file(const char *path)
+ *  -void stats_tick()
+ *  -void stats_merge(const shell_stats_t *other)
+ *
+ * Version: 0.1
+ */
+
+#ifndef __stats_h__
+#define __stats_h__
+
+#include <stdio.h>
+#include "perfstat.h"
+
+
+// Number of buckets in log2 histogram of command wall time. Bucket i counts
+// commands that lasted less than 2^i microseconds (last one is unbounded).
+#define STATS_HIST_BUCKETS 32
+// Minimum number of seconds between two periodic writes of metrics file.
+#define STATS_METRICS_INTERVAL 10
+
+
+// Counters of the shell. All fields should be unsigned long long, since
+// stats_merge() adds them as an array.
+typedef struct {
+    unsigned long long lines_parsed;       // Lines given to the parser.
+    unsigned long long bytes_parsed;       // Bytes of all parsed lines.
+    unsigned long long parse_ns;           // Time spent in parse_line().
+    unsigned long long scan_bytes;         // Bytes of scripts indexed in bulk.
+    unsigned long long scan_ns;            // Time spent indexing them.
+    unsigned long long parse_cache_hits;   // Lines found already parsed.
+    unsigned long long parse_cache_misses; // Lines parsed and cached.
+    unsigned long long commands_executed;  // Commands actually invoked.
+    unsigned long long builtins_executed;  // Commands served by a built-in.
+    unsigned long long spawns;             // Children forked for binaries.
+    unsigned long long spawn_failures;     // Failed fork() or exec().
+    unsigned long long spawn_ns;           // Time from fork() to exec().
+    unsigned long long timeouts;           // Children signaled on timeout.
+    unsigned long long child_user_us;      // User CPU time of children.
+    unsigned long long child_sys_us;       // System CPU time of children.
+    unsigned long long wall_ns;            // Sum of command wall times.
+    unsigned long long wall_hist[STATS_HIST_BUCKETS];  // log2(us) histogram.
+    unsigned long long perf_commands;      // Binaries counted by perfstat.
+    unsigned long long perf_values[PERFSTAT_EVENTS];   // Sum of each event.
+    unsigned long long perf_counted[PERFSTAT_EVENTS];  // Binaries counting it.
+} shell_stats_t;
+
+
+/**
+ * Counters of the running shell. Updated directly by parser and engine.
+ */
+extern shell_stats_t shell_stats;
+
+
+/**
+ * Returns a monotonic timestamp in nanoseconds.
+ */
+unsigned long long stats_now_ns();
+
+/**
+ * Accounts for a command executed, by adding its wall time to the wall time
+ * histogram.
+ *
+ * Parameters:
+ *  -wall_ns : Wall time the command took, in nanoseconds.
+ */
+void stats_record_command(unsigned long long wall_ns);
+
+/**
+ * Prints all counters in human readable form to stdout, through output
+ * channel (see output.h).
+ */
+void stats_print();
+
+/**
+ * Writes all counters into a file in Prometheus textfile format.
+ *
+ * File is first written under a temporary name and then renamed to the
+ * given path, so a collector never reads a partially written file.
+ *
+ * Parameters:
+ *  -path : Path of the metrics file.
+ *
+ * Returns:
+ *  0 on success, else a non-zero value.
+ */
+int stats_write_prometheus(const char *path);
+
+/**
+ * Enables periodic writing of metrics into given file.
+ *
+ * Metrics are written by stats_tick() at most once every
+ * STATS_METRICS_INTERVAL seconds and once more when the shell exits.
+ *
+ * Parameters:
+ *  -path : Path of the metrics file, or NULL to disable metrics file.
+ */
+void stats_set_metrics_file(const char *path);
+
+/**
+ * Writes metrics file, if enabled and if STATS_METRICS_INTERVAL seconds
+ * have elapsed since last write. Meant to be called after each line.
+ */
+void stats_tick();
+
+/**
+ * Adds the counters of another shell, e.g. of a worker process, to the
+ * counters of this one.
+ *
+ * Parameters:
+ *  -other : Counters to be added.
+ */
+void stats_merge(const shell_stats_t *other);
+
+#endif
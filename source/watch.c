@@ -0,0 +1,478 @@
+/**
+ * watch.c
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This file provides an implementation for routines declared in watch.h
+ * header.
+ *
+ * Version: 0.1
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <errno.h>
+#include <dirent.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/signalfd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include "command.h"
+#include "engine.h"
+#include "parser.h"
+#include "globbing.h"
+#include "runner.h"
+#include "stats.h"
+#include "output.h"
+#include "watch.h"
+
+
+// Events that count as a change of the watched files.
+#define WATCH_EVENTS (IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | \
+                      IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | \
+                      IN_DELETE_SELF | IN_MOVE_SELF)
+
+
+// A run of the commands in a worker.
+typedef struct {
+    pid_t pid;     // Process ID of worker, 0 when nothing runs.
+    int pidfd;     // A pidfd of worker, or -1 if not available.
+    int stats_fd;  // Where counters of worker are read from.
+} watch_run_t;
+
+
+int watch_commands(command_t *parsed, int first,
+                   command_t ***commands, int *commandc);
+void watch_release_commands(command_t **commands, int commandc);
+void watch_paths_of(int inotify_fd, command_t *parsed, int first, int last);
+int watch_tree(int inotify_fd, const char *path);
+void forget_watch(int wd);
+int read_events(int inotify_fd);
+void start_run(watch_run_t *run, command_t **commands, int commandc,
+               const sigset_t *old_mask);
+int run_exited(const watch_run_t *run, short revents);
+void finish_run(watch_run_t *run);
+void cancel_run(watch_run_t *run);
+
+
+char **watch_paths = NULL;  // Path of each watch, indexed by descriptor.
+int watch_paths_capacity = 0;
+int watch_count = 0;        // Number of active watches.
+int watch_limit_reported = 0;  // Whether running out of watches was reported.
+
+
+int run_watch(command_t *command)
+{
+    // Arguments are taken as parsed, so patterns after "--" match the files
+    // existing at each run, and the ones of paths are expanded here.
+    command_t *parsed = command_get_origin(command);
+    char **args = command_get_args(parsed);
+    int argc = command_get_args_num(parsed);
+    long debounce_ms = WATCH_DEFAULT_DEBOUNCE_MS;
+    int i = 0;
+
+    if (argc > 1 && !strcmp(args[0], "--debounce")) {
+        debounce_ms = atol(args[1]);
+        i = 2;
+    }
+
+    int separator = i;
+    while (separator < argc && strcmp(args[separator], "--")) separator++;
+
+    if (separator == i || separator >= argc - 1 || debounce_ms < 0) {
+        output_stderr("Usage: watch [--debounce MS] paths... -- commands...\n");
+        return -1;
+    }
+
+    command_t **commands;
+    int commandc;
+    if (watch_commands(parsed, separator + 1, &commands, &commandc)) {
+        output_stderr("watch: Invalid commands '%s'.\n", args[separator+1]);
+        return -1;
+    }
+
+    int inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0) {
+        output_perror("watch");
+        watch_release_commands(commands, commandc);
+        return -1;
+    }
+    watch_limit_reported = 0;
+    watch_paths_of(inotify_fd, parsed, i, separator);
+
+    if (watch_count == 0) {
+        output_stderr("watch: No path could be watched.\n");
+        close(inotify_fd);
+        watch_release_commands(commands, commandc);
+        return -1;
+    }
+
+    // Signals that stop watching are read through a descriptor, so running
+    // commands can be cancelled first.
+    sigset_t mask, old_mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGHUP);
+    sigprocmask(SIG_BLOCK, &mask, &old_mask);
+    int signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    watch_run_t run = { 0, -1, -1 };
+    start_run(&run, commands, commandc, &old_mask);
+
+    unsigned long long deadline_ns = 0;  // End of debounce window, if any.
+    int stop_signal = 0;
+
+    while (!stop_signal) {
+        int timeout = -1;
+        if (deadline_ns) {
+            unsigned long long now_ns = stats_now_ns();
+            timeout = deadline_ns > now_ns ?
+                (int) ((deadline_ns - now_ns + 999999) / 1000000) : 0;
+        }
+        // Without a pidfd, worker has to be checked every few milliseconds.
+        if (run.pid && run.pidfd < 0 && (timeout < 0 || timeout > 5))
+            timeout = 5;
+
+        struct pollfd fds[3] = {
+            { inotify_fd, POLLIN, 0 },
+            { signal_fd, POLLIN, 0 },
+            { run.pid ? run.pidfd : -1, POLLIN, 0 }
+        };
+        if (poll(fds, 3, timeout) < 0 && errno != EINTR) {
+            output_perror("watch");
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            struct signalfd_siginfo info;
+            if (read(signal_fd, &info, sizeof(info)) == sizeof(info))
+                stop_signal = info.ssi_signo;
+        }
+
+        if (run.pid && run_exited(&run, fds[2].revents)) finish_run(&run);
+
+        // Every event extends the window, so a burst triggers a single run.
+        if ((fds[0].revents & POLLIN) && read_events(inotify_fd))
+            deadline_ns = stats_now_ns() + debounce_ms * 1000000ULL;
+
+        if (!stop_signal && deadline_ns && stats_now_ns() >= deadline_ns) {
+            deadline_ns = 0;
+            if (run.pid) {
+                output_stderr("watch: Files changed, cancelling running "
+                              "commands.\n");
+                cancel_run(&run);
+            }
+            start_run(&run, commands, commandc, &old_mask);
+        }
+    }
+
+    if (run.pid) cancel_run(&run);
+
+    for (int wd = 0; wd < watch_paths_capacity; wd++) forget_watch(wd);
+    close(inotify_fd);
+    if (signal_fd >= 0) close(signal_fd);
+    sigprocmask(SIG_SETMASK, &old_mask, NULL);
+    watch_release_commands(commands, commandc);
+
+    return stop_signal ? W_EXITCODE(128 + stop_signal, 0) : -1;
+}
+
+/**
+ * Builds the commands to be watched, out of the arguments of a parsed
+ * 'watch' command that follow "--". A single word is parsed as a line of
+ * commands, so a quoted line may contain ';' or '&&'. More words form a
+ * single command, taken as they are, so quoted ones are never split again.
+ *
+ * Parameters:
+ *  -parsed : The 'watch' command, before its patterns got expanded.
+ *  -first : Index of the first argument after "--".
+ *  -commands : A reference where the array of commands is stored, to be
+ *          released by watch_release_commands().
+ *  -commandc : A reference where the number of commands is stored.
+ *
+ * Returns:
+ *  0 on success, or -1 if the line cannot be parsed.
+ */
+int watch_commands(command_t *parsed, int first,
+                   command_t ***commands, int *commandc)
+{
+    char **args = command_get_args(parsed);
+    int argc = command_get_args_num(parsed);
+
+    if (argc - first == 1 && !command_is_pattern(parsed, first)) {
+        // Parser may modify the line it is given.
+        char *line = strdup(args[first]);
+        assert(line);
+        int rc = parse_line(line, commands, commandc);
+        free(line);
+        return rc;
+    }
+
+    command_t *comm = command_create();
+    assert(comm);
+    command_set_name(comm, args[first]);
+    for (int i = first + 1; i < argc; i++) {
+        if (command_is_pattern(parsed, i)) command_add_pattern(comm, args[i]);
+        else command_add_arg(comm, args[i]);
+    }
+
+    *commands = (command_t **) malloc(sizeof(command_t *));
+    assert(*commands);
+    (*commands)[0] = comm;
+    *commandc = 1;
+
+    return 0;
+}
+
+/**
+ * Destroys the commands built by watch_commands().
+ */
+void watch_release_commands(command_t **commands, int commandc)
+{
+    for (int i = 0; i < commandc; i++) command_destroy(commands[i]);
+    free(commands);
+}
+
+/**
+ * Adds watches for the paths among the arguments of a parsed 'watch'
+ * command, expanding the ones that are patterns.
+ *
+ * Parameters:
+ *  -inotify_fd : Where watches are added.
+ *  -parsed : The 'watch' command, before its patterns got expanded.
+ *  -first : Index of the first path.
+ *  -last : Index after the last path.
+ */
+void watch_paths_of(int inotify_fd, command_t *parsed, int first, int last)
+{
+    char **args = command_get_args(parsed);
+
+    for (int i = first; i < last; i++) {
+        char **matches;
+        int matchc = 0;
+        if (command_is_pattern(parsed, i))
+            matchc = glob_expand(args[i], &matches);
+
+        // A pattern that matches nothing is taken as a path.
+        if (!matchc) {
+            watch_tree(inotify_fd, args[i]);
+            continue;
+        }
+        for (int j = 0; j < matchc; j++) {
+            watch_tree(inotify_fd, matches[j]);
+            free(matches[j]);
+        }
+        free(matches);
+    }
+}
+
+/**
+ * Adds a watch for a path and, if it is a directory, for every directory
+ * under it. Symbolic links are followed only for the given path.
+ *
+ * Returns:
+ *  Number of watches added.
+ */
+int watch_tree(int inotify_fd, const char *path)
+{
+    int wd = inotify_add_watch(inotify_fd, path, WATCH_EVENTS);
+    if (wd < 0) {
+        if (errno == ENOSPC && !watch_limit_reported) {
+            output_stderr("watch: Out of inotify watches. Raise "
+                          "fs.inotify.max_user_watches to watch all files.\n");
+            watch_limit_reported = 1;
+        }
+        else if (errno != ENOSPC) {
+            output_stderr("watch: Cannot watch '%s': %s\n", path,
+                          strerror(errno));
+        }
+        return 0;
+    }
+
+    if (wd >= watch_paths_capacity) {
+        int capacity = watch_paths_capacity ? watch_paths_capacity : 64;
+        while (capacity <= wd) capacity *= 2;
+        watch_paths = (char **) realloc(watch_paths, sizeof(char *) * capacity);
+        assert(watch_paths);
+        memset(watch_paths + watch_paths_capacity, 0,
+               sizeof(char *) * (capacity - watch_paths_capacity));
+        watch_paths_capacity = capacity;
+    }
+    // Same inode watched twice gets the same descriptor.
+    if (!watch_paths[wd]) {
+        watch_paths[wd] = strdup(path);
+        assert(watch_paths[wd]);
+        watch_count++;
+    }
+    int added = 1;
+
+    DIR *dir = opendir(path);
+    if (!dir) return added;
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+            continue;
+
+        char *child;
+        if (asprintf(&child, "%s/%s", path, entry->d_name) < 0) continue;
+
+        int is_dir = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN) {
+            struct stat st;
+            is_dir = !lstat(child, &st) && S_ISDIR(st.st_mode);
+        }
+        if (is_dir) added += watch_tree(inotify_fd, child);
+
+        free(child);
+    }
+    closedir(dir);
+
+    return added;
+}
+
+/**
+ * Releases the path of a watch that kernel removed.
+ */
+void forget_watch(int wd)
+{
+    if (wd < 0 || wd >= watch_paths_capacity || !watch_paths[wd]) return;
+
+    free(watch_paths[wd]);
+    watch_paths[wd] = NULL;
+    watch_count--;
+}
+
+/**
+ * Reads all pending events, adding watches for new directories.
+ *
+ * Returns:
+ *  Non-zero if any event reported a change.
+ */
+int read_events(int inotify_fd)
+{
+    char buffer[65536]
+        __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    int changed = 0;
+    ssize_t n;
+
+    while ((n = read(inotify_fd, buffer, sizeof(buffer))) > 0) {
+        for (char *p = buffer; p < buffer + n;
+             p += sizeof(struct inotify_event) +
+                  ((struct inotify_event *) p)->len) {
+            struct inotify_event *event = (struct inotify_event *) p;
+
+            if (event->mask & IN_IGNORED) {
+                forget_watch(event->wd);
+                continue;
+            }
+            changed = 1;  // Overflow loses events, so it counts too.
+
+            if ((event->mask & IN_ISDIR) &&
+                (event->mask & (IN_CREATE | IN_MOVED_TO)) &&
+                event->wd < watch_paths_capacity && watch_paths[event->wd]) {
+                char *child;
+                if (asprintf(&child, "%s/%s", watch_paths[event->wd],
+                             event->name) >= 0) {
+                    watch_tree(inotify_fd, child);
+                    free(child);
+                }
+            }
+        }
+    }
+
+    return changed;
+}
+
+/**
+ * Starts a worker that executes the watched commands, in a process group
+ * of its own.
+ */
+void start_run(watch_run_t *run, command_t **commands, int commandc,
+               const sigset_t *old_mask)
+{
+    run->pid = worker_fork(&run->stats_fd);
+
+    if (run->pid == 0) {  // Worker code.
+        setpgid(0, 0);
+        sigprocmask(SIG_SETMASK, old_mask, NULL);
+
+        exit(exec_commands(commands, commandc) ? 1 : 0);
+    }
+
+    // Set here too, so the group exists even if worker hasn't run yet.
+    setpgid(run->pid, run->pid);
+    run->pidfd = syscall(SYS_pidfd_open, run->pid, 0);
+}
+
+/**
+ * Checks whether the worker of a run has exited, without reaping it.
+ *
+ * Parameters:
+ *  -run : The run to check.
+ *  -revents : Events returned by poll() for the pidfd of run.
+ */
+int run_exited(const watch_run_t *run, short revents)
+{
+    if (run->pidfd >= 0) return revents & POLLIN;
+
+    siginfo_t info;
+    info.si_pid = 0;
+    if (waitid(P_PID, run->pid, &info, WEXITED | WNOHANG | WNOWAIT)) return 1;
+    return info.si_pid != 0;
+}
+
+/**
+ * Reaps the worker of a run that has exited.
+ */
+void finish_run(watch_run_t *run)
+{
+    int status;
+    worker_wait_pid(run->pid, &status);
+    worker_reap(run->stats_fd);
+    if (run->pidfd >= 0) close(run->pidfd);
+
+    run->pid = 0;
+    run->pidfd = -1;
+    run->stats_fd = -1;
+}
+
+/**
+ * Terminates every process of a run and reaps its worker.
+ */
+void cancel_run(watch_run_t *run)
+{
+    pid_t group = run->pid;
+    kill(-group, SIGTERM);
+
+    // Give the group some time to clean up, before killing what is left.
+    // Binaries of the group may outlive worker.
+    unsigned long long deadline_ns =
+        stats_now_ns() + WATCH_KILL_AFTER_MS * 1000000ULL;
+    while (stats_now_ns() < deadline_ns) {
+        if (run->pid) {
+            struct pollfd pfd = { run->pidfd, POLLIN, 0 };
+            poll(&pfd, 1, 5);  // Just sleeps, without a pidfd.
+            if (run_exited(run, pfd.revents)) finish_run(run);
+        }
+        else if (kill(-group, 0)) break;
+        else usleep(5000);
+    }
+
+    kill(-group, SIGKILL);
+    if (run->pid) finish_run(run);
+}
@@ -0,0 +1,70 @@
+/**
+ * watch.h
+ *
+ * Created by Dimitrios Karageorgiou, AEM: 8420
+ * for course: Operating Systems.
+ *
+ * Electrical and Computers Engineering Department,
+ * Aristotle University of Thessaloniki, Greeece,
+ * 2017-2018.
+ *
+ * This header provides the 'watch' built-in command, which reruns a line
+ * of commands every time files change, replacing polling loops like
+ * 'while sleep 1; do ...' of scripts.
+ *
+ * Changes are reported by inotify, on a watch registered for every
+ * directory under the given paths, including directories created while
+ * watching. Shell sleeps in poll() until either an event arrives, the
+ * debounce window of a burst of events closes, the command finishes or a
+ * signal comes, so no CPU is used while idle.
+ *
+ * Commands run in a worker (see runner.h) leading its own process group.
+ * When changes arrive while commands are still running, the whole group is
+ * sent SIGTERM, followed by SIGKILL if it doesn't exit within
+ * WATCH_KILL_AFTER_MS, before commands run again.
+ *
+ * Constants defined in watch.h:
+ *  -WATCH_DEFAULT_DEBOUNCE_MS
+ *  -WATCH_KILL_AFTER_MS
+ *
+ * Functions defined in watch.h:
+ *  -int run_watch(command_t *command)
+ *
+ * Version: 0.1
+ */
+
+#ifndef __watch_h__
+#define __watch_h__
+
+#include "command.h"
+
+
+// Quiet time after the last event of a burst, when not given.
+#define WATCH_DEFAULT_DEBOUNCE_MS 50
+
+// Time cancelled commands have to exit after SIGTERM, before SIGKILL.
+#define WATCH_KILL_AFTER_MS 1000
+
+
+/**
+ * Implements 'watch' built-in command, invoked as:
+ *  watch [--debounce MS] paths... -- commands...
+ *
+ * A single word after "--" is parsed as a line of commands, while more
+ * words form a single command, taken as parsed. Commands are executed once
+ * at start and again after every burst of changes, with their patterns
+ * expanded at each run. A burst ends when no event arrives for MS
+ * milliseconds. Watching goes on until
+ * the shell receives SIGINT, SIGTERM or SIGHUP.
+ *
+ * Parameters:
+ *  -command : The 'watch' command, whose arguments are the options, the
+ *          paths and the commands.
+ *
+ * Returns:
+ *  The status of a process killed by the signal that stopped watching, or
+ *  -1 on invalid usage or when no path can be watched.
+ */
+int run_watch(command_t *command);
+
+#endif